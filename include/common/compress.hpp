@@ -0,0 +1,20 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <common/types.hpp>
+
+namespace common {
+
+// Zero run-length encoding, meant for XOR deltas and mostly empty state blobs
+void compress(const u8* bytes, const usize size, std::vector<u8>& compressed_bytes);
+
+// Returns the number of compressed bytes consumed
+usize decompress(const u8* compressed_bytes, u8* bytes, const usize size);
+
+}
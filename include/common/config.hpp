@@ -5,12 +5,65 @@
 
 #pragma once
 
+#include <common/types.hpp>
+
 namespace common {
 
 struct Config {
     const char* boot_path;
     const char* flash_path;
     const char* elf_path;
+
+    // Rewind history budget in bytes, 0 disables rewind
+    usize rewind_bytes;
+
+    // Number of speculative frames, 0 disables run-ahead
+    int run_ahead_frames;
+
+    // Input movie paths, nullptr if unused
+    const char* record_path;
+    const char* replay_path;
+
+    bool is_headless;
+
+    // Stop after this many frames, 0 runs forever
+    u64 max_frames;
+
+    bool enable_stats;
+
+    // Performance counter dump file, nullptr if unused
+    const char* stats_json_path;
+
+    // Chrome trace output, nullptr if unused
+    const char* trace_path;
+
+    // Folded stack output of the sampling profiler, nullptr if unused
+    const char* profile_path;
+
+    // In scheduler cycles
+    i64 profile_interval;
+
+    bool profile_blocks;
+
+    bool enable_instr_histogram;
+
+    // SH-4 execution trace, nullptr if unused
+    const char* cpu_trace_path;
+
+    // Maximum number of traced instructions, 0 means no limit
+    u64 cpu_trace_limit;
+
+    // Cross-checks SH-4 execution engines block by block
+    bool enable_lockstep;
+
+    // PVR render captures, nullptr if unused
+    const char* pvr_capture_path;
+
+    u64 pvr_capture_start;
+    u32 pvr_capture_count;
+
+    // Frame dump path, nullptr if unused
+    const char* frame_dump_path;
 };
 
 }
@@ -0,0 +1,97 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdio>
+#include <vector>
+
+#include <common/types.hpp>
+
+// SH-4 execution trace format.
+// Each record is delta/varint encoded: PC relative to the previous PC + 2,
+// registers as XOR with their previous value
+namespace common {
+
+enum CpuTraceRegister {
+    TRACE_REG_R0        = 0,
+    TRACE_REG_R0_BANKED = 16,
+    TRACE_REG_SR        = 24,
+    TRACE_REG_SSR,
+    TRACE_REG_SPC,
+    TRACE_REG_SGR,
+    TRACE_REG_GBR,
+    TRACE_REG_VBR,
+    TRACE_REG_DBR,
+    TRACE_REG_MACH,
+    TRACE_REG_MACL,
+    TRACE_REG_PR,
+    TRACE_REG_FPSCR,
+    TRACE_REG_FPUL,
+    TRACE_REG_FR0,
+    TRACE_REG_XR0       = TRACE_REG_FR0 + 16,
+    NUM_TRACE_REGS      = TRACE_REG_XR0 + 16,
+};
+
+constexpr usize MAX_TRACE_MEMORY_ACCESSES = 8;
+
+struct CpuTraceMemoryAccess {
+    u32 addr;
+    u8 size;
+    bool is_write;
+    u64 data;
+};
+
+struct CpuTraceRecord {
+    u32 pc;
+    u16 instr;
+    u8 cycles;
+
+    // Registers written by the instruction
+    u8 num_regs;
+    std::array<u8, NUM_TRACE_REGS> reg_ids;
+    std::array<u32, NUM_TRACE_REGS> reg_values;
+
+    u8 num_memory_accesses;
+    std::array<CpuTraceMemoryAccess, MAX_TRACE_MEMORY_ACCESSES> memory_accesses;
+};
+
+const char* get_trace_register_name(const int reg);
+
+class CpuTraceWriter {
+private:
+    FILE* file;
+
+    std::vector<u8> buffer;
+
+    u32 last_pc;
+    std::array<u32, NUM_TRACE_REGS> last_regs;
+
+    void flush();
+public:
+    CpuTraceWriter(const char* path);
+    ~CpuTraceWriter();
+
+    void write(const CpuTraceRecord& record);
+};
+
+class CpuTraceReader {
+private:
+    FILE* file;
+
+    u32 last_pc;
+    std::array<u32, NUM_TRACE_REGS> last_regs;
+
+    u64 read_varint();
+public:
+    CpuTraceReader(const char* path);
+    ~CpuTraceReader();
+
+    // Returns false at the end of the trace
+    bool read(CpuTraceRecord& record);
+};
+
+}
@@ -5,8 +5,22 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
+#include <common/types.hpp>
+
 namespace common {
 
+struct ElfSymbol {
+    u32 addr, size;
+
+    std::string name;
+};
+
 void load_elf(const char* path);
 
+// Returns the function symbols in .symtab sorted by address
+std::vector<ElfSymbol> load_elf_symbols(const char* path);
+
 }
@@ -0,0 +1,15 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <common/types.hpp>
+
+namespace common {
+
+// 64-bit FNV-1a
+u64 hash_bytes(const void* bytes, const usize size);
+
+}
@@ -0,0 +1,109 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <common/types.hpp>
+
+namespace common {
+
+// Serializes emulator state into an in-memory blob.
+// NOTE: blobs contain host pointers (callbacks, devices) and are only valid within the same process
+class StateWriter {
+private:
+    std::vector<u8>& bytes;
+public:
+    StateWriter(std::vector<u8>& bytes) : bytes(bytes) {
+        bytes.clear();
+    }
+
+    ~StateWriter() {}
+
+    void write_bytes(const void* data, const usize size) {
+        const usize offset = bytes.size();
+
+        bytes.resize(offset + size);
+
+        std::memcpy(&bytes[offset], data, size);
+    }
+
+    // Writes all bytes in [begin, end)
+    void write_range(const void* begin, const void* end) {
+        write_bytes(begin, (const u8*)end - (const u8*)begin);
+    }
+
+    template<typename T>
+    void write(const T& data) {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        write_bytes(&data, sizeof(data));
+    }
+
+    template<typename T>
+    void write_vector(const std::vector<T>& data) {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        write<u64>(data.size());
+        write_bytes(data.data(), sizeof(T) * data.size());
+    }
+};
+
+class StateReader {
+private:
+    const std::vector<u8>& bytes;
+
+    usize offset;
+public:
+    StateReader(const std::vector<u8>& bytes) : bytes(bytes), offset(0) {}
+    ~StateReader() {}
+
+    void read_bytes(void* data, const usize size) {
+        assert((offset + size) <= bytes.size());
+
+        std::memcpy(data, &bytes[offset], size);
+
+        offset += size;
+    }
+
+    void read_range(void* begin, void* end) {
+        read_bytes(begin, (u8*)end - (u8*)begin);
+    }
+
+    template<typename T>
+    void read(T& data) {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        read_bytes(&data, sizeof(data));
+    }
+
+    template<typename T>
+    T read() {
+        T data;
+
+        read(data);
+
+        return data;
+    }
+
+    template<typename T>
+    void read_vector(std::vector<T>& data) {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        data.resize(read<u64>());
+
+        read_bytes(data.data(), sizeof(T) * data.size());
+    }
+
+    bool is_done() const {
+        return offset == bytes.size();
+    }
+};
+
+}
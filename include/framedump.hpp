@@ -0,0 +1,33 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <common/types.hpp>
+
+// Asynchronous frame capture, frames are written by a background thread
+namespace framedump {
+
+enum Format {
+    FORMAT_PNG,
+    FORMAT_Y4M,
+    FORMAT_RAW,
+};
+
+// Frames in flight, frames submitted while all buffers are busy are dropped
+constexpr int NUM_BUFFERS = 8;
+
+// Format is picked by extension: ".y4m", ".raw", anything else is a PNG sequence "[path]-[n].png"
+void initialize(const char* path);
+
+// Writes all pending frames and stops the writer thread
+void shutdown();
+
+bool is_enabled();
+
+// Copies an XRGB8888 frame, never blocks on disk I/O. Timestamp is in scheduler cycles
+void submit_frame(const u32* pixels, const i64 timestamp);
+
+}
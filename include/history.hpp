@@ -0,0 +1,30 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <common/types.hpp>
+
+// Rewind history built on incremental snapshots
+namespace history {
+
+// Default history budget
+constexpr usize DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+
+void initialize(const usize max_bytes);
+void shutdown();
+
+bool is_enabled();
+
+// Stores the changes made since the last captured frame
+void capture_frame();
+
+// Reverts to the previously captured frame, returns false if the history is exhausted
+bool step_back();
+
+usize get_num_frames();
+usize get_used_bytes();
+
+}
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // SuperH bus state controller I/O
@@ -20,6 +21,9 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 u16 get_refresh_count();
 u32 get_port_control(const int port);
 u16 get_port_data(const int port);
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // SuperH cache controller I/O
@@ -20,6 +21,9 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 u32 get_mmu_control();
 u32 get_cache_control();
 u32 get_exception_event();
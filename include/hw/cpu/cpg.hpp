@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // SuperH clock pulse generator I/O
@@ -14,6 +15,9 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 u8 get_watchdog_timer_control();
 
 void set_standby_control(const u8 data);
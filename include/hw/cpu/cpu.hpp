@@ -5,14 +5,32 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 namespace hw::cpu {
 
+// The external bus is 29 bits wide, P0-P3 mirror the same physical addresses.
+// DMA controllers only see the bus, so their address registers are masked the same way
+constexpr u32 PHYSICAL_ADDRESS_MASK = 0x1FFFFFFF;
+
+constexpr u32 to_physical_address(const u32 addr) {
+    return addr & PHYSICAL_ADDRESS_MASK;
+}
+
+// SH-4 execution engines
+enum Engine {
+    ENGINE_INTERPRETER,
+    NUM_ENGINES,
+};
+
 void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 void setup_for_sideload(const u32 entry);
 
 void assert_interrupt(const int interrupt_level);
@@ -22,4 +40,22 @@ void step();
 
 i64* get_cycles();
 
+// Address of the next instruction
+u32 get_pc();
+
+const char* get_engine_name(const Engine engine);
+
+// Runs every block on both engines and stops at the first divergence in registers or memory writes
+void enable_lockstep(const Engine engine_a, const Engine engine_b);
+
+// Records every executed instruction to a CPU trace file, 0 means no limit
+void start_trace(const char* path, const u64 max_instrs);
+void stop_trace();
+
+// Counts executions per handler, opcode and FPU mode, printed by shutdown()
+void set_instr_histogram_enabled(const bool is_enabled);
+
+// Enables the call/return and block entry callbacks into the profiler
+void set_profiler_hooks(const bool track_calls, const bool count_blocks);
+
 }
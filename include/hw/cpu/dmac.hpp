@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // SuperH DMA controller I/O
@@ -22,7 +23,14 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
+u32 get_source_address(const int channel);
+u32 get_destination_address(const int channel);
+u32 get_transfer_count(const int channel);
 u32 get_control(const int channel);
+u32 get_dma_operation();
 
 void set_source_address(const int channel, const u32 data);
 void set_destination_address(const int channel, const u32 data);
@@ -30,6 +38,7 @@ void set_transfer_count(const int channel, const u32 data);
 void set_control(const int channel, const u32 data);
 void set_dma_operation(const u32 data);
 
-void execute_channel_2_dma(u32& start_address, u32& length, bool& start);
+// Transfers to the DDT destination, returns the number of cycles until the transfer ends
+i64 execute_channel_2_dma(u32& start_address, u32& length);
 
 }
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // SuperH interrupt controller I/O
@@ -21,6 +22,9 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 u16 get_priority(const int priority);
 
 void set_interrupt_control(const u16 data);
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // SuperH real-time clock I/O
@@ -14,6 +15,9 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 void set_rtc_month_alarm(const u8 data);
 void set_rtc_control_1(const u8 data);
 
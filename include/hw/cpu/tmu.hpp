@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // SuperH timer unit I/O
@@ -21,6 +22,9 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 u8 get_timer_start();
 u32 get_counter(const int channel);
 u16 get_control(const int channel);
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // SuperH user break controller I/O
@@ -20,6 +21,9 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 void set_asid(const int channel, const u8 data);
 void set_address(const int channel, const u32 data);
 void set_address_mask(const int channel, const u8 data);
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // G1 bus functions
@@ -14,6 +15,9 @@ void initialize(const char* boot_path, const char* flash_path);
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 template<typename T>
 T read(const u32 addr);
 
@@ -5,15 +5,37 @@
 
 #pragma once
 
+#include <vector>
+
 #include <common/types.hpp>
 
 // HOLLY bus functions
 namespace hw::holly::bus {
 
+constexpr usize PAGE_SIZE = 0x1000;
+
+// Guest RAM regions
+enum {
+    MEMORY_DRAM,
+    MEMORY_VRAM,
+    MEMORY_WAVE_RAM,
+    NUM_MEMORY_REGIONS,
+};
+
 void initialize();
 void reset();
 void shutdown();
 
+u8* get_memory_ptr(const int region);
+u32 get_memory_size(const int region);
+
+// Appends all pages written since the last call and clears their dirty bits
+void collect_dirty_pages(const int region, std::vector<u32>& pages);
+void clear_dirty_pages();
+
+// For devices that write guest RAM without going through the bus
+void mark_dirty(const int region, const u32 offset, const u32 size);
+
 void setup_for_sideload();
 
 template<typename T>
@@ -26,6 +48,14 @@ void write(const u32 addr, const T data);
 
 void block_write(const u32 addr, const u8* bytes);
 
+// Host pointer to size bytes of contiguous mapped memory, nullptr otherwise
+const u8* get_read_span(const u32 addr, const u32 size);
+u8* get_write_span(const u32 addr, const u32 size);
+
+// Bulk copies for DMA, TA FIFO and YUV converter writes must be multiples of 32 bytes
+void read_bytes(const u32 addr, u8* bytes, const u32 size);
+void write_bytes(const u32 addr, const u8* bytes, const u32 size);
+
 void copy_from_bytes(
     const u32 addr,
     const u32 copy_size,
@@ -7,6 +7,7 @@
 
 #include <vector>
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // MAPLE functions
@@ -34,6 +35,9 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 template<typename T>
 T read(const u32 addr);
 
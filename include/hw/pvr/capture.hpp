@@ -0,0 +1,65 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <common/types.hpp>
+
+// PVR render captures, replayed by nejicast-bench-pvr
+namespace hw::pvr::capture {
+
+// Register write, replayed through hw::pvr::core::write()
+struct Register {
+    u32 addr;
+    u32 data;
+};
+
+// Range of linear VRAM
+struct Region {
+    u32 addr;
+    u32 size;
+};
+
+// Everything one STARTRENDER needs
+struct Capture {
+    u64 frame;
+
+    // Hash of the color buffer rendered at capture time, replays must reproduce it
+    u64 frame_hash;
+
+    std::vector<Register> registers;
+
+    std::vector<Region> regions;
+    std::vector<u8> region_bytes;
+
+    // Raw TA FIFO blocks since TA_LIST_INIT
+    std::vector<u8> ta_stream;
+};
+
+constexpr usize TA_BLOCK_SIZE = 32;
+
+// Captures up to max_captures renders starting at guest frame first_frame, to "[path_prefix]-[n].njpc"
+void initialize(const char* path_prefix, const u64 first_frame, const u32 max_captures);
+void shutdown();
+
+bool is_enabled();
+
+// Called on TA_LIST_INIT and for every TA FIFO block
+void begin_ta_stream();
+void record_ta_block(const u8* bytes);
+
+// Called on STARTRENDER before rendering, returns true if this render is captured.
+// Region contents are copied immediately
+bool begin_render(const std::vector<Register>& registers, const std::vector<Region>& regions);
+
+// Writes the capture started by begin_render()
+void end_render(const u64 frame_hash);
+
+void load(const char* path, Capture& capture);
+void save(const char* path, const Capture& capture);
+
+}
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 #include <hw/pvr/pvr.hpp>
 
@@ -15,12 +16,27 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
+// Disabled scan-out leaves the host frame untouched, rendering to VRAM always happens
+void set_scan_out_enabled(const bool is_enabled);
+
 template<typename T>
 T read(const u32 addr);
 
 template<typename T>
 void write(const u32 addr, const T data);
 
+// Renders the oldest display list, called on STARTRENDER
+void start_render();
+
+// Refreshes the video output from the framebuffer selected by FB_R_SOF1
+void scan_out();
+
+// Refreshes the video output even while scan-out is disabled, the display buffer is not part of the state
+void force_scan_out();
+
 void begin_display_list();
 
 void begin_vertex_strip(
@@ -29,8 +45,24 @@ void begin_vertex_strip(
     const TextureControlWord texture_control
 );
 
+// Two-volume polygons also carry the parameters used inside modifier volumes
+void begin_two_volume_strip(
+    const IspInstruction isp_instr,
+    const TspInstruction tsp_instr,
+    const TextureControlWord texture_control,
+    const TspInstruction second_tsp_instr,
+    const TextureControlWord second_texture_control
+);
+
 void push_vertex(const pvr::Vertex vertex);
 
-void end_vertex_strip(const bool is_translucent);
+// Second vertex has the colors and UVs used inside modifier volumes
+void push_two_volume_vertex(const pvr::Vertex vertex, const pvr::Vertex second_vertex);
+
+// Shadowed polygons are affected by modifier volumes
+void end_vertex_strip(const u32 list_type, const bool is_shadowed);
+
+// Opaque or translucent modifier volume triangle, the ISP instruction uses the modifier volume layout
+void push_volume_triangle(const u32 list_type, const IspInstruction isp_instr, const Vertex* vertices);
 
 }
@@ -5,11 +5,14 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // PVR functions
 namespace hw::pvr {
 
+constexpr usize VRAM_SIZE = 0x800000;
+
 union Color {
     u32 raw;
 
@@ -25,6 +28,9 @@ struct Vertex {
     f32 x, y, z;
     f32 u, v;
     Color color;
+
+    // Added to textured colors, alpha is the vertex fog density
+    Color offset_color;
 };
 
 union IspInstruction {
@@ -95,27 +101,158 @@ union TextureControlWord {
 
 static_assert(sizeof(TextureControlWord) == sizeof(u32));
 
+// Inclusive pixel rectangle
+struct ClipRect {
+    int x_min, x_max;
+    int y_min, y_max;
+};
+
+// FB_W_CTRL pack modes
+enum FramebufferWriteFormat : u32 {
+    WRITE_FORMAT_KRGB0555 = 0,
+    WRITE_FORMAT_RGB565   = 1,
+    WRITE_FORMAT_ARGB4444 = 2,
+    WRITE_FORMAT_ARGB1555 = 3,
+    WRITE_FORMAT_RGB888   = 4,
+    WRITE_FORMAT_KRGB0888 = 5,
+    WRITE_FORMAT_ARGB8888 = 6,
+};
+
+// FB_R_CTRL depths
+enum FramebufferReadFormat : u32 {
+    READ_FORMAT_RGB0555 = 0,
+    READ_FORMAT_RGB565  = 1,
+    READ_FORMAT_RGB888  = 2,
+    READ_FORMAT_RGB0888 = 3,
+};
+
+// Fog colors and color clamp, set for every render
+struct FogParameters {
+    Color table_color;
+    Color vertex_color;
+
+    Color clamp_max;
+    Color clamp_min;
+};
+
+// Modifier volume mode, set for every render
+struct ShadowParameters {
+    // Cheap shadow scales colors inside volumes by scale / 256, otherwise two-volume polygons switch parameters
+    bool is_intensity;
+    u8 scale;
+
+    // Opaque and punch-through pixels keep the colors they take inside volumes
+    bool has_opaque_volumes;
+};
+
+// Tile write-back settings, addresses are in the 32-bit VRAM area
+struct FramebufferWrite {
+    u32 addr;
+    u32 line_stride;
+    u32 format;
+
+    bool enable_dithering;
+
+    u8 k_value;
+    u8 alpha_threshold;
+
+    // Inclusive clip rectangle
+    u32 x_min, x_max;
+    u32 y_min, y_max;
+};
+
+// Video output settings, addresses are in the 32-bit VRAM area
+struct FramebufferRead {
+    bool enable;
+
+    u32 addr;
+    u32 format;
+    u32 concat_value;
+
+    bool line_double;
+    bool pixel_double;
+
+    // In 32-bit words, modulus is the distance between lines minus the line itself plus one
+    u32 line_words;
+    u32 num_lines;
+    u32 modulus;
+
+    u32 border_color;
+};
+
 void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 template<typename T>
 T read_vram_linear(const u32 addr);
 
+// Accesses to the 64-bit texture area, words alternate between the two VRAM modules
 template<typename T>
 T read_vram_interleaved(const u32 addr);
 
+template<typename T>
+void write_vram_interleaved(const u32 addr, const T data);
+
+// Bulk copies to and from the 64-bit texture area
+void read_vram_interleaved_bytes(const u32 addr, u8* bytes, const u32 size);
+void write_vram_interleaved_bytes(const u32 addr, const u8* bytes, const u32 size);
+
 void set_isp_instruction(const IspInstruction isp_instr);
 void set_tsp_instruction(const TspInstruction tsp_instr);
 void set_texture_control(const TextureControlWord texture_control);
 
-void set_translucent(const bool is_translucent);
+void set_list_type(const u32 list_type);
+
+// Polygon is affected by modifier volumes
+void set_shadowed(const bool is_shadowed);
+
+// Punch-through polygons drop texels with a lower alpha
+void set_alpha_threshold(const u8 alpha_threshold);
+
+// Triangles are only rasterized inside the clip rectangle
+void set_clip_rect(const ClipRect& clip);
+
+void set_fog_parameters(const FogParameters& fog);
+void set_shadow_parameters(const ShadowParameters& shadow);
+
+// Parameters two-volume polygons use inside modifier volumes
+void set_second_parameters(const TspInstruction tsp_instr, const TextureControlWord texture_control);
+
+// Expands the 128-entry hardware fog table and FOG_DENSITY into a LUT indexed by 1/W
+void update_fog_table(const u16* fog_table, const u32 fog_density);
 
 void clear_buffers();
 void submit_triangle(const Vertex* vertices);
+void submit_two_volume_triangle(const Vertex* vertices, const Vertex* second_vertices);
 void finish_render();
 
+// Modifier volumes are closed sets of triangles evaluated against the depth buffer
+void submit_volume_triangle(const Vertex* vertices);
+void end_volume(const bool is_inside);
+
+// Shadowed opaque and punch-through pixels inside any volume are scaled or take their second colors
+void apply_opaque_volumes();
+
+// Translucent volumes are tested for every shadowed translucent pixel, submitted before the translucent lists
+void submit_translucent_volume_triangle(const Vertex* vertices);
+void end_translucent_volume(const bool is_inside);
+
+// Packs the finished frame into VRAM
+void write_back(const FramebufferWrite& fb);
+
+// Converts the guest framebuffer into the display buffer, called on VBLANK IN
+void scan_out(const FramebufferRead& fb);
+
 u32* get_color_buffer_ptr();
+u32* get_display_buffer_ptr();
+
+// Range of display buffer rows changed since the last call, false if none
+bool get_dirty_rows(int& first_row, int& last_row);
+
 u8* get_video_ram_ptr();
 
 }
@@ -5,16 +5,33 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 // PVR Tile Accelerator functions
 namespace hw::pvr::ta {
 
+enum ListType : u32 {
+    LIST_TYPE_OPAQUE               = 0,
+    LIST_TYPE_OPAQUE_MODIFIER      = 1,
+    LIST_TYPE_TRANSLUCENT          = 2,
+    LIST_TYPE_TRANSLUCENT_MODIFIER = 3,
+    LIST_TYPE_PUNCHTHROUGH         = 4,
+};
+
 void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 u32 get_itp_current_address();
+u32 get_allocation_control();
+u32 get_global_tile_clip();
+u32 get_yuv_texture_base();
+u32 get_yuv_texture_control();
+u32 get_yuv_texture_count();
 
 void set_allocation_control(const u32 data);
 void set_global_tile_clip(const u32 data);
@@ -24,8 +41,19 @@ void set_next_object_pointer_block(const u32 data);
 void set_object_list_base(const u32 data);
 void set_object_list_limit(const u32 data);
 
+// Restarts the YUV converter
+void set_yuv_texture_base(const u32 data);
+void set_yuv_texture_control(const u32 data);
+
 void initialize_lists();
 
 void fifo_block_write(const u8* bytes);
 
+// Whole DMA transfers, size is a multiple of 32 bytes
+void fifo_write(const u8* bytes, const u32 size);
+
+// Macroblock data for the YUV converter, converted to YUV422 texels in VRAM
+void yuv_block_write(const u8* bytes);
+void yuv_write(const u8* bytes, const u32 size);
+
 }
@@ -0,0 +1,28 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <common/types.hpp>
+
+// Deterministic input recording and replay
+namespace movie {
+
+void start_recording(const char* path);
+void start_replay(const char* path);
+
+// Writes the recording to disk
+void shutdown();
+
+bool is_recording();
+bool is_replaying();
+
+// Returns true once all recorded polls have been replayed
+bool is_finished();
+
+// Called on every controller GET_CONDITION, returns the button state to report
+u16 poll(const u16 button_state);
+
+}
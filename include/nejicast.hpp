@@ -6,6 +6,7 @@
 #pragma once
 
 #include <common/config.hpp>
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 namespace nejicast {
@@ -19,6 +20,9 @@ void initialize(const common::Config& config);
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 void sideload(const u32 entry);
 
 }
@@ -0,0 +1,79 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <array>
+
+#include <common/types.hpp>
+
+// Host performance counters
+namespace perf {
+
+// Scopes measure self time, nested scopes are subtracted from their parent
+enum Scope {
+    SCOPE_OTHER,
+    SCOPE_CPU,
+    SCOPE_SCHEDULER,
+    SCOPE_TA,
+    SCOPE_RENDER,
+    SCOPE_TRIANGLE,
+    SCOPE_PRESENT,
+    NUM_SCOPES,
+};
+
+enum Counter {
+    COUNTER_INSTRUCTIONS,
+    COUNTER_EVENTS,
+    COUNTER_TA_BLOCKS,
+    COUNTER_STRIPS,
+    COUNTER_TRIANGLES,
+    COUNTER_CULLED_TRIANGLES,
+    COUNTER_PIXELS,
+    COUNTER_UPLOADED_ROWS,
+    NUM_COUNTERS,
+};
+
+struct FrameStats {
+    u64 frame;
+
+    f64 frame_time_ms;
+
+    std::array<f64, NUM_SCOPES> scope_time_ms;
+    std::array<u64, NUM_COUNTERS> counters;
+};
+
+// Dumps averages to stdout (and optionally a JSON Lines file) every dump_interval frames, 0 disables dumps
+void initialize(const int dump_interval, const char* json_path);
+void shutdown();
+
+bool is_enabled();
+
+// Returns the interrupted scope
+Scope enter_scope(const Scope scope);
+void exit_scope(const Scope parent_scope);
+
+void add(const Counter counter, const u64 value);
+
+void end_frame();
+
+// Stats of the most recent frame
+const FrameStats& get_frame_stats();
+
+const char* get_scope_name(const Scope scope);
+const char* get_counter_name(const Counter counter);
+
+class ScopedTimer {
+private:
+    const Scope parent_scope;
+public:
+    ScopedTimer(const Scope scope) : parent_scope(enter_scope(scope)) {}
+
+    ~ScopedTimer() {
+        exit_scope(parent_scope);
+    }
+};
+
+}
@@ -0,0 +1,27 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <common/types.hpp>
+
+// Guest PC sampling profiler
+namespace profiler {
+
+constexpr i64 DEFAULT_INTERVAL = 10000;
+
+// Samples the guest PC and shadow call stack every interval scheduler cycles.
+// Symbols are read from the ELF at elf_path, profiles are written to output_path on shutdown
+void initialize(const char* elf_path, const char* output_path, const i64 interval, const bool count_blocks);
+void shutdown();
+
+bool is_enabled();
+
+// CPU hooks
+void push_call(const u32 return_addr);
+void pop_call(const u32 return_addr);
+void count_block(const u32 addr);
+
+}
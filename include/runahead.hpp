@@ -0,0 +1,24 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <common/types.hpp>
+
+// Run-ahead input latency reduction
+namespace runahead {
+
+constexpr int MAX_FRAMES = 4;
+
+void initialize(const int num_frames);
+void shutdown();
+
+bool is_enabled();
+
+// Emulates the configured number of frames with the current input, then rolls back.
+// Every frame is rendered to VRAM, only the last speculative frame is scanned out
+void run_ahead();
+
+}
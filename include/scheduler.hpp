@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <common/state.hpp>
 #include <common/types.hpp>
 
 namespace scheduler {
@@ -13,6 +14,7 @@ typedef void (*Callback)(const int);
 
 constexpr i64 HOLLY_CLOCKRATE = 100000000;
 constexpr i64 PIXEL_CLOCKRATE = 13500000;
+constexpr i64 G2_CLOCKRATE = 25000000;
 
 // SH-4 clock
 constexpr i64 SCHEDULER_CLOCKRATE = 2 * HOLLY_CLOCKRATE;
@@ -21,6 +23,9 @@ void initialize();
 void reset();
 void shutdown();
 
+void save_state(common::StateWriter& writer);
+void load_state(common::StateReader& reader);
+
 template<i64 clockrate>
 i64 to_scheduler_cycles(const i64 cycles) {
     return (SCHEDULER_CLOCKRATE * cycles) / clockrate;
@@ -28,6 +33,12 @@ i64 to_scheduler_cycles(const i64 cycles) {
 
 void schedule_event(const char* name, Callback callback, const int arg, const i64 cycles);
 
+// Timestamp of the current time slice
+i64 get_timestamp();
+
+// Number of completed frames
+u64 get_frame_count();
+
 bool run();
 
 }
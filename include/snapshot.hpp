@@ -0,0 +1,32 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <common/types.hpp>
+
+// In-memory machine snapshots
+namespace snapshot {
+
+// Called for every page that changed since the last snapshot, before the shadow copy is updated
+typedef void (*PageCallback)(const int region, const u32 page, const u8* old_bytes, const u8* new_bytes);
+
+void initialize();
+void shutdown();
+
+bool is_initialized();
+
+// Commits all dirty guest RAM pages to the shadow copy and serializes all device state
+void save(std::vector<u8>& state, PageCallback callback = nullptr);
+
+// Reverts all dirty guest RAM pages from the shadow copy and deserializes all device state
+void restore(const std::vector<u8>& state);
+
+// Shadow copy of guest RAM as of the last snapshot
+u8* get_shadow_ptr(const int region);
+
+}
@@ -0,0 +1,50 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#pragma once
+
+#include <common/types.hpp>
+
+// Chrome trace-event export of the emulation timeline
+namespace trace {
+
+// Guest timeline tracks
+enum Track {
+    TRACK_SCHEDULER,
+    TRACK_INTERRUPTS,
+    TRACK_DMA,
+    TRACK_TA,
+    TRACK_RENDER,
+    NUM_TRACKS,
+};
+
+void initialize(const char* path);
+
+// Writes all buffered events to disk
+void shutdown();
+
+bool is_enabled();
+
+// Marks a point on the guest timeline at the current scheduler timestamp
+void guest_instant(const Track track, const char* name, const int arg);
+
+// Marks a guest operation that completes after the given number of scheduler cycles
+void guest_span(const Track track, const char* name, const int arg, const i64 cycles);
+
+void begin_host_span(const char* name);
+void end_host_span();
+
+class HostSpan {
+public:
+    HostSpan(const char* name) {
+        begin_host_span(name);
+    }
+
+    ~HostSpan() {
+        end_host_span();
+    }
+};
+
+}
@@ -0,0 +1,116 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <common/compress.hpp>
+
+#include <cassert>
+#include <cstring>
+
+namespace common {
+
+// Runs shorter than this are cheaper to store as literals
+constexpr usize MIN_ZERO_RUN = 4;
+
+static void write_varint(std::vector<u8>& compressed_bytes, usize n) {
+    while (n >= 0x80) {
+        compressed_bytes.push_back((u8)(n | 0x80));
+
+        n >>= 7;
+    }
+
+    compressed_bytes.push_back((u8)n);
+}
+
+static usize read_varint(const u8* compressed_bytes, usize& offset) {
+    usize n = 0;
+
+    for (usize shift = 0;; shift += 7) {
+        const u8 byte = compressed_bytes[offset++];
+
+        n |= (usize)(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0) {
+            return n;
+        }
+    }
+}
+
+static usize count_zeros(const u8* bytes, const usize size) {
+    usize count = 0;
+
+    // Skip 8 bytes at a time
+    while ((count + sizeof(u64)) <= size) {
+        u64 data;
+
+        std::memcpy(&data, &bytes[count], sizeof(data));
+
+        if (data != 0) {
+            break;
+        }
+
+        count += sizeof(data);
+    }
+
+    while ((count < size) && (bytes[count] == 0)) {
+        count++;
+    }
+
+    return count;
+}
+
+void compress(const u8* bytes, const usize size, std::vector<u8>& compressed_bytes) {
+    usize offset = 0;
+
+    // Stream of (zero run length, literal length, literals) tuples
+    while (offset < size) {
+        const usize zero_run = count_zeros(&bytes[offset], size - offset);
+
+        offset += zero_run;
+
+        usize literal_length = 0;
+
+        while ((offset + literal_length) < size) {
+            const usize next_zeros = count_zeros(&bytes[offset + literal_length], size - offset - literal_length);
+
+            if ((next_zeros >= MIN_ZERO_RUN) || ((offset + literal_length + next_zeros) == size)) {
+                break;
+            }
+
+            literal_length += next_zeros + 1;
+        }
+
+        write_varint(compressed_bytes, zero_run);
+        write_varint(compressed_bytes, literal_length);
+
+        compressed_bytes.insert(compressed_bytes.end(), &bytes[offset], &bytes[offset + literal_length]);
+
+        offset += literal_length;
+    }
+}
+
+usize decompress(const u8* compressed_bytes, u8* bytes, const usize size) {
+    usize compressed_offset = 0;
+    usize offset = 0;
+
+    while (offset < size) {
+        const usize zero_run = read_varint(compressed_bytes, compressed_offset);
+        const usize literal_length = read_varint(compressed_bytes, compressed_offset);
+
+        assert((offset + zero_run + literal_length) <= size);
+
+        std::memset(&bytes[offset], 0, zero_run);
+
+        offset += zero_run;
+
+        std::memcpy(&bytes[offset], &compressed_bytes[compressed_offset], literal_length);
+
+        offset += literal_length;
+        compressed_offset += literal_length;
+    }
+
+    return compressed_offset;
+}
+
+}
@@ -0,0 +1,226 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <common/cpu_trace.hpp>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+namespace common {
+
+constexpr u32 TRACE_MAGIC = 0x54434A4E; // "NJCT"
+constexpr u32 TRACE_VERSION = 1;
+
+constexpr usize BUFFER_SIZE = 1 << 20;
+
+constexpr const char* REGISTER_NAMES[NUM_TRACE_REGS - TRACE_REG_SR] = {
+    "SR",
+    "SSR",
+    "SPC",
+    "SGR",
+    "GBR",
+    "VBR",
+    "DBR",
+    "MACH",
+    "MACL",
+    "PR",
+    "FPSCR",
+    "FPUL",
+};
+
+const char* get_trace_register_name(const int reg) {
+    static char names[TRACE_REG_SR][16];
+    static char fpr_names[2 * 16][16];
+
+    assert(reg < NUM_TRACE_REGS);
+
+    if (reg < TRACE_REG_R0_BANKED) {
+        std::snprintf(names[reg], sizeof(names[reg]), "R%d", reg);
+
+        return names[reg];
+    } else if (reg < TRACE_REG_SR) {
+        std::snprintf(names[reg], sizeof(names[reg]), "R%d_BANK", reg - TRACE_REG_R0_BANKED);
+
+        return names[reg];
+    } else if (reg < TRACE_REG_FR0) {
+        return REGISTER_NAMES[reg - TRACE_REG_SR];
+    }
+
+    const int idx = reg - TRACE_REG_FR0;
+
+    std::snprintf(fpr_names[idx], sizeof(fpr_names[idx]), "%s%d", (idx < 16) ? "FR" : "XR", idx % 16);
+
+    return fpr_names[idx];
+}
+
+static void write_varint(std::vector<u8>& bytes, u64 n) {
+    while (n >= 0x80) {
+        bytes.push_back((u8)(n | 0x80));
+
+        n >>= 7;
+    }
+
+    bytes.push_back((u8)n);
+}
+
+static u64 to_zigzag(const i64 n) {
+    return ((u64)n << 1) ^ (u64)(n >> 63);
+}
+
+static i64 from_zigzag(const u64 n) {
+    return (i64)(n >> 1) ^ -(i64)(n & 1);
+}
+
+CpuTraceWriter::CpuTraceWriter(const char* path) : last_pc(0), last_regs{} {
+    file = std::fopen(path, "wb");
+
+    if (file == nullptr) {
+        std::printf("Failed to open file \"%s\"\n", path);
+        exit(1);
+    }
+
+    const u32 header[2] = {TRACE_MAGIC, TRACE_VERSION};
+
+    std::fwrite(header, sizeof(header), 1, file);
+
+    buffer.reserve(BUFFER_SIZE + 1024);
+}
+
+CpuTraceWriter::~CpuTraceWriter() {
+    flush();
+
+    std::fclose(file);
+}
+
+void CpuTraceWriter::flush() {
+    std::fwrite(buffer.data(), sizeof(u8), buffer.size(), file);
+
+    buffer.clear();
+}
+
+void CpuTraceWriter::write(const CpuTraceRecord& record) {
+    write_varint(buffer, to_zigzag((i64)record.pc - (i64)(last_pc + sizeof(u16))));
+    write_varint(buffer, record.instr);
+    write_varint(buffer, record.cycles);
+
+    last_pc = record.pc;
+
+    write_varint(buffer, record.num_regs);
+
+    for (u8 i = 0; i < record.num_regs; i++) {
+        const u8 reg = record.reg_ids[i];
+
+        buffer.push_back(reg);
+
+        write_varint(buffer, record.reg_values[i] ^ last_regs[reg]);
+
+        last_regs[reg] = record.reg_values[i];
+    }
+
+    write_varint(buffer, record.num_memory_accesses);
+
+    for (u8 i = 0; i < record.num_memory_accesses; i++) {
+        const CpuTraceMemoryAccess& access = record.memory_accesses[i];
+
+        buffer.push_back(access.size | (access.is_write << 7));
+
+        write_varint(buffer, access.addr);
+        write_varint(buffer, access.data);
+    }
+
+    if (buffer.size() >= BUFFER_SIZE) {
+        flush();
+    }
+}
+
+CpuTraceReader::CpuTraceReader(const char* path) : last_pc(0), last_regs{} {
+    file = std::fopen(path, "rb");
+
+    if (file == nullptr) {
+        std::printf("Failed to open file \"%s\"\n", path);
+        exit(1);
+    }
+
+    u32 header[2];
+
+    if ((std::fread(header, sizeof(header), 1, file) != 1) || (header[0] != TRACE_MAGIC) || (header[1] != TRACE_VERSION)) {
+        std::printf("\"%s\" is not a CPU trace\n", path);
+        exit(1);
+    }
+}
+
+CpuTraceReader::~CpuTraceReader() {
+    std::fclose(file);
+}
+
+u64 CpuTraceReader::read_varint() {
+    u64 n = 0;
+
+    for (u64 shift = 0;; shift += 7) {
+        const int byte = std::fgetc(file);
+
+        if (byte == EOF) {
+            std::puts("Unexpected end of CPU trace");
+            exit(1);
+        }
+
+        n |= (u64)(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0) {
+            return n;
+        }
+    }
+}
+
+bool CpuTraceReader::read(CpuTraceRecord& record) {
+    const int first_byte = std::fgetc(file);
+
+    if (first_byte == EOF) {
+        return false;
+    }
+
+    std::ungetc(first_byte, file);
+
+    record.pc = last_pc + sizeof(u16) + (u32)from_zigzag(read_varint());
+    record.instr = read_varint();
+    record.cycles = read_varint();
+
+    last_pc = record.pc;
+
+    record.num_regs = read_varint();
+
+    assert(record.num_regs <= NUM_TRACE_REGS);
+
+    for (u8 i = 0; i < record.num_regs; i++) {
+        const u8 reg = std::fgetc(file);
+
+        assert(reg < NUM_TRACE_REGS);
+
+        record.reg_ids[i] = reg;
+        record.reg_values[i] = last_regs[reg] ^ (u32)read_varint();
+
+        last_regs[reg] = record.reg_values[i];
+    }
+
+    record.num_memory_accesses = read_varint();
+
+    assert(record.num_memory_accesses <= MAX_TRACE_MEMORY_ACCESSES);
+
+    for (u8 i = 0; i < record.num_memory_accesses; i++) {
+        CpuTraceMemoryAccess& access = record.memory_accesses[i];
+
+        const u8 flags = std::fgetc(file);
+
+        access.size = flags & 0x7F;
+        access.is_write = (flags >> 7) != 0;
+        access.addr = read_varint();
+        access.data = read_varint();
+    }
+
+    return true;
+}
+
+}
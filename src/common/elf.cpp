@@ -5,6 +5,7 @@
 
 #include <common/elf.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
@@ -20,6 +21,8 @@ namespace common {
 constexpr u32 ELF_SIGNATURE = 0x464C457F;
 
 constexpr usize PROGRAM_SEGMENT_SIZE = 0x20;
+constexpr usize SECTION_HEADER_SIZE = 0x28;
+constexpr usize SYMBOL_SIZE = 0x10;
 
 enum {
     ELF_OFFSET_SIGNATURE  = 0x00,
@@ -28,7 +31,9 @@ enum {
     ELF_OFFSET_TYPE       = 0x10,
     ELF_OFFSET_ENTRYPOINT = 0x18,
     ELF_OFFSET_PH_OFFSET  = 0x1C,
+    ELF_OFFSET_SH_OFFSET  = 0x20,
     ELF_OFFSET_PH_ENTRIES = 0x2C,
+    ELF_OFFSET_SH_ENTRIES = 0x30,
 };
 
 enum {
@@ -48,6 +53,30 @@ enum {
     PROGRAM_TYPE_LOAD = 1,
 };
 
+enum {
+    SH_OFFSET_TYPE        = 0x04,
+    SH_OFFSET_FILE_OFFSET = 0x10,
+    SH_OFFSET_SIZE        = 0x14,
+    SH_OFFSET_LINK        = 0x18,
+};
+
+enum {
+    SECTION_TYPE_SYMTAB = 2,
+};
+
+enum {
+    SYM_OFFSET_NAME  = 0x00,
+    SYM_OFFSET_VALUE = 0x04,
+    SYM_OFFSET_SIZE  = 0x08,
+    SYM_OFFSET_INFO  = 0x0C,
+    SYM_OFFSET_SHNDX = 0x0E,
+};
+
+enum {
+    SYMBOL_TYPE_NOTYPE = 0,
+    SYMBOL_TYPE_FUNC   = 2,
+};
+
 template<typename T>
 static T get(const std::vector<u8>& bytes, const usize offset) {
     assert((offset + sizeof(T)) <= bytes.size());
@@ -59,14 +88,18 @@ static T get(const std::vector<u8>& bytes, const usize offset) {
     return data;
 }
 
-void load_elf(const char* path) {
-    const std::vector<u8> elf_bytes = load_file(path);
-
-    // Sanity checks
+static void check_header(const std::vector<u8>& elf_bytes) {
     assert(get<u32>(elf_bytes, ELF_OFFSET_SIGNATURE) == ELF_SIGNATURE);
     assert(get<u8>(elf_bytes, ELF_OFFSET_CLASS) == 1);
     assert(get<u8>(elf_bytes, ELF_OFFSET_DATA) == 1);
     assert(get<u16>(elf_bytes, ELF_OFFSET_TYPE) == ELF_TYPE_EXECUTABLE);
+}
+
+void load_elf(const char* path) {
+    const std::vector<u8> elf_bytes = load_file(path);
+
+    // Sanity checks
+    check_header(elf_bytes);
 
     const u32 entry = get<u32>(elf_bytes, ELF_OFFSET_ENTRYPOINT);
 
@@ -109,4 +142,71 @@ void load_elf(const char* path) {
     }
 }
 
+std::vector<ElfSymbol> load_elf_symbols(const char* path) {
+    const std::vector<u8> elf_bytes = load_file(path);
+
+    check_header(elf_bytes);
+
+    const u32 sh_offset = get<u32>(elf_bytes, ELF_OFFSET_SH_OFFSET);
+    const u16 sh_num_entries = get<u16>(elf_bytes, ELF_OFFSET_SH_ENTRIES);
+
+    std::vector<ElfSymbol> symbols;
+
+    for (u16 sh_entry = 0; sh_entry < sh_num_entries; sh_entry++) {
+        const usize sh_base = sh_offset + sh_entry * SECTION_HEADER_SIZE;
+
+        if (get<u32>(elf_bytes, sh_base + SH_OFFSET_TYPE) != SECTION_TYPE_SYMTAB) {
+            continue;
+        }
+
+        const u32 symtab_offset = get<u32>(elf_bytes, sh_base + SH_OFFSET_FILE_OFFSET);
+        const u32 symtab_size = get<u32>(elf_bytes, sh_base + SH_OFFSET_SIZE);
+
+        // String table used by this symbol table
+        const usize strtab_base = sh_offset + get<u32>(elf_bytes, sh_base + SH_OFFSET_LINK) * SECTION_HEADER_SIZE;
+        const u32 strtab_offset = get<u32>(elf_bytes, strtab_base + SH_OFFSET_FILE_OFFSET);
+        const u32 strtab_size = get<u32>(elf_bytes, strtab_base + SH_OFFSET_SIZE);
+
+        for (u32 offset = 0; (offset + SYMBOL_SIZE) <= symtab_size; offset += SYMBOL_SIZE) {
+            const usize sym_base = symtab_offset + offset;
+
+            const u32 name_offset = get<u32>(elf_bytes, sym_base + SYM_OFFSET_NAME);
+            const u8 type = get<u8>(elf_bytes, sym_base + SYM_OFFSET_INFO) & 0xF;
+            const u16 section = get<u16>(elf_bytes, sym_base + SYM_OFFSET_SHNDX);
+
+            // Skip undefined symbols and anything that isn't code
+            if ((section == 0) || (name_offset == 0) || (name_offset >= strtab_size)) {
+                continue;
+            }
+
+            if ((type != SYMBOL_TYPE_FUNC) && (type != SYMBOL_TYPE_NOTYPE)) {
+                continue;
+            }
+
+            const char* name = (const char*)&elf_bytes[strtab_offset + name_offset];
+
+            // Local labels
+            if ((name[0] == '$') || (std::strncmp(name, ".L", 2) == 0)) {
+                continue;
+            }
+
+            symbols.emplace_back(
+                ElfSymbol{
+                    .addr = get<u32>(elf_bytes, sym_base + SYM_OFFSET_VALUE),
+                    .size = get<u32>(elf_bytes, sym_base + SYM_OFFSET_SIZE),
+                    .name = name
+                }
+            );
+        }
+    }
+
+    std::sort(symbols.begin(), symbols.end(), [](const ElfSymbol& a, const ElfSymbol& b) {
+        return a.addr < b.addr;
+    });
+
+    std::printf("ELF loaded %zu symbols\n", symbols.size());
+
+    return symbols;
+}
+
 }
@@ -0,0 +1,25 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <common/hash.hpp>
+
+namespace common {
+
+constexpr u64 FNV_OFFSET_BASIS = 0xCBF29CE484222325;
+constexpr u64 FNV_PRIME = 0x00000100000001B3;
+
+u64 hash_bytes(const void* bytes, const usize size) {
+    const u8* data = (const u8*)bytes;
+
+    u64 hash = FNV_OFFSET_BASIS;
+
+    for (usize i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+}
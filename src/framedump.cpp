@@ -0,0 +1,379 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <framedump.hpp>
+
+#include <array>
+#include <cassert>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nejicast.hpp>
+#include <scheduler.hpp>
+
+namespace framedump {
+
+using nejicast::SCREEN_WIDTH;
+using nejicast::SCREEN_HEIGHT;
+
+constexpr usize NUM_PIXELS = SCREEN_WIDTH * SCREEN_HEIGHT;
+
+constexpr u32 RAW_MAGIC = 0x464D4A4E; // "NJMF"
+
+// Precedes every frame of a raw video
+struct RawFrameHeader {
+    u32 magic;
+    u32 width;
+    u32 height;
+    u32 reserved;
+
+    // Guest time
+    u64 timestamp_ns;
+    u64 frame;
+};
+
+static_assert(sizeof(RawFrameHeader) == 32);
+
+struct Frame {
+    u64 number;
+    i64 timestamp;
+
+    std::vector<u32> pixels;
+};
+
+struct {
+    bool is_enabled;
+
+    Format format;
+    std::string path;
+
+    // Y4M and raw video
+    FILE* file;
+
+    std::array<Frame, NUM_BUFFERS> frames;
+
+    // Buffer indices, guarded by mutex
+    std::vector<int> free_frames;
+    std::queue<int> pending_frames;
+
+    bool is_stopping;
+
+    std::mutex mutex;
+    std::condition_variable has_work;
+
+    std::thread writer;
+
+    u64 num_submitted, num_dropped;
+} ctx;
+
+static bool has_extension(const std::string& path, const char* extension) {
+    const usize length = std::strlen(extension);
+
+    return (path.size() >= length) && (path.compare(path.size() - length, length, extension) == 0);
+}
+
+static u32 crc32(const u8* bytes, const usize size, u32 crc = 0) {
+    static const auto table = [] {
+        std::array<u32, 256> table;
+
+        for (u32 i = 0; i < 256; i++) {
+            u32 c = i;
+
+            for (int bit = 0; bit < 8; bit++) {
+                c = ((c & 1) != 0) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+            }
+
+            table[i] = c;
+        }
+
+        return table;
+    }();
+
+    crc = ~crc;
+
+    for (usize i = 0; i < size; i++) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+static void append_u32_be(std::vector<u8>& bytes, const u32 data) {
+    for (int i = 3; i >= 0; i--) {
+        bytes.push_back(data >> (8 * i));
+    }
+}
+
+static void append_png_chunk(std::vector<u8>& png, const char* type, const std::vector<u8>& data) {
+    append_u32_be(png, data.size());
+
+    const usize type_offset = png.size();
+
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+
+    append_u32_be(png, crc32(&png[type_offset], 4 + data.size()));
+}
+
+// RGB PNG with stored (uncompressed) deflate blocks, trades file size for writer speed
+static void write_png(const Frame& frame) {
+    constexpr usize ROW_SIZE = 1 + 3 * SCREEN_WIDTH;
+    constexpr usize MAX_STORED_BLOCK = 0xFFFF;
+
+    std::vector<u8> image;
+
+    image.reserve(ROW_SIZE * SCREEN_HEIGHT);
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        // Filter type none
+        image.push_back(0);
+
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            const u32 pixel = frame.pixels[SCREEN_WIDTH * y + x];
+
+            image.push_back(pixel >> 16);
+            image.push_back(pixel >> 8);
+            image.push_back(pixel);
+        }
+    }
+
+    std::vector<u8> zlib{0x78, 0x01};
+
+    for (usize offset = 0; offset < image.size(); offset += MAX_STORED_BLOCK) {
+        const u16 size = std::min(MAX_STORED_BLOCK, image.size() - offset);
+
+        zlib.push_back((offset + size) == image.size());
+        zlib.push_back(size);
+        zlib.push_back(size >> 8);
+        zlib.push_back(~size);
+        zlib.push_back(~size >> 8);
+        zlib.insert(zlib.end(), &image[offset], &image[offset] + size);
+    }
+
+    u32 a = 1, b = 0;
+
+    for (const u8 byte : image) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    append_u32_be(zlib, (b << 16) | a);
+
+    std::vector<u8> header;
+
+    append_u32_be(header, SCREEN_WIDTH);
+    append_u32_be(header, SCREEN_HEIGHT);
+
+    // 8-bit RGB, no interlacing
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+
+    std::vector<u8> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    append_png_chunk(png, "IHDR", header);
+    append_png_chunk(png, "IDAT", zlib);
+    append_png_chunk(png, "IEND", {});
+
+    char path[512];
+
+    std::snprintf(path, sizeof(path), "%s-%06llu.png", ctx.path.c_str(), frame.number);
+
+    FILE* file = std::fopen(path, "wb");
+
+    if (file == nullptr) {
+        std::printf("Failed to open file \"%s\"\n", path);
+        exit(1);
+    }
+
+    std::fwrite(png.data(), sizeof(u8), png.size(), file);
+    std::fclose(file);
+}
+
+// BT.601 limited range, 4:4:4 planes
+static void write_y4m(const Frame& frame) {
+    std::vector<u8> planes(3 * NUM_PIXELS);
+
+    for (usize i = 0; i < NUM_PIXELS; i++) {
+        const int r = (frame.pixels[i] >> 16) & 0xFF;
+        const int g = (frame.pixels[i] >>  8) & 0xFF;
+        const int b = (frame.pixels[i] >>  0) & 0xFF;
+
+        planes[i] = (( 66 * r + 129 * g +  25 * b + 128) >> 8) + 16;
+        planes[i + NUM_PIXELS] = ((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128;
+        planes[i + 2 * NUM_PIXELS] = ((112 * r -  94 * g -  18 * b + 128) >> 8) + 128;
+    }
+
+    std::fputs("FRAME\n", ctx.file);
+    std::fwrite(planes.data(), sizeof(u8), planes.size(), ctx.file);
+}
+
+static void write_raw(const Frame& frame) {
+    const RawFrameHeader header{
+        .magic = RAW_MAGIC,
+        .width = SCREEN_WIDTH,
+        .height = SCREEN_HEIGHT,
+        .reserved = 0,
+        .timestamp_ns = (u64)((1E9 * (f64)frame.timestamp) / (f64)scheduler::SCHEDULER_CLOCKRATE),
+        .frame = frame.number
+    };
+
+    std::fwrite(&header, sizeof(header), 1, ctx.file);
+    std::fwrite(frame.pixels.data(), sizeof(u32), NUM_PIXELS, ctx.file);
+}
+
+static void write_frame(const Frame& frame) {
+    switch (ctx.format) {
+        case FORMAT_PNG:
+            write_png(frame);
+            break;
+        case FORMAT_Y4M:
+            write_y4m(frame);
+            break;
+        case FORMAT_RAW:
+            write_raw(frame);
+            break;
+    }
+}
+
+static void run_writer() {
+    std::unique_lock lock(ctx.mutex);
+
+    while (true) {
+        ctx.has_work.wait(lock, [] { return ctx.is_stopping || !ctx.pending_frames.empty(); });
+
+        if (ctx.pending_frames.empty()) {
+            // Stopping and drained
+            return;
+        }
+
+        const int idx = ctx.pending_frames.front();
+
+        ctx.pending_frames.pop();
+
+        lock.unlock();
+
+        write_frame(ctx.frames[idx]);
+
+        lock.lock();
+
+        ctx.free_frames.push_back(idx);
+    }
+}
+
+void initialize(const char* path) {
+    assert(!ctx.is_enabled);
+
+    ctx.path = path;
+
+    if (has_extension(ctx.path, ".y4m")) {
+        ctx.format = FORMAT_Y4M;
+    } else if (has_extension(ctx.path, ".raw")) {
+        ctx.format = FORMAT_RAW;
+    } else {
+        ctx.format = FORMAT_PNG;
+
+        if (has_extension(ctx.path, ".png")) {
+            ctx.path.resize(ctx.path.size() - 4);
+        }
+    }
+
+    if (ctx.format != FORMAT_PNG) {
+        ctx.file = std::fopen(path, "wb");
+
+        if (ctx.file == nullptr) {
+            std::printf("Failed to open file \"%s\"\n", path);
+            exit(1);
+        }
+    }
+
+    if (ctx.format == FORMAT_Y4M) {
+        // Emulated frame rate, frames are written as they are rendered
+        std::fprintf(ctx.file, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
+
+    ctx.free_frames.clear();
+
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        ctx.frames[i].pixels.resize(NUM_PIXELS);
+
+        ctx.free_frames.push_back(i);
+    }
+
+    ctx.num_submitted = 0;
+    ctx.num_dropped = 0;
+
+    ctx.is_stopping = false;
+    ctx.is_enabled = true;
+
+    ctx.writer = std::thread(run_writer);
+}
+
+void shutdown() {
+    {
+        std::lock_guard lock(ctx.mutex);
+
+        ctx.is_stopping = true;
+    }
+
+    ctx.has_work.notify_one();
+    ctx.writer.join();
+
+    if (ctx.file != nullptr) {
+        std::fclose(ctx.file);
+
+        ctx.file = nullptr;
+    }
+
+    std::printf("Dumped %llu frames (%llu dropped)\n", ctx.num_submitted - ctx.num_dropped, ctx.num_dropped);
+
+    ctx.is_enabled = false;
+}
+
+bool is_enabled() {
+    return ctx.is_enabled;
+}
+
+void submit_frame(const u32* pixels, const i64 timestamp) {
+    int idx;
+
+    {
+        std::lock_guard lock(ctx.mutex);
+
+        ctx.num_submitted++;
+
+        if (ctx.free_frames.empty()) {
+            ctx.num_dropped++;
+
+            return;
+        }
+
+        idx = ctx.free_frames.back();
+
+        ctx.free_frames.pop_back();
+    }
+
+    Frame& frame = ctx.frames[idx];
+
+    frame.number = ctx.num_submitted - 1;
+    frame.timestamp = timestamp;
+
+    std::memcpy(frame.pixels.data(), pixels, sizeof(u32) * NUM_PIXELS);
+
+    {
+        std::lock_guard lock(ctx.mutex);
+
+        ctx.pending_frames.push(idx);
+    }
+
+    ctx.has_work.notify_one();
+}
+
+}
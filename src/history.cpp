@@ -0,0 +1,197 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <history.hpp>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include <snapshot.hpp>
+#include <common/compress.hpp>
+#include <hw/holly/bus.hpp>
+#include <hw/pvr/core.hpp>
+
+namespace history {
+
+using hw::holly::bus::PAGE_SIZE;
+
+struct PageHeader {
+    u32 region;
+    u32 page;
+    u32 compressed_size;
+};
+
+struct Frame {
+    // Compressed device state
+    std::vector<u8> state;
+    usize state_size;
+
+    // Compressed XOR deltas to the previous frame, stored as (PageHeader, bytes) pairs
+    std::vector<u8> deltas;
+
+    usize get_size() const {
+        return state.capacity() + deltas.capacity();
+    }
+};
+
+struct {
+    std::deque<Frame> frames;
+
+    usize max_bytes, used_bytes;
+
+    // Uncompressed state of the most recent frame
+    std::vector<u8> latest_state;
+
+    // Frame being built by capture_frame()
+    Frame* current_frame;
+
+    bool is_enabled;
+} ctx;
+
+static void add_delta(const int region, const u32 page, const u8* old_bytes, const u8* new_bytes) {
+    u8 delta[PAGE_SIZE];
+
+    for (usize i = 0; i < PAGE_SIZE; i++) {
+        delta[i] = old_bytes[i] ^ new_bytes[i];
+    }
+
+    auto& deltas = ctx.current_frame->deltas;
+
+    const usize header_offset = deltas.size();
+
+    deltas.resize(header_offset + sizeof(PageHeader));
+
+    common::compress(delta, PAGE_SIZE, deltas);
+
+    const PageHeader header{
+        .region = (u32)region,
+        .page = page,
+        .compressed_size = (u32)(deltas.size() - header_offset - sizeof(PageHeader))
+    };
+
+    std::memcpy(&deltas[header_offset], &header, sizeof(header));
+}
+
+// Applies a frame's deltas to the shadow copies and copies the results back
+static void revert_deltas(const Frame& frame) {
+    usize offset = 0;
+
+    while (offset < frame.deltas.size()) {
+        PageHeader header;
+
+        std::memcpy(&header, &frame.deltas[offset], sizeof(header));
+
+        offset += sizeof(header);
+
+        u8 delta[PAGE_SIZE];
+
+        common::decompress(&frame.deltas[offset], delta, PAGE_SIZE);
+
+        offset += header.compressed_size;
+
+        u8* shadow_mem = snapshot::get_shadow_ptr(header.region) + PAGE_SIZE * header.page;
+        u8* mem = hw::holly::bus::get_memory_ptr(header.region) + PAGE_SIZE * header.page;
+
+        for (usize i = 0; i < PAGE_SIZE; i++) {
+            shadow_mem[i] ^= delta[i];
+        }
+
+        std::memcpy(mem, shadow_mem, PAGE_SIZE);
+    }
+}
+
+void initialize(const usize max_bytes) {
+    if (!snapshot::is_initialized()) {
+        snapshot::initialize();
+    }
+
+    ctx.max_bytes = max_bytes;
+    ctx.used_bytes = 0;
+
+    ctx.is_enabled = true;
+}
+
+void shutdown() {
+    ctx.frames.clear();
+
+    ctx.is_enabled = false;
+}
+
+bool is_enabled() {
+    return ctx.is_enabled;
+}
+
+void capture_frame() {
+    assert(ctx.is_enabled);
+
+    Frame& frame = ctx.frames.emplace_back();
+
+    ctx.current_frame = &frame;
+
+    snapshot::save(ctx.latest_state, add_delta);
+
+    ctx.current_frame = nullptr;
+
+    frame.state_size = ctx.latest_state.size();
+
+    common::compress(ctx.latest_state.data(), ctx.latest_state.size(), frame.state);
+
+    frame.state.shrink_to_fit();
+    frame.deltas.shrink_to_fit();
+
+    ctx.used_bytes += frame.get_size();
+
+    // Drop the oldest frames, the newest frame is always kept
+    while ((ctx.used_bytes > ctx.max_bytes) && (ctx.frames.size() > 1)) {
+        ctx.used_bytes -= ctx.frames.front().get_size();
+
+        ctx.frames.pop_front();
+    }
+}
+
+bool step_back() {
+    assert(ctx.is_enabled);
+
+    if (ctx.frames.size() < 2) {
+        return false;
+    }
+
+    // Discard anything that happened after the latest capture
+    snapshot::restore(ctx.latest_state);
+
+    const Frame& latest_frame = ctx.frames.back();
+
+    revert_deltas(latest_frame);
+
+    ctx.used_bytes -= latest_frame.get_size();
+
+    ctx.frames.pop_back();
+
+    const Frame& frame = ctx.frames.back();
+
+    ctx.latest_state.resize(frame.state_size);
+
+    common::decompress(frame.state.data(), ctx.latest_state.data(), frame.state_size);
+
+    snapshot::restore(ctx.latest_state);
+
+    // Rebuild the displayed frame from the restored VRAM, changed rows are marked dirty
+    hw::pvr::core::force_scan_out();
+
+    return true;
+}
+
+usize get_num_frames() {
+    return ctx.frames.size();
+}
+
+usize get_used_bytes() {
+    return ctx.used_bytes;
+}
+
+}
@@ -209,6 +209,14 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 // Simulates DRAM refresh
 static void refresh_dram() {
     constexpr u16 COUNT_LIMIT[2] = {1024, 512};
@@ -106,6 +106,14 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 u32 get_mmu_control() {
     return MMUCR.raw;
 }
@@ -66,6 +66,14 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 u8 get_watchdog_timer_control() {
     return WTCNT;
 }
@@ -15,8 +15,16 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include <perf.hpp>
+#include <profiler.hpp>
+#include <trace.hpp>
+#include <common/cpu_trace.hpp>
 #include <hw/cpu/ccn.hpp>
 #include <hw/cpu/ocio.hpp>
 #include <hw/cpu/tmu.hpp>
@@ -146,6 +154,89 @@ struct {
     i64 cycles;
 } ctx;
 
+// Host-side settings, not part of the saved state
+static struct {
+    bool track_calls;
+    bool count_blocks;
+} profiler_hooks;
+
+constexpr usize NUM_HISTOGRAM_ENTRIES = 30;
+
+// FPSCR.PR, FPSCR.SZ, FPSCR.FR
+constexpr usize NUM_FPU_MODES = 8;
+
+// Instruction histogram, only updated when enabled
+static struct {
+    bool is_enabled;
+
+    std::array<const char*, INSTR_TABLE_SIZE> instr_names;
+
+    std::array<u64, INSTR_TABLE_SIZE> opcode_counts;
+
+    // FPU instructions per mode
+    std::array<u64, NUM_FPU_MODES> fpu_mode_counts;
+} histogram;
+
+// Execution trace recorder
+static struct {
+    common::CpuTraceWriter* writer;
+
+    // Set while an instruction executes, so instruction fetches aren't recorded
+    bool is_recording;
+
+    u64 num_instrs, max_instrs;
+
+    common::CpuTraceRecord record;
+} cpu_trace;
+
+// Store queue flushes are logged in order with the writes, as size 0
+constexpr u8 LOCKSTEP_SQ_FLUSH = 0;
+
+struct LockstepWrite {
+    u32 addr;
+    u8 size;
+    u64 data;
+
+    bool operator==(const LockstepWrite& other) const = default;
+};
+
+// Lockstep differential testing, see run_lockstep()
+static struct {
+    bool is_enabled;
+
+    // Set while an engine runs, routes data accesses through the overlay
+    bool is_active;
+
+    // Set by accesses to anything but mapped memory, the engine ends its block after the instruction
+    bool has_device_access;
+
+    std::array<Engine, 2> engines;
+    int current_engine;
+
+    // Byte-granular copy-on-write view of memory for the running engine, keyed by physical address
+    std::unordered_map<u32, u8> overlay;
+
+    std::array<std::vector<LockstepWrite>, 2> writes;
+
+    std::vector<u8> start_registers;
+    std::array<std::vector<u8>, 2> end_registers;
+
+    u64 num_blocks;
+} lockstep;
+
+static void add_trace_memory_access(const u32 addr, const u8 size, const u64 data, const bool is_write) {
+    common::CpuTraceRecord& record = cpu_trace.record;
+
+    assert(record.num_memory_accesses < common::MAX_TRACE_MEMORY_ACCESSES);
+
+    record.memory_accesses[record.num_memory_accesses++] = common::CpuTraceMemoryAccess{
+        .addr = addr,
+        .size = size,
+        .is_write = is_write,
+        .data = data
+    };
+}
+
 static void set_state(const int state) {
     ctx.state = state;
 }
@@ -315,6 +406,10 @@ static void jump(const u32 addr) {
     PC = addr;
     NPC = addr + sizeof(u16);
 
+    if (profiler_hooks.count_blocks) {
+        profiler::count_block(addr);
+    }
+
     // add_jump_target(addr);
 }
 
@@ -323,6 +418,10 @@ static void delayed_jump(const u32 addr) {
 
     NPC = addr;
 
+    if (profiler_hooks.count_blocks) {
+        profiler::count_block(addr);
+    }
+
     // add_jump_target(addr);
 }
 
@@ -489,12 +588,66 @@ enum : u32 {
 constexpr u32 P0_MASK = 0x7FFFFFFF;
 constexpr u32 PRIV_MASK = 0x1FFFFFFF;
 
+// Mapped memory in P1 or P2, P4 and bus devices are not
+static bool is_lockstep_memory(const u32 addr, const u32 size, const bool is_write) {
+    if ((addr < REGION_P1) || (addr >= REGION_P3)) {
+        return false;
+    }
+
+    if (is_write) {
+        return hw::holly::bus::get_write_span(addr & PRIV_MASK, size) != nullptr;
+    }
+
+    return hw::holly::bus::get_read_span(addr & PRIV_MASK, size) != nullptr;
+}
+
+// Device writes are still deferred, the block ends after them so they are committed in order
+static void add_lockstep_write(const u32 addr, const u8 size, const u64 data) {
+    lockstep.writes[lockstep.current_engine].push_back(LockstepWrite{.addr = addr, .size = size, .data = data});
+
+    if (!is_lockstep_memory(addr, size, true)) {
+        lockstep.has_device_access = true;
+
+        return;
+    }
+
+    // P1 and P2 alias the same memory
+    const u32 physical_addr = addr & PRIV_MASK;
+
+    for (u8 i = 0; i < size; i++) {
+        lockstep.overlay[physical_addr + i] = data >> (8 * i);
+    }
+}
+
+template<typename T>
+static T apply_lockstep_overlay(const u32 addr, T data) {
+    if (!is_lockstep_memory(addr, sizeof(T), false)) {
+        lockstep.has_device_access = true;
+
+        return data;
+    }
+
+    const u32 physical_addr = addr & PRIV_MASK;
+
+    for (u32 i = 0; i < sizeof(T); i++) {
+        const auto it = lockstep.overlay.find(physical_addr + i);
+
+        if (it != lockstep.overlay.end()) {
+            data = (data & ~((T)0xFF << (8 * i))) | ((T)it->second << (8 * i));
+        }
+    }
+
+    return data;
+}
+
 template<typename T>
 static T read(const u32 addr) {
     assert(SR.is_privileged);
     
     u32 masked_addr = addr & PRIV_MASK;
 
+    T data;
+
     if (addr < REGION_P1) {
         masked_addr = addr & P0_MASK;
 
@@ -503,16 +656,26 @@ static T read(const u32 addr) {
     } else if (addr < REGION_P2) {
         // P1, cacheable
         // TODO: implement caches?
-        return hw::holly::bus::read<T>(masked_addr);
+        data = hw::holly::bus::read<T>(masked_addr);
     } else if (addr < REGION_P3) {
         // P2, non-cacheable
-        return hw::holly::bus::read<T>(masked_addr);
+        data = hw::holly::bus::read<T>(masked_addr);
     } else if (addr < REGION_P4) {
         std::printf("Unimplemented P3 read%zu @ %08X\n", 8 * sizeof(T), masked_addr);
         exit(1);
     } else {
-        return ocio::read<T>(masked_addr);
+        data = ocio::read<T>(masked_addr);
+    }
+
+    if (lockstep.is_active) {
+        data = apply_lockstep_overlay(addr, data);
     }
+
+    if (cpu_trace.is_recording) {
+        add_trace_memory_access(addr, sizeof(T), (u64)data, false);
+    }
+
+    return data;
 }
 
 static u16 fetch_instr() {
@@ -530,6 +693,17 @@ static u16 fetch_instr() {
 template<typename T>
 static void write(const u32 addr, const T data) {
     assert(SR.is_privileged);
+
+    if (cpu_trace.is_recording) {
+        add_trace_memory_access(addr, sizeof(T), (u64)data, true);
+    }
+
+    if (lockstep.is_active) {
+        // Committed once both engines agree
+        add_lockstep_write(addr, sizeof(T), data);
+
+        return;
+    }
     
     u32 masked_addr = addr & PRIV_MASK;
 
@@ -650,6 +824,10 @@ template<bool is_linked, bool is_displacement>
 static i64 i_bra(const u16 instr) {
     if constexpr (is_linked) {
         PR = PC_DELAY;
+
+        if (profiler_hooks.track_calls) {
+            profiler::push_call(PR);
+        }
     }
 
     u32 offset;
@@ -1195,6 +1373,10 @@ static i64 i_jmp(const u16 instr) {
 static i64 i_jsr(const u16 instr) {
     PR = PC_DELAY;
 
+    if (profiler_hooks.track_calls) {
+        profiler::push_call(PR);
+    }
+
     delayed_jump(GPRS[N]);
 
     return 3;
@@ -1549,7 +1731,16 @@ static i64 i_pref(const u16 instr) {
     // std::printf("SH-4 operand cache prefetch @ %08X\n", GPRS[N]);
 
     if (GPRS[N] >= REGION_P4) {
-        ocio::flush_store_queue(GPRS[N] & PRIV_MASK);
+        if (lockstep.is_active) {
+            // Store queue contents are only written on commit, flush them then
+            lockstep.writes[lockstep.current_engine].push_back(
+                LockstepWrite{.addr = GPRS[N] & PRIV_MASK, .size = LOCKSTEP_SQ_FLUSH, .data = 0}
+            );
+
+            lockstep.has_device_access = true;
+        } else {
+            ocio::flush_store_queue(GPRS[N] & PRIV_MASK);
+        }
     }
 
     return 1;
@@ -1584,6 +1775,10 @@ static i64 i_rotcr(const u16 instr) {
 }
 
 static i64 i_rte(const u16) {
+    if (profiler_hooks.track_calls) {
+        profiler::pop_call(SPC);
+    }
+
     set_sr(SSR.raw);
 
     delayed_jump(SPC);
@@ -1592,6 +1787,10 @@ static i64 i_rte(const u16) {
 }
 
 static i64 i_rts(const u16) {
+    if (profiler_hooks.track_calls) {
+        profiler::pop_call(PR);
+    }
+
     delayed_jump(PR);
 
     return 3;
@@ -1793,205 +1992,270 @@ static i64 i_xtrct(const u16 instr) {
     return 1;
 }
 
+// Fills the handler table and the handler name table used by the instruction histogram
+#define FILL_INSTR(pattern, ...)                                                 \
+    fill_table_with_pattern(ctx.instr_table.data(), pattern, __VA_ARGS__);       \
+    fill_table_with_pattern(histogram.instr_names.data(), pattern, #__VA_ARGS__)
+
 static void initialize_instr_table() {
     ctx.instr_table.fill(i_undefined);
+    histogram.instr_names.fill("i_undefined");
+
+    FILL_INSTR("0000xxxx00000010", i_stc<ControlRegister::Sr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000xxxx00000011", i_bra<true, false>);
+    FILL_INSTR("0000xxxxxxxx0100", i_movs0<OperandSize::Byte>);
+    FILL_INSTR("0000xxxxxxxx0101", i_movs0<OperandSize::Word>);
+    FILL_INSTR("0000xxxxxxxx0110", i_movs0<OperandSize::Long>);
+    FILL_INSTR("0000xxxxxxxx0111", i_mull);
+    FILL_INSTR("0000000000001000", i_clrt);
+    FILL_INSTR("0000000000001001", i_nop);
+    FILL_INSTR("0000xxxx00001010", i_sts<SystemRegister::Mach, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000000000001011", i_rts);
+    FILL_INSTR("0000xxxxxxxx1100", i_movl0<OperandSize::Byte>);
+    FILL_INSTR("0000xxxxxxxx1101", i_movl0<OperandSize::Word>);
+    FILL_INSTR("0000xxxxxxxx1110", i_movl0<OperandSize::Long>);
+    FILL_INSTR("0000xxxx00010010", i_stc<ControlRegister::Gbr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000000000011000", i_sett);
+    FILL_INSTR("0000000000011001", i_div0<false>);
+    FILL_INSTR("0000xxxx00011010", i_sts<SystemRegister::Macl, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000000000011011", i_sleep);
+    FILL_INSTR("0000xxxx00100010", i_stc<ControlRegister::Vbr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000xxxx00100011", i_bra<false, false>);
+    FILL_INSTR("0000xxxx00101001", i_movt);
+    FILL_INSTR("0000xxxx00101010", i_sts<SystemRegister::Pr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000000000101011", i_rte);
+    FILL_INSTR("0000xxxx00110010", i_stc<ControlRegister::Ssr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000xxxx01000010", i_stc<ControlRegister::Spc, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000000001001000", i_clrs);
+    FILL_INSTR("0000xxxx01011010", i_sts<SystemRegister::Fpul, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000xxxx01101010", i_sts<SystemRegister::Fpscr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000xxxx1xxx0010", i_stc<ControlRegister::Rbank, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0000xxxx10000011", i_pref);
+    FILL_INSTR("0000xxxx10010011", i_ocbi);
+    FILL_INSTR("0000xxxx10100011", i_ocbp);
+    FILL_INSTR("0000xxxx10110011", i_ocbwb);
+    FILL_INSTR("0000xxxx11000011", i_movca);
+    FILL_INSTR("0000xxxx11111010", i_stc<ControlRegister::Dbr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0001xxxxxxxxxxxx", i_movs4<OperandSize::Long>);
+    FILL_INSTR("0010xxxxxxxx0000", i_movs<OperandSize::Byte>);
+    FILL_INSTR("0010xxxxxxxx0001", i_movs<OperandSize::Word>);
+    FILL_INSTR("0010xxxxxxxx0010", i_movs<OperandSize::Long>);
+    FILL_INSTR("0010xxxxxxxx0100", i_movm<OperandSize::Byte>);
+    FILL_INSTR("0010xxxxxxxx0101", i_movm<OperandSize::Word>);
+    FILL_INSTR("0010xxxxxxxx0110", i_movm<OperandSize::Long>);
+    FILL_INSTR("0010xxxxxxxx0111", i_div0<true>);
+    FILL_INSTR("0010xxxxxxxx1000", i_tst<AddressingMode::RegisterDirect>);
+    FILL_INSTR("0010xxxxxxxx1001", i_and<AddressingMode::RegisterDirect>);
+    FILL_INSTR("0010xxxxxxxx1010", i_xor<AddressingMode::RegisterDirect>);
+    FILL_INSTR("0010xxxxxxxx1011", i_or<AddressingMode::RegisterDirect>);
+    FILL_INSTR("0010xxxxxxxx1100", i_cmp<Comparison::String>);
+    FILL_INSTR("0010xxxxxxxx1101", i_xtrct);
+    FILL_INSTR("0010xxxxxxxx1110", i_mulu);
+    FILL_INSTR("0010xxxxxxxx1111", i_muls);
+    FILL_INSTR("0011xxxxxxxx0000", i_cmp<Comparison::Equal>);
+    FILL_INSTR("0011xxxxxxxx0010", i_cmp<Comparison::HigherSame>);
+    FILL_INSTR("0011xxxxxxxx0011", i_cmp<Comparison::GreaterEqual>);
+    FILL_INSTR("0011xxxxxxxx0100", i_div1);
+    FILL_INSTR("0011xxxxxxxx0101", i_dmulu);
+    FILL_INSTR("0011xxxxxxxx0110", i_cmp<Comparison::Higher>);
+    FILL_INSTR("0011xxxxxxxx0111", i_cmp<Comparison::GreaterThan>);
+    FILL_INSTR("0011xxxxxxxx1000", i_sub);
+    FILL_INSTR("0011xxxxxxxx1010", i_subc);
+    FILL_INSTR("0011xxxxxxxx1100", i_add<false>);
+    FILL_INSTR("0011xxxxxxxx1101", i_dmuls);
+    FILL_INSTR("0011xxxxxxxx1110", i_addc);
+    FILL_INSTR("0100xxxx00000000", i_shll<1>);
+    FILL_INSTR("0100xxxx00000001", i_shlr<1>);
+    FILL_INSTR("0100xxxx00000010", i_sts<SystemRegister::Mach, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx00000011", i_stc<ControlRegister::Sr, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx00000101", i_rotr);
+    FILL_INSTR("0100xxxx00000110", i_lds<SystemRegister::Mach, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx00000111", i_ldc<ControlRegister::Sr, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx00001000", i_shll<2>);
+    FILL_INSTR("0100xxxx00001001", i_shlr<2>);
+    FILL_INSTR("0100xxxx00001010", i_lds<SystemRegister::Mach, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0100xxxx00001011", i_jsr);
+    FILL_INSTR("0100xxxxxxxx1100", i_shad);
+    FILL_INSTR("0100xxxxxxxx1101", i_shld);
+    FILL_INSTR("0100xxxx00001110", i_ldc<ControlRegister::Sr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0100xxxx00010000", i_dt);
+    FILL_INSTR("0100xxxx00010001", i_cmp<Comparison::PositiveZero>);
+    FILL_INSTR("0100xxxx00010010", i_sts<SystemRegister::Macl, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx00010011", i_stc<ControlRegister::Gbr, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx00010101", i_cmp<Comparison::Positive>);
+    FILL_INSTR("0100xxxx00010110", i_lds<SystemRegister::Macl, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx00010111", i_ldc<ControlRegister::Gbr, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx00011000", i_shll<8>);
+    FILL_INSTR("0100xxxx00011001", i_shlr<8>);
+    FILL_INSTR("0100xxxx00011010", i_lds<SystemRegister::Macl, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0100xxxx00011011", i_tas);
+    FILL_INSTR("0100xxxx00011110", i_ldc<ControlRegister::Gbr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0100xxxx00100001", i_shar);
+    FILL_INSTR("0100xxxx00100010", i_sts<SystemRegister::Pr, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx00100011", i_stc<ControlRegister::Vbr, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx00100100", i_rotcl);
+    FILL_INSTR("0100xxxx00100101", i_rotcr);
+    FILL_INSTR("0100xxxx00100110", i_lds<SystemRegister::Pr, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx00100111", i_ldc<ControlRegister::Vbr, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx00101000", i_shll<16>);
+    FILL_INSTR("0100xxxx00101001", i_shlr<16>);
+    FILL_INSTR("0100xxxx00101010", i_lds<SystemRegister::Pr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0100xxxx00101011", i_jmp);
+    FILL_INSTR("0100xxxx00101110", i_ldc<ControlRegister::Vbr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0100xxxx00110011", i_stc<ControlRegister::Ssr, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx00110111", i_ldc<ControlRegister::Ssr, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx00111110", i_ldc<ControlRegister::Ssr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0100xxxx01000011", i_stc<ControlRegister::Spc, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx01000111", i_ldc<ControlRegister::Spc, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx01001110", i_ldc<ControlRegister::Spc, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0100xxxx01010010", i_sts<SystemRegister::Fpul, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx01010110", i_lds<SystemRegister::Fpul, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx01011010", i_lds<SystemRegister::Fpul, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0100xxxx01100010", i_sts<SystemRegister::Fpscr, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx01100110", i_lds<SystemRegister::Fpscr, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx01101010", i_lds<SystemRegister::Fpscr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0100xxxx1xxx0011", i_stc<ControlRegister::Rbank, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx1xxx0111", i_ldc<ControlRegister::Rbank, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx11110010", i_stc<ControlRegister::Dbr, AddressingMode::RegisterIndirectPredecrement>);
+    FILL_INSTR("0100xxxx11110110", i_ldc<ControlRegister::Dbr, AddressingMode::RegisterIndirectPostincrement>);
+    FILL_INSTR("0100xxxx11111010", i_ldc<ControlRegister::Dbr, AddressingMode::RegisterDirect>);
+    FILL_INSTR("0101xxxxxxxxxxxx", i_movl4<OperandSize::Long>);
+    FILL_INSTR("0110xxxxxxxx0000", i_movl<OperandSize::Byte>);
+    FILL_INSTR("0110xxxxxxxx0001", i_movl<OperandSize::Word>);
+    FILL_INSTR("0110xxxxxxxx0010", i_movl<OperandSize::Long>);
+    FILL_INSTR("0110xxxxxxxx0011", i_mov);
+    FILL_INSTR("0110xxxxxxxx0100", i_movp<OperandSize::Byte>);
+    FILL_INSTR("0110xxxxxxxx0101", i_movp<OperandSize::Word>);
+    FILL_INSTR("0110xxxxxxxx0110", i_movp<OperandSize::Long>);
+    FILL_INSTR("0110xxxxxxxx0111", i_not);
+    FILL_INSTR("0110xxxxxxxx1000", i_swap<OperandSize::Byte>);
+    FILL_INSTR("0110xxxxxxxx1001", i_swap<OperandSize::Word>);
+    FILL_INSTR("0110xxxxxxxx1010", i_negc);
+    FILL_INSTR("0110xxxxxxxx1011", i_neg);
+    FILL_INSTR("0110xxxxxxxx1100", i_extu<OperandSize::Byte>);
+    FILL_INSTR("0110xxxxxxxx1101", i_extu<OperandSize::Word>);
+    FILL_INSTR("0110xxxxxxxx1110", i_exts<OperandSize::Byte>);
+    FILL_INSTR("0110xxxxxxxx1111", i_exts<OperandSize::Word>);
+    FILL_INSTR("0111xxxxxxxxxxxx", i_add<true>);
+    FILL_INSTR("10000000xxxxxxxx", i_movs4<OperandSize::Byte>);
+    FILL_INSTR("10000100xxxxxxxx", i_movl4<OperandSize::Byte>);
+    FILL_INSTR("10000001xxxxxxxx", i_movs4<OperandSize::Word>);
+    FILL_INSTR("10000101xxxxxxxx", i_movl4<OperandSize::Word>);
+    FILL_INSTR("10001000xxxxxxxx", i_cmp<Comparison::EqualImmediate>);
+    FILL_INSTR("10001001xxxxxxxx", i_bt<false>);
+    FILL_INSTR("10001011xxxxxxxx", i_bf<false>);
+    FILL_INSTR("10001101xxxxxxxx", i_bt<true>);
+    FILL_INSTR("10001111xxxxxxxx", i_bf<true>);
+    FILL_INSTR("1001xxxxxxxxxxxx", i_movi<OperandSize::Word>);
+    FILL_INSTR("1010xxxxxxxxxxxx", i_bra<false, true>);
+    FILL_INSTR("1011xxxxxxxxxxxx", i_bra<true, true>);
+    FILL_INSTR("11000000xxxxxxxx", i_movsg<OperandSize::Byte>);
+    FILL_INSTR("11000001xxxxxxxx", i_movsg<OperandSize::Word>);
+    FILL_INSTR("11000010xxxxxxxx", i_movsg<OperandSize::Long>);
+    FILL_INSTR("11000100xxxxxxxx", i_movlg<OperandSize::Byte>);
+    FILL_INSTR("11000101xxxxxxxx", i_movlg<OperandSize::Word>);
+    FILL_INSTR("11000110xxxxxxxx", i_movlg<OperandSize::Long>);
+    FILL_INSTR("11000111xxxxxxxx", i_mova);
+    FILL_INSTR("11001000xxxxxxxx", i_tst<AddressingMode::Immediate>);
+    FILL_INSTR("11001001xxxxxxxx", i_and<AddressingMode::Immediate>);
+    FILL_INSTR("11001010xxxxxxxx", i_xor<AddressingMode::Immediate>);
+    FILL_INSTR("11001011xxxxxxxx", i_or<AddressingMode::Immediate>);
+    FILL_INSTR("11001100xxxxxxxx", i_tst<AddressingMode::RegisterIndirectGbr>);
+    FILL_INSTR("11001101xxxxxxxx", i_and<AddressingMode::RegisterIndirectGbr>);
+    FILL_INSTR("11001110xxxxxxxx", i_xor<AddressingMode::RegisterIndirectGbr>);
+    FILL_INSTR("11001111xxxxxxxx", i_or<AddressingMode::RegisterIndirectGbr>);
+    FILL_INSTR("1101xxxxxxxxxxxx", i_movi<OperandSize::Long>);
+    FILL_INSTR("1110xxxxxxxxxxxx", i_movi<OperandSize::Byte>);
+    FILL_INSTR("1111xxxxxxxx0000", i_fadd);
+    FILL_INSTR("1111xxxxxxxx0001", i_fsub);
+    FILL_INSTR("1111xxxxxxxx0010", i_fmul);
+    FILL_INSTR("1111xxxxxxxx0011", i_fdiv);
+    FILL_INSTR("1111xxxxxxxx0100", i_fcmp<Comparison::Equal>);
+    FILL_INSTR("1111xxxxxxxx0101", i_fcmp<Comparison::GreaterThan>);
+    FILL_INSTR("1111xxxx00001101", i_fsts);
+    FILL_INSTR("1111xxxx00011101", i_flds);
+    FILL_INSTR("1111xxxx00101101", i_float);
+    FILL_INSTR("1111xxxx00111101", i_ftrc);
+    FILL_INSTR("1111xxxx01001101", i_fneg);
+    FILL_INSTR("1111xxxx01011101", i_fabs);
+    FILL_INSTR("1111xxxx01101101", i_fsqrt);
+    FILL_INSTR("1111xxxx01111101", i_fsrra);
+    FILL_INSTR("1111xxxx10001101", i_fldi<false>);
+    FILL_INSTR("1111xxxx10011101", i_fldi<true>);
+    FILL_INSTR("1111xxxx10101101", i_fcnvsd);
+    FILL_INSTR("1111xxxx10111101", i_fcnvds);
+    FILL_INSTR("1111xxxx11101101", i_fipr);
+    FILL_INSTR("1111xxx011111101", i_fsca);
+    FILL_INSTR("1111xx0111111101", i_ftrv);
+    FILL_INSTR("1111xxxxxxxx0110", i_fmov_index_load);
+    FILL_INSTR("1111xxxxxxxx0111", i_fmov_index_store);
+    FILL_INSTR("1111xxxxxxxx1000", i_fmov_load);
+    FILL_INSTR("1111xxxxxxxx1001", i_fmov_restore);
+    FILL_INSTR("1111xxxxxxxx1010", i_fmov_store);
+    FILL_INSTR("1111xxxxxxxx1011", i_fmov_save);
+    FILL_INSTR("1111xxxxxxxx1100", i_fmov);
+    FILL_INSTR("1111xxxxxxxx1110", i_fmac);
+    FILL_INSTR("1111001111111101", i_fschg);
+    FILL_INSTR("1111101111111101", i_frchg);
+}
+
+static void print_instr_histogram() {
+    u64 num_instrs = 0;
+
+    std::vector<std::pair<u64, u16>> opcodes;
+
+    // One entry per handler instantiation
+    std::unordered_map<i64(*)(const u16), std::pair<u64, const char*>> handler_counts;
+
+    for (usize instr = 0; instr < INSTR_TABLE_SIZE; instr++) {
+        const u64 count = histogram.opcode_counts[instr];
+
+        if (count == 0) {
+            continue;
+        }
+
+        num_instrs += count;
+
+        opcodes.emplace_back(count, instr);
+
+        auto& handler_count = handler_counts[ctx.instr_table[instr]];
+
+        handler_count.first += count;
+        handler_count.second = histogram.instr_names[instr];
+    }
+
+    if (num_instrs == 0) {
+        return;
+    }
+
+    std::vector<std::pair<u64, const char*>> handlers;
+
+    for (const auto& [handler, handler_count] : handler_counts) {
+        handlers.push_back(handler_count);
+    }
+
+    std::sort(opcodes.begin(), opcodes.end(), std::greater<>());
+    std::sort(handlers.begin(), handlers.end(), std::greater<>());
+
+    std::printf("SH-4 executed %llu instructions, top %zu handlers:\n", num_instrs, NUM_HISTOGRAM_ENTRIES);
+
+    for (usize i = 0; i < std::min(handlers.size(), NUM_HISTOGRAM_ENTRIES); i++) {
+        std::printf("  %6.2f%% %14llu  %s\n", 100.0 * handlers[i].first / num_instrs, handlers[i].first, handlers[i].second);
+    }
+
+    std::printf("SH-4 top %zu opcodes:\n", NUM_HISTOGRAM_ENTRIES);
+
+    for (usize i = 0; i < std::min(opcodes.size(), NUM_HISTOGRAM_ENTRIES); i++) {
+        const u16 instr = opcodes[i].second;
+
+        std::printf("  %6.2f%% %14llu  %04X  %s\n", 100.0 * opcodes[i].first / num_instrs, opcodes[i].first, instr, histogram.instr_names[instr]);
+    }
 
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx00000010", i_stc<ControlRegister::Sr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx00000011", i_bra<true, false>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxxxxxx0100", i_movs0<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxxxxxx0101", i_movs0<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxxxxxx0110", i_movs0<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxxxxxx0111", i_mull);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000000000001000", i_clrt);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000000000001001", i_nop);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx00001010", i_sts<SystemRegister::Mach, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000000000001011", i_rts);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxxxxxx1100", i_movl0<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxxxxxx1101", i_movl0<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxxxxxx1110", i_movl0<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx00010010", i_stc<ControlRegister::Gbr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000000000011000", i_sett);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000000000011001", i_div0<false>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx00011010", i_sts<SystemRegister::Macl, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000000000011011", i_sleep);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx00100010", i_stc<ControlRegister::Vbr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx00100011", i_bra<false, false>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx00101001", i_movt);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx00101010", i_sts<SystemRegister::Pr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000000000101011", i_rte);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx00110010", i_stc<ControlRegister::Ssr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx01000010", i_stc<ControlRegister::Spc, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000000001001000", i_clrs);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx01011010", i_sts<SystemRegister::Fpul, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx01101010", i_sts<SystemRegister::Fpscr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx1xxx0010", i_stc<ControlRegister::Rbank, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx10000011", i_pref);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx10010011", i_ocbi);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx10100011", i_ocbp);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx10110011", i_ocbwb);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx11000011", i_movca);
-    fill_table_with_pattern(ctx.instr_table.data(), "0000xxxx11111010", i_stc<ControlRegister::Dbr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0001xxxxxxxxxxxx", i_movs4<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx0000", i_movs<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx0001", i_movs<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx0010", i_movs<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx0100", i_movm<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx0101", i_movm<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx0110", i_movm<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx0111", i_div0<true>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx1000", i_tst<AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx1001", i_and<AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx1010", i_xor<AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx1011", i_or<AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx1100", i_cmp<Comparison::String>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx1101", i_xtrct);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx1110", i_mulu);
-    fill_table_with_pattern(ctx.instr_table.data(), "0010xxxxxxxx1111", i_muls);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx0000", i_cmp<Comparison::Equal>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx0010", i_cmp<Comparison::HigherSame>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx0011", i_cmp<Comparison::GreaterEqual>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx0100", i_div1);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx0101", i_dmulu);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx0110", i_cmp<Comparison::Higher>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx0111", i_cmp<Comparison::GreaterThan>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx1000", i_sub);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx1010", i_subc);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx1100", i_add<false>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx1101", i_dmuls);
-    fill_table_with_pattern(ctx.instr_table.data(), "0011xxxxxxxx1110", i_addc);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00000000", i_shll<1>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00000001", i_shlr<1>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00000010", i_sts<SystemRegister::Mach, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00000011", i_stc<ControlRegister::Sr, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00000101", i_rotr);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00000110", i_lds<SystemRegister::Mach, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00000111", i_ldc<ControlRegister::Sr, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00001000", i_shll<2>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00001001", i_shlr<2>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00001010", i_lds<SystemRegister::Mach, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00001011", i_jsr);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxxxxxx1100", i_shad);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxxxxxx1101", i_shld);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00001110", i_ldc<ControlRegister::Sr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00010000", i_dt);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00010001", i_cmp<Comparison::PositiveZero>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00010010", i_sts<SystemRegister::Macl, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00010011", i_stc<ControlRegister::Gbr, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00010101", i_cmp<Comparison::Positive>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00010110", i_lds<SystemRegister::Macl, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00010111", i_ldc<ControlRegister::Gbr, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00011000", i_shll<8>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00011001", i_shlr<8>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00011010", i_lds<SystemRegister::Macl, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00011011", i_tas);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00011110", i_ldc<ControlRegister::Gbr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00100001", i_shar);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00100010", i_sts<SystemRegister::Pr, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00100011", i_stc<ControlRegister::Vbr, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00100100", i_rotcl);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00100101", i_rotcr);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00100110", i_lds<SystemRegister::Pr, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00100111", i_ldc<ControlRegister::Vbr, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00101000", i_shll<16>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00101001", i_shlr<16>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00101010", i_lds<SystemRegister::Pr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00101011", i_jmp);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00101110", i_ldc<ControlRegister::Vbr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00110011", i_stc<ControlRegister::Ssr, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00110111", i_ldc<ControlRegister::Ssr, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx00111110", i_ldc<ControlRegister::Ssr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx01000011", i_stc<ControlRegister::Spc, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx01000111", i_ldc<ControlRegister::Spc, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx01001110", i_ldc<ControlRegister::Spc, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx01010010", i_sts<SystemRegister::Fpul, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx01010110", i_lds<SystemRegister::Fpul, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx01011010", i_lds<SystemRegister::Fpul, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx01100010", i_sts<SystemRegister::Fpscr, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx01100110", i_lds<SystemRegister::Fpscr, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx01101010", i_lds<SystemRegister::Fpscr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx1xxx0011", i_stc<ControlRegister::Rbank, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx1xxx0111", i_ldc<ControlRegister::Rbank, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx11110010", i_stc<ControlRegister::Dbr, AddressingMode::RegisterIndirectPredecrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx11110110", i_ldc<ControlRegister::Dbr, AddressingMode::RegisterIndirectPostincrement>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0100xxxx11111010", i_ldc<ControlRegister::Dbr, AddressingMode::RegisterDirect>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0101xxxxxxxxxxxx", i_movl4<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx0000", i_movl<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx0001", i_movl<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx0010", i_movl<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx0011", i_mov);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx0100", i_movp<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx0101", i_movp<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx0110", i_movp<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx0111", i_not);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx1000", i_swap<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx1001", i_swap<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx1010", i_negc);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx1011", i_neg);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx1100", i_extu<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx1101", i_extu<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx1110", i_exts<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0110xxxxxxxx1111", i_exts<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "0111xxxxxxxxxxxx", i_add<true>);
-    fill_table_with_pattern(ctx.instr_table.data(), "10000000xxxxxxxx", i_movs4<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "10000100xxxxxxxx", i_movl4<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "10000001xxxxxxxx", i_movs4<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "10000101xxxxxxxx", i_movl4<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "10001000xxxxxxxx", i_cmp<Comparison::EqualImmediate>);
-    fill_table_with_pattern(ctx.instr_table.data(), "10001001xxxxxxxx", i_bt<false>);
-    fill_table_with_pattern(ctx.instr_table.data(), "10001011xxxxxxxx", i_bf<false>);
-    fill_table_with_pattern(ctx.instr_table.data(), "10001101xxxxxxxx", i_bt<true>);
-    fill_table_with_pattern(ctx.instr_table.data(), "10001111xxxxxxxx", i_bf<true>);
-    fill_table_with_pattern(ctx.instr_table.data(), "1001xxxxxxxxxxxx", i_movi<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "1010xxxxxxxxxxxx", i_bra<false, true>);
-    fill_table_with_pattern(ctx.instr_table.data(), "1011xxxxxxxxxxxx", i_bra<true, true>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11000000xxxxxxxx", i_movsg<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11000001xxxxxxxx", i_movsg<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11000010xxxxxxxx", i_movsg<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11000100xxxxxxxx", i_movlg<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11000101xxxxxxxx", i_movlg<OperandSize::Word>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11000110xxxxxxxx", i_movlg<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11000111xxxxxxxx", i_mova);
-    fill_table_with_pattern(ctx.instr_table.data(), "11001000xxxxxxxx", i_tst<AddressingMode::Immediate>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11001001xxxxxxxx", i_and<AddressingMode::Immediate>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11001010xxxxxxxx", i_xor<AddressingMode::Immediate>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11001011xxxxxxxx", i_or<AddressingMode::Immediate>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11001100xxxxxxxx", i_tst<AddressingMode::RegisterIndirectGbr>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11001101xxxxxxxx", i_and<AddressingMode::RegisterIndirectGbr>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11001110xxxxxxxx", i_xor<AddressingMode::RegisterIndirectGbr>);
-    fill_table_with_pattern(ctx.instr_table.data(), "11001111xxxxxxxx", i_or<AddressingMode::RegisterIndirectGbr>);
-    fill_table_with_pattern(ctx.instr_table.data(), "1101xxxxxxxxxxxx", i_movi<OperandSize::Long>);
-    fill_table_with_pattern(ctx.instr_table.data(), "1110xxxxxxxxxxxx", i_movi<OperandSize::Byte>);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx0000", i_fadd);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx0001", i_fsub);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx0010", i_fmul);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx0011", i_fdiv);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx0100", i_fcmp<Comparison::Equal>);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx0101", i_fcmp<Comparison::GreaterThan>);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx00001101", i_fsts);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx00011101", i_flds);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx00101101", i_float);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx00111101", i_ftrc);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx01001101", i_fneg);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx01011101", i_fabs);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx01101101", i_fsqrt);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx01111101", i_fsrra);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx10001101", i_fldi<false>);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx10011101", i_fldi<true>);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx10101101", i_fcnvsd);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx10111101", i_fcnvds);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxx11101101", i_fipr);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxx011111101", i_fsca);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xx0111111101", i_ftrv);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx0110", i_fmov_index_load);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx0111", i_fmov_index_store);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx1000", i_fmov_load);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx1001", i_fmov_restore);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx1010", i_fmov_store);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx1011", i_fmov_save);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx1100", i_fmov);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111xxxxxxxx1110", i_fmac);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111001111111101", i_fschg);
-    fill_table_with_pattern(ctx.instr_table.data(), "1111101111111101", i_frchg);
+    std::puts("SH-4 FPU instructions per mode:");
+
+    for (usize mode = 0; mode < NUM_FPU_MODES; mode++) {
+        std::printf("  PR=%zu SZ=%zu FR=%zu %14llu\n", mode & 1, (mode >> 1) & 1, mode >> 2, histogram.fpu_mode_counts[mode]);
+    }
 }
 
 void initialize() {
@@ -2014,6 +2278,39 @@ void reset() {
 
 void shutdown() {
     ocio::shutdown();
+
+    stop_trace();
+
+    if (lockstep.is_enabled) {
+        std::printf("SH-4 lockstep verified %llu blocks\n", lockstep.num_blocks);
+    }
+
+    if (histogram.is_enabled) {
+        print_instr_histogram();
+    }
+}
+
+static void save_registers(common::StateWriter& writer) {
+    // Instruction table is built by initialize()
+    writer.write_range(&ctx, &ctx.instr_table);
+    writer.write_range(&ctx.state, &ctx + 1);
+}
+
+static void load_registers(common::StateReader& reader) {
+    reader.read_range(&ctx, &ctx.instr_table);
+    reader.read_range(&ctx.state, &ctx + 1);
+}
+
+void save_state(common::StateWriter& writer) {
+    ocio::save_state(writer);
+
+    save_registers(writer);
+}
+
+void load_state(common::StateReader& reader) {
+    ocio::load_state(reader);
+
+    load_registers(reader);
 }
 
 void setup_for_sideload(const u32 entry) {
@@ -2061,6 +2358,13 @@ static bool in_delay_slot() {
 static void raise_interrupt(const u32 level) {
     std::printf("SH-4 interrupt @ %08X (level = %u)\n", CPC, level);
 
+    // Show interrupt handlers as called by the interrupted code
+    if (profiler_hooks.track_calls) {
+        profiler::push_call(PC);
+    }
+
+    trace::guest_instant(trace::TRACK_INTERRUPTS, "SH4_IRQ_TAKEN", level);
+
     // Save exception context
     SPC = PC;
     SSR = SR;
@@ -2100,6 +2404,8 @@ void assert_interrupt(const int interrupt_level) {
         ctx.pending_interrupts |= 1 << interrupt_level;
 
         std::printf("SH-4 level %d interrupt pending\n", interrupt_level);
+
+        trace::guest_instant(trace::TRACK_INTERRUPTS, "SH4_IRQ_PENDING", interrupt_level);
     }
 }
 
@@ -2111,7 +2417,265 @@ void clear_interrupt(const int interrupt_level) {
     }
 }
 
+static bool is_fpu_instr(const u16 instr) {
+    return (instr >> 12) == 0xF;
+}
+
+static usize get_fpu_mode() {
+    return FPSCR.precision_mode | (FPSCR.pair_mode << 1) | (FPSCR.select_bank << 2);
+}
+
+static void get_trace_registers(u32* regs) {
+    std::memcpy(&regs[common::TRACE_REG_R0], GPRS, sizeof(GPRS));
+    std::memcpy(&regs[common::TRACE_REG_R0_BANKED], BANKED_GPRS, sizeof(BANKED_GPRS));
+
+    regs[common::TRACE_REG_SR] = SR.raw;
+    regs[common::TRACE_REG_SSR] = SSR.raw;
+    regs[common::TRACE_REG_SPC] = SPC;
+    regs[common::TRACE_REG_SGR] = SGR;
+    regs[common::TRACE_REG_GBR] = GBR;
+    regs[common::TRACE_REG_VBR] = VBR;
+    regs[common::TRACE_REG_DBR] = DBR;
+    regs[common::TRACE_REG_MACH] = MACH;
+    regs[common::TRACE_REG_MACL] = MACL;
+    regs[common::TRACE_REG_PR] = PR;
+    regs[common::TRACE_REG_FPSCR] = FPSCR.raw;
+    regs[common::TRACE_REG_FPUL] = FPUL;
+
+    std::memcpy(&regs[common::TRACE_REG_FR0], FR_RAW, sizeof(FR_RAW));
+    std::memcpy(&regs[common::TRACE_REG_XR0], XR_RAW, sizeof(XR_RAW));
+}
+
+static void write_trace_record(const u16 instr, const i64 cycles, const u32* old_regs) {
+    common::CpuTraceRecord& record = cpu_trace.record;
+
+    record.pc = CPC;
+    record.instr = instr;
+    record.cycles = cycles;
+
+    u32 regs[common::NUM_TRACE_REGS];
+
+    get_trace_registers(regs);
+
+    record.num_regs = 0;
+
+    for (int reg = 0; reg < common::NUM_TRACE_REGS; reg++) {
+        if (regs[reg] != old_regs[reg]) {
+            record.reg_ids[record.num_regs] = reg;
+            record.reg_values[record.num_regs] = regs[reg];
+
+            record.num_regs++;
+        }
+    }
+
+    cpu_trace.writer->write(record);
+
+    record.num_memory_accesses = 0;
+
+    if (++cpu_trace.num_instrs == cpu_trace.max_instrs) {
+        std::printf("SH-4 trace limit of %llu instructions reached\n", cpu_trace.max_instrs);
+
+        stop_trace();
+    }
+}
+
+template<bool is_counting, bool is_tracing>
+static u64 run_instrs() {
+    u64 num_instrs = 0;
+
+    while (ctx.cycles > 0) {
+        u32 old_regs[common::NUM_TRACE_REGS];
+
+        if constexpr (is_tracing) {
+            get_trace_registers(old_regs);
+        }
+
+        const u16 instr = fetch_instr();
+
+        if constexpr (is_counting) {
+            histogram.opcode_counts[instr]++;
+
+            if (is_fpu_instr(instr)) {
+                histogram.fpu_mode_counts[get_fpu_mode()]++;
+            }
+        }
+
+        if constexpr (is_tracing) {
+            cpu_trace.is_recording = true;
+        }
+        
+        const i64 cycles = ctx.instr_table[instr](instr);
+
+        ctx.cycles -= cycles;
+
+        if constexpr (is_tracing) {
+            cpu_trace.is_recording = false;
+        }
+
+        check_pending_interrupts();
+
+        num_instrs++;
+
+        if constexpr (is_tracing) {
+            write_trace_record(instr, cycles, old_regs);
+
+            if (cpu_trace.writer == nullptr) {
+                // Limit reached, finish the time slice without tracing
+                return num_instrs + ((histogram.is_enabled) ? run_instrs<true, false>() : run_instrs<false, false>());
+            }
+        }
+    }
+
+    return num_instrs;
+}
+
+constexpr u64 MAX_BLOCK_INSTRS = 64;
+
+// Interprets until a control transfer, the end of the time slice, sleep or a lockstep device access
+static u64 interpret_block(const u64 max_instrs) {
+    u64 num_instrs = 0;
+
+    while ((ctx.cycles > 0) && (num_instrs < max_instrs)) {
+        const u16 instr = fetch_instr();
+
+        ctx.cycles -= ctx.instr_table[instr](instr);
+
+        num_instrs++;
+
+        if ((PC != (CPC + sizeof(u16))) || (ctx.state == STATE_SLEEPING) || lockstep.has_device_access) {
+            break;
+        }
+    }
+
+    return num_instrs;
+}
+
+// Block entry points indexed by engine, all take an instruction limit and return instructions executed.
+// Blocks must end after an instruction that sets lockstep.has_device_access
+static u64 (* const engine_blocks[NUM_ENGINES])(const u64) = {
+    interpret_block,
+};
+
+static void run_lockstep_engine(const int engine, u64& num_instrs) {
+    if (engine != 0) {
+        common::StateReader reader(lockstep.start_registers);
+
+        load_registers(reader);
+    }
+
+    lockstep.current_engine = engine;
+    lockstep.overlay.clear();
+    lockstep.writes[engine].clear();
+    lockstep.has_device_access = false;
+
+    lockstep.is_active = true;
+
+    num_instrs = engine_blocks[lockstep.engines[engine]](MAX_BLOCK_INSTRS);
+
+    lockstep.is_active = false;
+    lockstep.has_device_access = false;
+
+    common::StateWriter writer(lockstep.end_registers[engine]);
+
+    save_registers(writer);
+}
+
+static void print_lockstep_writes(const int engine) {
+    for (const auto& write : lockstep.writes[engine]) {
+        if (write.size == LOCKSTEP_SQ_FLUSH) {
+            std::printf("  SQ flush @ %08X\n", write.addr);
+
+            continue;
+        }
+
+        std::printf("  write%u @ %08X = %0*llX\n", 8 * write.size, write.addr, 2 * write.size, write.data);
+    }
+}
+
+[[noreturn]]
+static void report_lockstep_mismatch(const u32 block_pc, const u64* num_instrs) {
+    std::printf("SH-4 lockstep mismatch in block #%llu @ %08X\n", lockstep.num_blocks, block_pc);
+
+    for (int engine = 0; engine < 2; engine++) {
+        std::printf("Engine %c (%s): %llu instructions, %zu writes\n",
+            'A' + engine,
+            get_engine_name(lockstep.engines[engine]),
+            num_instrs[engine],
+            lockstep.writes[engine].size()
+        );
+
+        common::StateReader reader(lockstep.end_registers[engine]);
+
+        load_registers(reader);
+
+        dump_registers();
+        print_lockstep_writes(engine);
+    }
+
+    exit(1);
+}
+
+// Runs both engines over the same block from the same registers and memory view,
+// then commits the writes and store queue flushes once if they agree.
+// Blocks end at the first device access, so device writes are committed before anything reads after them.
+// NOTE: device reads still happen once per engine
+static u64 run_lockstep() {
+    u64 num_instrs = 0;
+
+    while ((ctx.cycles > 0) && (ctx.state != STATE_SLEEPING)) {
+        const u32 block_pc = PC;
+
+        common::StateWriter writer(lockstep.start_registers);
+
+        save_registers(writer);
+
+        u64 block_instrs[2];
+
+        run_lockstep_engine(0, block_instrs[0]);
+        run_lockstep_engine(1, block_instrs[1]);
+
+        if (
+            (block_instrs[0] != block_instrs[1]) ||
+            (lockstep.end_registers[0] != lockstep.end_registers[1]) ||
+            (lockstep.writes[0] != lockstep.writes[1])
+        ) {
+            report_lockstep_mismatch(block_pc, block_instrs);
+        }
+
+        // Registers already hold engine B's results, commit the writes
+        for (const auto& write : lockstep.writes[1]) {
+            switch (write.size) {
+                case LOCKSTEP_SQ_FLUSH:
+                    ocio::flush_store_queue(write.addr);
+                    break;
+                case sizeof(u8):
+                    hw::cpu::write<u8>(write.addr, write.data);
+                    break;
+                case sizeof(u16):
+                    hw::cpu::write<u16>(write.addr, write.data);
+                    break;
+                case sizeof(u32):
+                    hw::cpu::write<u32>(write.addr, write.data);
+                    break;
+                case sizeof(u64):
+                    hw::cpu::write<u64>(write.addr, write.data);
+                    break;
+            }
+        }
+
+        check_pending_interrupts();
+
+        num_instrs += block_instrs[0];
+
+        lockstep.num_blocks++;
+    }
+
+    return num_instrs;
+}
+
 void step() {
+    perf::ScopedTimer timer(perf::SCOPE_CPU);
+
     ocio::tmu::step(ctx.cycles);
 
     if (ctx.state == STATE_SLEEPING) {
@@ -2123,17 +2687,73 @@ void step() {
         return;
     }
 
-    while (ctx.cycles > 0) {
-        const u16 instr = fetch_instr();
-        
-        ctx.cycles -= ctx.instr_table[instr](instr);
+    u64 num_instrs;
 
-        check_pending_interrupts();
+    if (lockstep.is_enabled) {
+        num_instrs = run_lockstep();
+    } else if (cpu_trace.writer != nullptr) {
+        num_instrs = (histogram.is_enabled) ? run_instrs<true, true>() : run_instrs<false, true>();
+    } else {
+        num_instrs = (histogram.is_enabled) ? run_instrs<true, false>() : run_instrs<false, false>();
     }
+
+    perf::add(perf::COUNTER_INSTRUCTIONS, num_instrs);
 }
 
 i64* get_cycles() {
     return &ctx.cycles;
 }
 
+u32 get_pc() {
+    return PC;
+}
+
+const char* get_engine_name(const Engine engine) {
+    switch (engine) {
+        case ENGINE_INTERPRETER:
+            return "interpreter";
+        default:
+            return "unknown";
+    }
+}
+
+void enable_lockstep(const Engine engine_a, const Engine engine_b) {
+    assert((engine_a < NUM_ENGINES) && (engine_b < NUM_ENGINES));
+
+    lockstep.is_enabled = true;
+    lockstep.engines = {engine_a, engine_b};
+}
+
+void start_trace(const char* path, const u64 max_instrs) {
+    assert(cpu_trace.writer == nullptr);
+
+    cpu_trace.writer = new common::CpuTraceWriter(path);
+
+    cpu_trace.num_instrs = 0;
+    cpu_trace.max_instrs = max_instrs;
+
+    cpu_trace.record.num_memory_accesses = 0;
+}
+
+void stop_trace() {
+    if (cpu_trace.writer == nullptr) {
+        return;
+    }
+
+    delete cpu_trace.writer;
+
+    cpu_trace.writer = nullptr;
+
+    std::printf("SH-4 traced %llu instructions\n", cpu_trace.num_instrs);
+}
+
+void set_instr_histogram_enabled(const bool is_enabled) {
+    histogram.is_enabled = is_enabled;
+}
+
+void set_profiler_hooks(const bool track_calls, const bool count_blocks) {
+    profiler_hooks.track_calls = track_calls;
+    profiler_hooks.count_blocks = count_blocks;
+}
+
 }
@@ -5,12 +5,16 @@
 
 #include <hw/cpu/dmac.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 #include <scheduler.hpp>
+#include <trace.hpp>
+#include <hw/cpu/cpu.hpp>
 #include <hw/holly/bus.hpp>
 #include <hw/holly/intc.hpp>
 
@@ -80,8 +84,273 @@ struct {
             u32                    : 16;
         };
     } dma_operation;
+
+    // Channel served first in round robin mode
+    int next_channel;
+
+    bool is_running;
 } ctx;
 
+// In bytes, indexed by CHCR.TS
+constexpr u32 TRANSMIT_SIZES[8] = {8, 1, 2, 4, 32, 0, 0, 0};
+
+enum {
+    ADDRESS_FIXED,
+    ADDRESS_INCREMENT,
+    ADDRESS_DECREMENT,
+};
+
+// Values of CHCR.RS
+enum : u32 {
+    RESOURCE_SINGLE_TO_DEVICE   = 2,
+    RESOURCE_SINGLE_FROM_DEVICE = 3,
+    RESOURCE_AUTO_REQUEST       = 4,
+};
+
+// DMATCR is 24 bits wide, 0 means 2^24 transfers
+constexpr u32 TRANSFER_COUNT_MASK = 0xFFFFFF;
+constexpr u32 MAX_TRANSFER_COUNT = TRANSFER_COUNT_MASK + 1;
+
+// Bytes moved before the DMAC arbitrates again, keeps long transfers interleaved with the CPU
+constexpr u32 CHUNK_SIZE = 4096;
+
+// Fixed priority orders, round robin (PR = 3) starts at ctx.next_channel
+constexpr int PRIORITY_ORDERS[3][NUM_CHANNELS] = {
+    {CHANNEL_0, CHANNEL_1, CHANNEL_2, CHANNEL_3},
+    {CHANNEL_0, CHANNEL_2, CHANNEL_3, CHANNEL_1},
+    {CHANNEL_2, CHANNEL_0, CHANNEL_1, CHANNEL_3},
+};
+
+constexpr int PRIORITY_ROUND_ROBIN = 3;
+
+// Bounce buffer for transfers and sources outside of mapped memory
+static std::vector<u8> dma_bytes;
+
+static bool is_dmac_enabled() {
+    return DMAOR.master_enable_dmac && !DMAOR.nmi_flag && !DMAOR.address_error_flag;
+}
+
+static bool is_channel_active(const int channel) {
+    const auto& control = ctx.dma_channels[channel].control;
+
+    return control.enable_dmac && !control.transfer_end && (control.select_resource == RESOURCE_AUTO_REQUEST);
+}
+
+// Single address requests come from the DDT interface, which drives those transfers itself.
+// Nothing on the Dreamcast raises dual address DREQs, and SCI/SCIF requests aren't implemented
+static void check_request_sources() {
+    if (!is_dmac_enabled()) {
+        return;
+    }
+
+    for (int channel = 0; channel < NUM_CHANNELS; channel++) {
+        const auto& control = ctx.dma_channels[channel].control;
+
+        if (!control.enable_dmac || control.transfer_end) {
+            continue;
+        }
+
+        switch (control.select_resource) {
+            case RESOURCE_SINGLE_TO_DEVICE:
+            case RESOURCE_SINGLE_FROM_DEVICE:
+            case RESOURCE_AUTO_REQUEST:
+                break;
+            default:
+                std::printf("DMAC Unimplemented request source %u (channel %d)\n", control.select_resource, channel);
+                exit(1);
+        }
+    }
+}
+
+static int select_channel() {
+    if (!is_dmac_enabled()) {
+        return -1;
+    }
+
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+        int channel;
+
+        if (DMAOR.priority_mode == PRIORITY_ROUND_ROBIN) {
+            channel = (ctx.next_channel + i) % NUM_CHANNELS;
+        } else {
+            channel = PRIORITY_ORDERS[DMAOR.priority_mode][i];
+        }
+
+        if (is_channel_active(channel)) {
+            return channel;
+        }
+    }
+
+    return -1;
+}
+
+static u32 get_unit_size(const int channel) {
+    const auto& control = ctx.dma_channels[channel].control;
+
+    const u32 unit_size = TRANSMIT_SIZES[control.transmit_size];
+
+    if (unit_size == 0) {
+        std::printf("DMAC Invalid transmit size %u (channel %d)\n", control.transmit_size, channel);
+        exit(1);
+    }
+
+    return unit_size;
+}
+
+static u32 get_remaining_units(const int channel) {
+    const u32 transfer_count = ctx.dma_channels[channel].transfer_count & TRANSFER_COUNT_MASK;
+
+    return (transfer_count == 0) ? MAX_TRANSFER_COUNT : transfer_count;
+}
+
+static u32 get_chunk_units(const int channel) {
+    return std::min(get_remaining_units(channel), std::max(1U, CHUNK_SIZE / get_unit_size(channel)));
+}
+
+// Every unit is read then written over the 64-bit bus
+static i64 get_chunk_cycles(const int channel) {
+    const i64 unit_cycles = 2 * std::max(1U, get_unit_size(channel) / 8);
+
+    return scheduler::to_scheduler_cycles<scheduler::HOLLY_CLOCKRATE>(unit_cycles * get_chunk_units(channel));
+}
+
+static u32 step_address(const u32 addr, const u32 mode, const u32 size, const int channel) {
+    switch (mode) {
+        case ADDRESS_FIXED:
+            return addr;
+        case ADDRESS_INCREMENT:
+            return addr + size;
+        case ADDRESS_DECREMENT:
+            return addr - size;
+        default:
+            std::printf("DMAC Invalid address mode %u (channel %d)\n", mode, channel);
+            exit(1);
+    }
+}
+
+static void transfer_unit(const u32 source, const u32 destination, const u32 unit_size) {
+    switch (unit_size) {
+        case sizeof(u8):
+            hw::holly::bus::write<u8>(destination, hw::holly::bus::read<u8>(source));
+            break;
+        case sizeof(u16):
+            hw::holly::bus::write<u16>(destination, hw::holly::bus::read<u16>(source));
+            break;
+        case sizeof(u32):
+            hw::holly::bus::write<u32>(destination, hw::holly::bus::read<u32>(source));
+            break;
+        case sizeof(u64):
+            hw::holly::bus::write<u64>(destination, hw::holly::bus::read<u64>(source));
+            break;
+        default:
+            {
+                u8 bytes[32];
+
+                hw::holly::bus::read_bytes(source, bytes, unit_size);
+                hw::holly::bus::write_bytes(destination, bytes, unit_size);
+            }
+            break;
+    }
+}
+
+static void end_transfer(const int channel) {
+    auto& dma_channel = ctx.dma_channels[channel];
+
+    dma_channel.control.transfer_end = 1;
+
+    trace::guest_instant(trace::TRACK_DMA, "DMAC_END", channel);
+
+    if (dma_channel.control.enable_interrupt) {
+        std::printf("DMAC Unimplemented DMTE%d interrupt\n", channel);
+    }
+}
+
+static void transfer_chunk(const int channel) {
+    auto& dma_channel = ctx.dma_channels[channel];
+    auto& control = dma_channel.control;
+
+    const u32 unit_size = get_unit_size(channel);
+    const u32 num_units = get_chunk_units(channel);
+    const u32 size = num_units * unit_size;
+
+    u32 source = dma_channel.source_address;
+    u32 destination = dma_channel.destination_address;
+
+    if (((source | destination) & (unit_size - 1)) != 0) {
+        std::printf("DMAC Address error (channel %d, SAR = %08X, DAR = %08X)\n", channel, source, destination);
+
+        DMAOR.address_error_flag = 1;
+        return;
+    }
+
+    if ((control.source_mode == ADDRESS_INCREMENT) && (control.destination_mode == ADDRESS_INCREMENT)) {
+        // Copy the whole chunk at once, the bounce buffer keeps overlapping ranges in transfer order
+        dma_bytes.resize(size);
+
+        hw::holly::bus::read_bytes(to_physical_address(source), dma_bytes.data(), size);
+        hw::holly::bus::write_bytes(to_physical_address(destination), dma_bytes.data(), size);
+
+        source += size;
+        destination += size;
+    } else {
+        for (u32 i = 0; i < num_units; i++) {
+            transfer_unit(to_physical_address(source), to_physical_address(destination), unit_size);
+
+            source = step_address(source, control.source_mode, unit_size, channel);
+            destination = step_address(destination, control.destination_mode, unit_size, channel);
+        }
+    }
+
+    dma_channel.source_address = source;
+    dma_channel.destination_address = destination;
+    dma_channel.transfer_count = get_remaining_units(channel) - num_units;
+
+    if (dma_channel.transfer_count == 0) {
+        end_transfer(channel);
+    }
+}
+
+static void finish_chunk(const int channel);
+
+// Schedules the next chunk of the highest priority channel, the chunk is written when it ends
+static void schedule_chunk() {
+    const int channel = select_channel();
+
+    if (channel < 0) {
+        ctx.is_running = false;
+        return;
+    }
+
+    ctx.is_running = true;
+
+    const i64 cycles = get_chunk_cycles(channel);
+
+    trace::guest_span(trace::TRACK_DMA, "DMAC_CHUNK", channel, cycles);
+
+    scheduler::schedule_event("DMAC_CHUNK", finish_chunk, channel, cycles);
+}
+
+static void finish_chunk(const int channel) {
+    // Registers might have changed during the chunk
+    if (is_dmac_enabled() && is_channel_active(channel)) {
+        transfer_chunk(channel);
+    }
+
+    if (DMAOR.priority_mode == PRIORITY_ROUND_ROBIN) {
+        ctx.next_channel = (channel + 1) % NUM_CHANNELS;
+    }
+
+    schedule_chunk();
+}
+
+static void start_transfers() {
+    check_request_sources();
+
+    if (!ctx.is_running) {
+        schedule_chunk();
+    }
+}
+
 void initialize() {}
 
 void reset() {
@@ -90,12 +359,42 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
+u32 get_source_address(const int channel) {
+    assert(channel < NUM_CHANNELS);
+
+    return ctx.dma_channels[channel].source_address;
+}
+
+u32 get_destination_address(const int channel) {
+    assert(channel < NUM_CHANNELS);
+
+    return ctx.dma_channels[channel].destination_address;
+}
+
+u32 get_transfer_count(const int channel) {
+    assert(channel < NUM_CHANNELS);
+
+    return ctx.dma_channels[channel].transfer_count;
+}
+
 u32 get_control(const int channel) {
     assert(channel < NUM_CHANNELS);
 
     return ctx.dma_channels[channel].control.raw;
 }
 
+u32 get_dma_operation() {
+    return DMAOR.raw;
+}
+
 void set_source_address(const int channel, const u32 data) {
     assert(channel < NUM_CHANNELS);
 
@@ -111,22 +410,42 @@ void set_destination_address(const int channel, const u32 data) {
 void set_transfer_count(const int channel, const u32 data) {
     assert(channel < NUM_CHANNELS);
 
-    ctx.dma_channels[channel].transfer_count = data;
+    ctx.dma_channels[channel].transfer_count = data & TRANSFER_COUNT_MASK;
 }
 
 void set_control(const int channel, const u32 data) {
     assert(channel < NUM_CHANNELS);
 
-    ctx.dma_channels[channel].control.raw = data;
+    auto& control = ctx.dma_channels[channel].control;
+
+    const bool transfer_end = control.transfer_end;
+
+    control.raw = data;
+
+    // TE is only cleared by writing 0 after reading 1
+    control.transfer_end = transfer_end && control.transfer_end;
+
+    start_transfers();
 }
 
 void set_dma_operation(const u32 data) {
+    const auto old_dmaor = DMAOR;
+
     DMAOR.raw = data;
+
+    // NMIF and AE are only cleared by writing 0 after reading 1
+    DMAOR.nmi_flag = old_dmaor.nmi_flag && DMAOR.nmi_flag;
+    DMAOR.address_error_flag = old_dmaor.address_error_flag && DMAOR.address_error_flag;
+
+    start_transfers();
 }
 
-constexpr int CHANNEL_2_INTERRUPT = 19;
+// 64-bit Root bus bursts, about 400 MB/s
+constexpr i64 CHANNEL_2_BYTES_PER_CYCLE = 4;
+
+constexpr u32 BASE_TEX_PATH = 0x11000000;
 
-void execute_channel_2_dma(u32 &start_address, u32 &length, bool &start) {
+i64 execute_channel_2_dma(u32& start_address, u32& length) {
     assert(DMAOR.master_enable_dmac);
     assert(CHCR2.enable_dmac);
     assert(CHCR2.transmit_size == 4); // 32-byte
@@ -134,56 +453,40 @@ void execute_channel_2_dma(u32 &start_address, u32 &length, bool &start) {
     assert((start_address % 32) == 0);
     assert((length % 32) == 0);
 
-    scheduler::schedule_event(
-        "CH2_IRQ",
-        hw::holly::intc::assert_normal_interrupt,
-        CHANNEL_2_INTERRUPT,
-        8 * length
-    );
+    // Only incrementing sources are used with the DDT interface
+    assert(CHCR2.source_mode == 1);
 
-    // TODO: mask this through CPU
-    SAR2 &= 0x1FFFFFFF;
-    
-    u8 dma_bytes[32];
+    const i64 cycles = scheduler::to_scheduler_cycles<scheduler::HOLLY_CLOCKRATE>(length / CHANNEL_2_BYTES_PER_CYCLE);
 
-    u32 source_increment = 0;
+    trace::guest_span(trace::TRACK_DMA, "CH2_DMA", length, cycles);
 
-    switch (CHCR2.source_mode) {
-        case 1:
-            source_increment = sizeof(dma_bytes);
-            break;
-        case 2:
-            source_increment = -(u32)sizeof(dma_bytes);
-            break;
-    }
+    SAR2 = to_physical_address(SAR2);
 
-    u32 destination_increment = 0;
+    const u8* source = hw::holly::bus::get_read_span(SAR2, length);
 
-    if ((start_address & 0xFF000000) == 0x11000000) {
-        // When using the direct texture path, the address needs to be incremented here
-        destination_increment = 32;
-    } else {
-        switch (CHCR2.destination_mode) {
-            case 1:
-                destination_increment = sizeof(dma_bytes);
-                break;
-            case 2:
-                destination_increment = -(u32)sizeof(dma_bytes);
-                break;
-        }
-    }
+    if (source == nullptr) {
+        dma_bytes.resize(length);
 
-    while (length > 0) {
-        hw::holly::bus::block_read(SAR2, dma_bytes);
-        hw::holly::bus::block_write(start_address, dma_bytes);
+        hw::holly::bus::read_bytes(SAR2, dma_bytes.data(), length);
 
-        SAR2 += source_increment;
-        start_address += destination_increment;
+        source = dma_bytes.data();
+    }
+
+    // The TA FIFO and the YUV converter take the whole transfer as one span
+    hw::holly::bus::write_bytes(start_address, source, length);
 
-        length -= sizeof(dma_bytes);
+    if ((start_address & 0xFF000000) == BASE_TEX_PATH) {
+        // The direct texture path advances the destination
+        start_address += length;
     }
 
-    start = false;
+    SAR2 += length;
+    DMATCR2 = 0;
+    CHCR2.transfer_end = 1;
+
+    length = 0;
+
+    return cycles;
 }
 
 }
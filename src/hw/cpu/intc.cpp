@@ -43,6 +43,14 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 u16 get_priority(const int priority) {
     assert(priority < NUM_PRIORITY_REGS);
 
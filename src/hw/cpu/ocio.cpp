@@ -171,6 +171,36 @@ void shutdown() {
     ubc::shutdown();
 }
 
+void save_state(common::StateWriter& writer) {
+    bsc::save_state(writer);
+    ccn::save_state(writer);
+    cpg::save_state(writer);
+    dmac::save_state(writer);
+    intc::save_state(writer);
+    prfc::save_state(writer);
+    rtc::save_state(writer);
+    scif::save_state(writer);
+    tmu::save_state(writer);
+    ubc::save_state(writer);
+
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    bsc::load_state(reader);
+    ccn::load_state(reader);
+    cpg::load_state(reader);
+    dmac::load_state(reader);
+    intc::load_state(reader);
+    prfc::load_state(reader);
+    rtc::load_state(reader);
+    scif::load_state(reader);
+    tmu::load_state(reader);
+    ubc::load_state(reader);
+
+    reader.read(ctx);
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped SH-4 P4 read%zu @ %08X\n", 8 * sizeof(T), addr);
@@ -285,10 +315,74 @@ u32 read(const u32 addr) {
             std::puts("PCTRA read32");
 
             return bsc::get_port_control(bsc::PORT_A);
+        case IO_SAR0:
+            std::puts("SAR0 read32");
+
+            return dmac::get_source_address(dmac::CHANNEL_0);
+        case IO_DAR0:
+            std::puts("DAR0 read32");
+
+            return dmac::get_destination_address(dmac::CHANNEL_0);
+        case IO_DMATCR0:
+            std::puts("DMATCR0 read32");
+
+            return dmac::get_transfer_count(dmac::CHANNEL_0);
+        case IO_CHCR0:
+            std::puts("CHCR0 read32");
+
+            return dmac::get_control(dmac::CHANNEL_0);
+        case IO_SAR1:
+            std::puts("SAR1 read32");
+
+            return dmac::get_source_address(dmac::CHANNEL_1);
+        case IO_DAR1:
+            std::puts("DAR1 read32");
+
+            return dmac::get_destination_address(dmac::CHANNEL_1);
+        case IO_DMATCR1:
+            std::puts("DMATCR1 read32");
+
+            return dmac::get_transfer_count(dmac::CHANNEL_1);
+        case IO_CHCR1:
+            std::puts("CHCR1 read32");
+
+            return dmac::get_control(dmac::CHANNEL_1);
+        case IO_SAR2:
+            std::puts("SAR2 read32");
+
+            return dmac::get_source_address(dmac::CHANNEL_2);
+        case IO_DAR2:
+            std::puts("DAR2 read32");
+
+            return dmac::get_destination_address(dmac::CHANNEL_2);
+        case IO_DMATCR2:
+            std::puts("DMATCR2 read32");
+
+            return dmac::get_transfer_count(dmac::CHANNEL_2);
         case IO_CHCR2:
             std::puts("CHCR2 read32");
-            
+
             return dmac::get_control(dmac::CHANNEL_2);
+        case IO_SAR3:
+            std::puts("SAR3 read32");
+
+            return dmac::get_source_address(dmac::CHANNEL_3);
+        case IO_DAR3:
+            std::puts("DAR3 read32");
+
+            return dmac::get_destination_address(dmac::CHANNEL_3);
+        case IO_DMATCR3:
+            std::puts("DMATCR3 read32");
+
+            return dmac::get_transfer_count(dmac::CHANNEL_3);
+        case IO_CHCR3:
+            std::puts("CHCR3 read32");
+
+            return dmac::get_control(dmac::CHANNEL_3);
+        case IO_DMAOR:
+            std::puts("DMAOR read32");
+
+            return dmac::get_dma_operation();
         case IO_TCNT0:
             if constexpr (!SILENT_TMU) std::puts("TCNT0 read32");
 
@@ -660,6 +754,26 @@ void write(const u32 addr, const u32 data) {
             
             bsc::set_port_control(bsc::PORT_B, data);
             break;
+        case IO_SAR0:
+            std::printf("SAR0 write32 = %08X\n", data);
+            
+            dmac::set_source_address(dmac::CHANNEL_0, data);
+            break;
+        case IO_DAR0:
+            std::printf("DAR0 write32 = %08X\n", data);
+            
+            dmac::set_destination_address(dmac::CHANNEL_0, data);
+            break;
+        case IO_DMATCR0:
+            std::printf("DMATCR0 write32 = %08X\n", data);
+            
+            dmac::set_transfer_count(dmac::CHANNEL_0, data);
+            break;
+        case IO_CHCR0:
+            std::printf("CHCR0 write32 = %08X\n", data);
+            
+            dmac::set_control(dmac::CHANNEL_0, data);
+            break;
         case IO_SAR1:
             std::printf("SAR1 write32 = %08X\n", data);
             
@@ -706,7 +820,7 @@ void write(const u32 addr, const u32 data) {
             dmac::set_source_address(dmac::CHANNEL_3, data);
             break;
         case IO_DAR3:
-            std::printf("DAR2 write32 = %08X\n", data);
+            std::printf("DAR3 write32 = %08X\n", data);
             
             dmac::set_destination_address(dmac::CHANNEL_3, data);
             break;
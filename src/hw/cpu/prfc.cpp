@@ -41,6 +41,14 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 u16 get_control(const int channel) {
     assert(channel < NUM_CHANNELS);
 
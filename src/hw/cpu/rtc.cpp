@@ -49,6 +49,14 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 void set_rtc_month_alarm(const u8 data) {
     RMONAR.raw = data;
 }
@@ -68,6 +68,14 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 void set_asid(const int channel, const u8 data) {
     assert(channel < NUM_CHANNELS);
 
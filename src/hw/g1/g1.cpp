@@ -148,6 +148,19 @@ void shutdown() {
     gdrom::shutdown();
 }
 
+void save_state(common::StateWriter& writer) {
+    gdrom::save_state(writer);
+
+    // ROMs are loaded once by initialize()
+    writer.write_range(&ctx.gdrom_dma, &ctx + 1);
+}
+
+void load_state(common::StateReader& reader) {
+    gdrom::load_state(reader);
+
+    reader.read_range(&ctx.gdrom_dma, &ctx + 1);
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped G1 read%zu @ %08X\n", 8 * sizeof(T), addr);
@@ -411,6 +411,18 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write_vector(ctx.data_in_bytes);
+    writer.write_vector(ctx.data_out_bytes);
+    writer.write_range(&ctx.data_out_ptr, &ctx + 1);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read_vector(ctx.data_in_bytes);
+    reader.read_vector(ctx.data_out_bytes);
+    reader.read_range(&ctx.data_out_ptr, &ctx + 1);
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped GD-ROM read%zu @ %08X\n", 8 * sizeof(T), addr);
@@ -44,6 +44,15 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    // Wave RAM is tracked by the snapshot code
+    writer.write(ctx.arm_reset);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx.arm_reset);
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped AICA read%zu @ %08X\n", 8 * sizeof(T), addr);
@@ -5,14 +5,21 @@
 
 #include <hw/g2/g2.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
+#include <scheduler.hpp>
+#include <trace.hpp>
+#include <hw/cpu/cpu.hpp>
 #include <hw/g2/aica.hpp>
 #include <hw/g2/modem.hpp>
 #include <hw/g2/rtc.hpp>
+#include <hw/holly/bus.hpp>
+#include <hw/holly/intc.hpp>
 
 namespace hw::g2 {
 
@@ -123,6 +130,11 @@ struct {
                 u32                 : 26;
             };
         } suspend;
+
+        // Bytes transferred so far
+        u32 offset;
+
+        bool is_chunk_pending;
     } dma_channels[NUM_DMA_CHANNELS];
 
     u32 ds_timeout;
@@ -141,6 +153,177 @@ struct {
     } address_protection;
 } ctx;
 
+// Bits of SB_xxLEN
+constexpr u32 DMA_LENGTH_MASK = 0x01FFFFE0;
+constexpr u32 DMA_END = 1U << 31;
+
+// SB_xxTSEL bit 1 selects the hardware trigger instead of SB_xxST
+constexpr u32 SELECT_HARDWARE_TRIGGER = 1 << 1;
+
+constexpr int AICA_DMA_INTERRUPT = 15;
+
+// 16-bit bus with wait states, about 25 MB/s
+constexpr i64 G2_DMA_BYTES_PER_CYCLE = 1;
+
+// Bytes copied per scheduled event, suspend requests take effect between chunks
+constexpr u32 G2_DMA_CHUNK_SIZE = 2048;
+
+constexpr const char* DMA_EVENT_NAMES[NUM_DMA_CHANNELS] = {
+    "AICA_DMA_CHUNK",
+    "EXT1_DMA_CHUNK",
+    "EXT2_DMA_CHUNK",
+    "DEV_DMA_CHUNK",
+};
+
+// Bounce buffer, either side might be outside of mapped memory
+static std::vector<u8> dma_bytes;
+
+static u32 get_dma_length(const int channel) {
+    return ctx.dma_channels[channel].length & DMA_LENGTH_MASK;
+}
+
+static u32 get_chunk_size(const int channel) {
+    return std::min(G2_DMA_CHUNK_SIZE, get_dma_length(channel) - ctx.dma_channels[channel].offset);
+}
+
+static void finish_dma_chunk(const int channel);
+
+static void schedule_dma_chunk(const int channel) {
+    ctx.dma_channels[channel].is_chunk_pending = true;
+
+    scheduler::schedule_event(
+        DMA_EVENT_NAMES[channel],
+        finish_dma_chunk,
+        channel,
+        scheduler::to_scheduler_cycles<scheduler::G2_CLOCKRATE>(get_chunk_size(channel) / G2_DMA_BYTES_PER_CYCLE)
+    );
+}
+
+static void end_dma(const int channel) {
+    auto& dma_channel = ctx.dma_channels[channel];
+
+    dma_channel.is_running = false;
+
+    if ((dma_channel.length & DMA_END) != 0) {
+        dma_channel.enable = false;
+    }
+
+    hw::holly::intc::assert_normal_interrupt(AICA_DMA_INTERRUPT + channel);
+}
+
+static void transfer_dma_chunk(const int channel) {
+    auto& dma_channel = ctx.dma_channels[channel];
+
+    const u32 size = get_chunk_size(channel);
+
+    const u32 g2_address = cpu::to_physical_address(dma_channel.g2_start_address + dma_channel.offset);
+    const u32 ram_address = cpu::to_physical_address(dma_channel.ram_start_address + dma_channel.offset);
+
+    dma_bytes.resize(size);
+
+    if (dma_channel.from_peripheral) {
+        hw::holly::bus::read_bytes(g2_address, dma_bytes.data(), size);
+        hw::holly::bus::write_bytes(ram_address, dma_bytes.data(), size);
+    } else {
+        hw::holly::bus::read_bytes(ram_address, dma_bytes.data(), size);
+        hw::holly::bus::write_bytes(g2_address, dma_bytes.data(), size);
+    }
+
+    dma_channel.offset += size;
+}
+
+// Chunks are copied once their bus time has passed
+static void finish_dma_chunk(const int channel) {
+    auto& dma_channel = ctx.dma_channels[channel];
+
+    dma_channel.is_chunk_pending = false;
+
+    if (!dma_channel.is_running) {
+        return;
+    }
+
+    if (!dma_channel.enable) {
+        // Clearing SB_xxEN aborts the transfer
+        dma_channel.is_running = false;
+        return;
+    }
+
+    transfer_dma_chunk(channel);
+
+    if (dma_channel.offset >= get_dma_length(channel)) {
+        end_dma(channel);
+        return;
+    }
+
+    if (dma_channel.suspend.request_suspend) {
+        dma_channel.suspend.suspend_flag = 1;
+        return;
+    }
+
+    schedule_dma_chunk(channel);
+}
+
+static void start_dma(const int channel) {
+    auto& dma_channel = ctx.dma_channels[channel];
+
+    if (!dma_channel.enable || dma_channel.is_running) {
+        return;
+    }
+
+    const u32 length = get_dma_length(channel);
+
+    trace::guest_span(
+        trace::TRACK_DMA,
+        DMA_EVENT_NAMES[channel],
+        length,
+        scheduler::to_scheduler_cycles<scheduler::G2_CLOCKRATE>(length / G2_DMA_BYTES_PER_CYCLE)
+    );
+
+    dma_channel.is_running = true;
+    dma_channel.offset = 0;
+    dma_channel.suspend.suspend_flag = 0;
+
+    if (length == 0) {
+        end_dma(channel);
+        return;
+    }
+
+    // An aborted transfer might still have a chunk in flight, it continues this one
+    if (!dma_channel.is_chunk_pending) {
+        schedule_dma_chunk(channel);
+    }
+}
+
+// Nothing raises G2 DMA requests yet, so an armed hardware trigger would never start the channel
+static void check_trigger(const int channel) {
+    const auto& dma_channel = ctx.dma_channels[channel];
+
+    if (dma_channel.enable && ((dma_channel.select_trigger & SELECT_HARDWARE_TRIGGER) != 0)) {
+        std::printf("G2 DMA Unimplemented hardware trigger (channel %d)\n", channel);
+        exit(1);
+    }
+}
+
+static void set_dma_start(const int channel, const u32 data) {
+    if ((data & 1) != 0) {
+        start_dma(channel);
+    }
+}
+
+static void set_dma_suspend(const int channel, const u32 data) {
+    auto& dma_channel = ctx.dma_channels[channel];
+
+    dma_channel.suspend.request_suspend = data & 1;
+
+    if (!dma_channel.suspend.request_suspend && dma_channel.suspend.suspend_flag) {
+        dma_channel.suspend.suspend_flag = 0;
+
+        if (dma_channel.is_running && !dma_channel.is_chunk_pending) {
+            schedule_dma_chunk(channel);
+        }
+    }
+}
+
 void initialize() {
     aica::initialize();
     modem::initialize();
@@ -161,6 +344,20 @@ void shutdown() {
     rtc::shutdown();
 }
 
+void save_state(common::StateWriter& writer) {
+    aica::save_state(writer);
+    rtc::save_state(writer);
+
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    aica::load_state(reader);
+    rtc::load_state(reader);
+
+    reader.read(ctx);
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped G2 read%zu @ %08X\n", 8 * sizeof(T), addr);
@@ -170,22 +367,54 @@ T read(const u32 addr) {
 template<>
 u32 read(const u32 addr) {
     switch (addr) {
+        case IO_ADEN:
+            std::puts("SB_ADEN read32");
+
+            return SB_ADEN;
         case IO_ADST:
             std::puts("SB_ADST read32");
 
             return SB_ADST;
+        case IO_ADSUSP:
+            std::puts("SB_ADSUSP read32");
+
+            return SB_ADSUSP.raw;
+        case IO_E1EN:
+            std::puts("SB_E1EN read32");
+
+            return SB_E1EN;
         case IO_E1ST:
             std::puts("SB_E1ST read32");
 
             return SB_E1ST;
+        case IO_E1SUSP:
+            std::puts("SB_E1SUSP read32");
+
+            return SB_E1SUSP.raw;
+        case IO_E2EN:
+            std::puts("SB_E2EN read32");
+
+            return SB_E2EN;
         case IO_E2ST:
             std::puts("SB_E2ST read32");
 
             return SB_E2ST;
+        case IO_E2SUSP:
+            std::puts("SB_E2SUSP read32");
+
+            return SB_E2SUSP.raw;
+        case IO_DDEN:
+            std::puts("SB_DDEN read32");
+
+            return SB_DDEN;
         case IO_DDST:
             std::puts("SB_DDST read32");
 
             return SB_DDST;
+        case IO_DDSUSP:
+            std::puts("SB_DDSUSP read32");
+
+            return SB_DDSUSP.raw;
         default:
             std::printf("Unmapped G2 read32 @ %08X\n", addr);
             exit(1);
@@ -229,21 +458,25 @@ void write(const u32 addr, const u32 data) {
             std::printf("SB_ADTSEL write32 = %08X\n", data);
 
             SB_ADTSEL = data;
+
+            check_trigger(AICA_DMA);
             break;
         case IO_ADEN:
             std::printf("SB_ADEN write32 = %08X\n", data);
 
             SB_ADEN = (data & 1) != 0;
+
+            check_trigger(AICA_DMA);
             break;
         case IO_ADST:
             std::printf("SB_ADST write32 = %08X\n", data);
 
-            assert((data & 1) == 0);
+            set_dma_start(AICA_DMA, data);
             break;
         case IO_ADSUSP:
             std::printf("SB_ADSUSP write32 = %08X\n", data);
 
-            SB_ADSUSP.raw = data;
+            set_dma_suspend(AICA_DMA, data);
             break;
         case IO_E1STAG:
             std::printf("SB_E1STAG write32 = %08X\n", data);
@@ -269,21 +502,25 @@ void write(const u32 addr, const u32 data) {
             std::printf("SB_E1TSEL write32 = %08X\n", data);
 
             SB_E1TSEL = data;
+
+            check_trigger(EXT1_DMA);
             break;
         case IO_E1EN:
             std::printf("SB_E1EN write32 = %08X\n", data);
 
             SB_E1EN = (data & 1) != 0;
+
+            check_trigger(EXT1_DMA);
             break;
         case IO_E1ST:
             std::printf("SB_E1ST write32 = %08X\n", data);
 
-            assert((data & 1) == 0);
+            set_dma_start(EXT1_DMA, data);
             break;
         case IO_E1SUSP:
             std::printf("SB_E1SUSP write32 = %08X\n", data);
 
-            SB_E1SUSP.raw = data;
+            set_dma_suspend(EXT1_DMA, data);
             break;
         case IO_E2STAG:
             std::printf("SB_E2STAG write32 = %08X\n", data);
@@ -309,21 +546,25 @@ void write(const u32 addr, const u32 data) {
             std::printf("SB_E2TSEL write32 = %08X\n", data);
 
             SB_E2TSEL = data;
+
+            check_trigger(EXT2_DMA);
             break;
         case IO_E2EN:
             std::printf("SB_E2EN write32 = %08X\n", data);
 
             SB_E2EN = (data & 1) != 0;
+
+            check_trigger(EXT2_DMA);
             break;
         case IO_E2ST:
             std::printf("SB_E2ST write32 = %08X\n", data);
 
-            assert((data & 1) == 0);
+            set_dma_start(EXT2_DMA, data);
             break;
         case IO_E2SUSP:
             std::printf("SB_E2SUSP write32 = %08X\n", data);
 
-            SB_E2SUSP.raw = data;
+            set_dma_suspend(EXT2_DMA, data);
             break;
         case IO_DDSTAG:
             std::printf("SB_DDSTAG write32 = %08X\n", data);
@@ -349,21 +590,25 @@ void write(const u32 addr, const u32 data) {
             std::printf("SB_DDTSEL write32 = %08X\n", data);
 
             SB_DDTSEL = data;
+
+            check_trigger(DEVT_DMA);
             break;
         case IO_DDEN:
             std::printf("SB_DDEN write32 = %08X\n", data);
 
             SB_DDEN = (data & 1) != 0;
+
+            check_trigger(DEVT_DMA);
             break;
         case IO_DDST:
             std::printf("SB_DDST write32 = %08X\n", data);
 
-            assert((data & 1) == 0);
+            set_dma_start(DEVT_DMA, data);
             break;
         case IO_DDSUSP:
             std::printf("SB_DDSUSP write32 = %08X\n", data);
 
-            SB_DDSUSP.raw = data;
+            set_dma_suspend(DEVT_DMA, data);
             break;
         case IO_G2DSTO:
             std::printf("SB_G2DSTO write32 = %08X\n", data);
@@ -62,6 +62,14 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped RTC read%zu @ %08X\n", 8 * sizeof(T), addr);
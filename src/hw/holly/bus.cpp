@@ -7,6 +7,7 @@
 #include <hw/holly/bus.hpp>
 
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
@@ -29,9 +30,10 @@
 namespace hw::holly::bus {
 
 constexpr usize ADDRESS_SPACE = 0x20000000;
-constexpr usize PAGE_SIZE = 0x1000;
 constexpr usize PAGE_MASK = PAGE_SIZE - 1;
 
+constexpr usize NUM_PAGES = ADDRESS_SPACE / PAGE_SIZE;
+
 enum : u32 {
     BASE_BOOT_ROM  = 0x00000000,
     BASE_FLASH_ROM = 0x00200000,
@@ -50,6 +52,7 @@ enum : u32 {
     BASE_VRAM_32   = 0x05000000,
     BASE_DRAM      = 0x0C000000,
     BASE_TA_FIFO   = 0x10000000,
+    BASE_TA_YUV    = 0x10800000,
     BASE_TEX_PATH  = 0x11000000,
 };
 
@@ -65,9 +68,21 @@ enum : u32 {
     SIZE_DRAM      = 0x02000000,
 };
 
+constexpr struct {
+    u32 base;
+    u32 size;
+} MEMORY_REGIONS[NUM_MEMORY_REGIONS] = {
+    {BASE_DRAM, SIZE_DRAM},
+    {BASE_VRAM_32, SIZE_VRAM_32},
+    {BASE_WAVE_RAM, SIZE_WAVE_RAM},
+};
+
 struct {
     // Pagetables for software fastmem
-    std::array<u8*, ADDRESS_SPACE / PAGE_SIZE> rd_table, wr_table;
+    std::array<u8*, NUM_PAGES> rd_table, wr_table;
+
+    // One bit per page, set by all writes that go through the write table
+    std::array<u64, NUM_PAGES / 64> dirty_pages;
 
     std::array<u8, SIZE_DRAM> dram;
 } ctx;
@@ -77,6 +92,10 @@ static bool is_aligned(const u64 addr, const u64 align) {
     return (addr & (align - 1)) == 0;
 }
 
+static void mark_page_dirty(const u32 page) {
+    ctx.dirty_pages[page / 64] |= (u64)1 << (page % 64);
+}
+
 static void map_memory(
     u8* mem,
     const u32 addr,
@@ -155,6 +174,61 @@ void reset() {
 
 void shutdown() {}
 
+u8* get_memory_ptr(const int region) {
+    assert(region < NUM_MEMORY_REGIONS);
+
+    return ctx.wr_table[MEMORY_REGIONS[region].base / PAGE_SIZE];
+}
+
+u32 get_memory_size(const int region) {
+    assert(region < NUM_MEMORY_REGIONS);
+
+    return MEMORY_REGIONS[region].size;
+}
+
+void collect_dirty_pages(const int region, std::vector<u32>& pages) {
+    assert(region < NUM_MEMORY_REGIONS);
+
+    const u32 first_page = MEMORY_REGIONS[region].base / PAGE_SIZE;
+    const u32 num_pages = MEMORY_REGIONS[region].size / PAGE_SIZE;
+
+    assert(is_aligned(first_page, 64) && is_aligned(num_pages, 64));
+
+    for (u32 i = first_page / 64; i < ((first_page + num_pages) / 64); i++) {
+        u64 dirty_bits = ctx.dirty_pages[i];
+
+        while (dirty_bits != 0) {
+            const u32 bit = std::countr_zero(dirty_bits);
+
+            pages.push_back(64 * i + bit - first_page);
+
+            dirty_bits &= dirty_bits - 1;
+        }
+
+        ctx.dirty_pages[i] = 0;
+    }
+}
+
+void clear_dirty_pages() {
+    ctx.dirty_pages.fill(0);
+}
+
+void mark_dirty(const int region, const u32 offset, const u32 size) {
+    assert(region < NUM_MEMORY_REGIONS);
+    assert((offset + size) <= MEMORY_REGIONS[region].size);
+
+    if (size == 0) {
+        return;
+    }
+
+    const u32 first_page = (MEMORY_REGIONS[region].base + offset) / PAGE_SIZE;
+    const u32 last_page = (MEMORY_REGIONS[region].base + offset + size - 1) / PAGE_SIZE;
+
+    for (u32 page = first_page; page <= last_page; page++) {
+        mark_page_dirty(page);
+    }
+}
+
 void setup_for_sideload() {
     for (u32 i = 0; i < 16; i++) {
         write<u16>(0x0C0000E0 + 2 * i, read<u16>(0x000000FE - 2 * i));
@@ -179,25 +253,6 @@ void setup_for_sideload() {
     write<u32>(0x0CFFFFF8, 0x8C000128);
 }
 
-template<typename T>
-static T read_texture_memory(const u32 addr) {
-    std::printf("Unmapped texture memory read%zu @ %08X\n", 8 * sizeof(T), addr);
-    exit(1);
-}
-
-template<>
-u32 read_texture_memory(const u32 addr) {
-    const u32 offset = (addr - BASE_VRAM_64) >> 2;
-
-    if ((offset & 1) != 0) {
-        // Second VRAM module
-        return read<u32>(BASE_VRAM_32 + (SIZE_VRAM_32 >> 1) + sizeof(u32) * (offset >> 1));
-    } else {
-        // First VRAM module
-        return read<u32>(BASE_VRAM_32 + sizeof(u32) * (offset >> 1));
-    }
-}
-
 template<typename T>
 T read(const u32 addr) {
     assert(addr < ADDRESS_SPACE);
@@ -243,7 +298,7 @@ T read(const u32 addr) {
     }
     
     if ((addr & ~(SIZE_VRAM_32 - 1)) == BASE_VRAM_64) {
-        return read_texture_memory<T>(addr);
+        return hw::pvr::read_vram_interleaved<T>(addr);
     }
 
     // Redirect read
@@ -268,29 +323,15 @@ void block_read(const u32 addr, u8 *bytes) {
         return;
     }
 
-    std::printf("Unmapped block read @ %08X\n", addr);
-    exit(1);
-}
+    if ((addr & ~(SIZE_VRAM_32 - 1)) == BASE_VRAM_64) {
+        hw::pvr::read_vram_interleaved_bytes(addr, bytes, BLOCK_SIZE);
+        return;
+    }
 
-template<typename T>
-static void write_texture_memory(const u32 addr, const T data) {
-    std::printf("Unmapped texture memory write%zu @ %08X = %0*llX\n", 8 * sizeof(T), addr, (int)(2 * sizeof(T)), (u64)data);
+    std::printf("Unmapped block read @ %08X\n", addr);
     exit(1);
 }
 
-template<>
-void write_texture_memory(const u32 addr, const u32 data) {
-    const u32 offset = (addr - BASE_VRAM_64) >> 2;
-
-    if ((offset & 1) != 0) {
-        // Second VRAM module
-        write<u32>(BASE_VRAM_32 + (SIZE_VRAM_32 >> 1) + sizeof(u32) * (offset >> 1), data);
-    } else {
-        // First VRAM module
-        write<u32>(BASE_VRAM_32 + sizeof(u32) * (offset >> 1), data);
-    }
-}
-
 template<typename T>
 void write(const u32 addr, const T data) {
     assert(addr < ADDRESS_SPACE);
@@ -300,6 +341,8 @@ void write(const u32 addr, const T data) {
 
     if (ctx.wr_table[page] != nullptr) {
         std::memcpy(&ctx.wr_table[page][offset], &data, sizeof(data));
+
+        mark_page_dirty(page);
         return;
     }
 
@@ -333,7 +376,7 @@ void write(const u32 addr, const T data) {
     }
 
     if ((addr & ~(SIZE_VRAM_32 - 1)) == BASE_VRAM_64) {
-        return write_texture_memory<T>(addr, data);
+        return hw::pvr::write_vram_interleaved<T>(addr, data);
     }
 
     // Redirect write
@@ -353,29 +396,22 @@ void block_write(const u32 addr, const u8 *bytes) {
 
     if (ctx.wr_table[page] != nullptr) {
         std::memcpy(&ctx.wr_table[page][offset], bytes, BLOCK_SIZE);
+
+        mark_page_dirty(page);
         return;
     }
 
-    u32 tex_addr = addr;
-
     switch (addr & ~(SIZE_VRAM_32 - 1)) {
         case BASE_TEX_PATH:
-            tex_addr -= BASE_TEX_PATH;
-            tex_addr += BASE_VRAM_64;
         case BASE_VRAM_64:
-            {
-                u32 data[8];
-
-                std::memcpy(data, bytes, BLOCK_SIZE);
-
-                for (int i = 0; i < 8; i++) {
-                    write_texture_memory<u32>(tex_addr + sizeof(u32) * i, data[i]);
-                }
-            }
+            hw::pvr::write_vram_interleaved_bytes(addr, bytes, BLOCK_SIZE);
             break;
         case BASE_TA_FIFO:
             hw::pvr::ta::fifo_block_write(bytes);
             break;
+        case BASE_TA_YUV:
+            hw::pvr::ta::yuv_block_write(bytes);
+            break;
         default:
             std::printf("Unmapped block write @ %08X = ", addr);
 
@@ -388,6 +424,91 @@ void block_write(const u32 addr, const u8 *bytes) {
     }
 }
 
+// Mapped pages of a range are contiguous if its first and last page are
+static u8* get_span(const std::array<u8*, NUM_PAGES>& table, const u32 addr, const u32 size) {
+    assert(size != 0);
+
+    if ((addr >= ADDRESS_SPACE) || ((ADDRESS_SPACE - addr) < size)) {
+        return nullptr;
+    }
+
+    const u32 first_page = addr / PAGE_SIZE;
+    const u32 last_page = (addr + size - 1) / PAGE_SIZE;
+
+    u8* first_page_ptr = table[first_page];
+
+    if ((first_page_ptr == nullptr) || (table[last_page] != (first_page_ptr + PAGE_SIZE * (last_page - first_page)))) {
+        return nullptr;
+    }
+
+    return &first_page_ptr[addr & PAGE_MASK];
+}
+
+const u8* get_read_span(const u32 addr, const u32 size) {
+    return get_span(ctx.rd_table, addr, size);
+}
+
+u8* get_write_span(const u32 addr, const u32 size) {
+    return get_span(ctx.wr_table, addr, size);
+}
+
+void read_bytes(const u32 addr, u8* bytes, const u32 size) {
+    if (size == 0) {
+        return;
+    }
+
+    if (const u8* span = get_span(ctx.rd_table, addr, size); span != nullptr) {
+        std::memcpy(bytes, span, size);
+        return;
+    }
+
+    if ((addr & ~(SIZE_VRAM_32 - 1)) == BASE_VRAM_64) {
+        hw::pvr::read_vram_interleaved_bytes(addr, bytes, size);
+        return;
+    }
+
+    for (u32 i = 0; i < size; i++) {
+        bytes[i] = read<u8>(addr + i);
+    }
+}
+
+void write_bytes(const u32 addr, const u8* bytes, const u32 size) {
+    if (size == 0) {
+        return;
+    }
+
+    if (u8* span = get_span(ctx.wr_table, addr, size); span != nullptr) {
+        std::memcpy(span, bytes, size);
+
+        for (u32 page = addr / PAGE_SIZE; page <= ((addr + size - 1) / PAGE_SIZE); page++) {
+            mark_page_dirty(page);
+        }
+
+        return;
+    }
+
+    switch (addr & ~(SIZE_VRAM_32 - 1)) {
+        case BASE_TEX_PATH:
+        case BASE_VRAM_64:
+            hw::pvr::write_vram_interleaved_bytes(addr, bytes, size);
+            return;
+        case BASE_TA_FIFO:
+            assert((size % BLOCK_SIZE) == 0);
+
+            hw::pvr::ta::fifo_write(bytes, size);
+            return;
+        case BASE_TA_YUV:
+            assert((size % BLOCK_SIZE) == 0);
+
+            hw::pvr::ta::yuv_write(bytes, size);
+            return;
+    }
+
+    for (u32 i = 0; i < size; i++) {
+        write<u8>(addr + i, bytes[i]);
+    }
+}
+
 void copy_from_bytes(
     const u32 addr,
     const u32 copy_size,
@@ -5,14 +5,20 @@
 
 #include <hw/holly/holly.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
+#include <scheduler.hpp>
+#include <trace.hpp>
+#include <hw/cpu/cpu.hpp>
 #include <hw/cpu/dmac.hpp>
 #include <hw/holly/bus.hpp>
 #include <hw/holly/intc.hpp>
+#include <hw/pvr/ta.hpp>
 
 namespace hw::holly {
 
@@ -100,6 +106,119 @@ void shutdown() {
     intc::shutdown();
 }
 
+void save_state(common::StateWriter& writer) {
+    intc::save_state(writer);
+
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    intc::load_state(reader);
+
+    reader.read(ctx);
+}
+
+constexpr int CHANNEL_2_INTERRUPT = 19;
+
+static void finish_channel_2_dma(const int) {
+    SB_C2DST = false;
+
+    intc::assert_normal_interrupt(CHANNEL_2_INTERRUPT);
+}
+
+constexpr int SORT_DMA_INTERRUPT = 20;
+
+// Link addresses with special meaning
+enum : u32 {
+    LINK_NEXT_START = 1,
+    LINK_END        = 2,
+};
+
+// Offsets into the first 32-byte block of a polygon run
+constexpr u32 LINK_SIZE_OFFSET = 0x18;
+constexpr u32 LINK_NEXT_OFFSET = 0x1C;
+
+constexpr u32 SORT_DMA_BLOCK_SIZE = 32;
+
+// Root bus reads, about 400 MB/s
+constexpr i64 SORT_DMA_BYTES_PER_CYCLE = 4;
+
+// Reading more than all of system RAM means the link table has a cycle or is corrupt
+constexpr u64 MAX_SORT_DMA_BYTES = 0x01000000;
+
+// Bounce buffer for runs outside of mapped memory
+static std::vector<u8> sort_dma_bytes;
+
+static void finish_sort_dma(const int) {
+    SB_SDST = false;
+
+    intc::assert_normal_interrupt(SORT_DMA_INTERRUPT);
+}
+
+static u32 read_start_link(const u32 index) {
+    if (SB_SDWLT) {
+        return bus::read<u32>(cpu::to_physical_address(SB_SDSTAW + sizeof(u32) * index));
+    }
+
+    return bus::read<u16>(cpu::to_physical_address(SB_SDSTAW + sizeof(u16) * index));
+}
+
+// Walks the link lists and feeds every polygon run to the TA as one span.
+// Returns false if the walk was aborted, num_bytes is the number of bytes read from system RAM
+static bool execute_sort_dma(u64& num_bytes) {
+    const u32 link_base_address = SB_SDBAAW & ~(SORT_DMA_BLOCK_SIZE - 1);
+    const u32 start_link_size = SB_SDWLT ? sizeof(u32) : sizeof(u16);
+
+    u32 num_start_links = 0;
+
+    num_bytes = start_link_size;
+
+    u32 link = read_start_link(num_start_links++);
+
+    while (link != LINK_END) {
+        if (SB_SDLAS) {
+            link *= SORT_DMA_BLOCK_SIZE;
+        }
+
+        const u32 run_address = cpu::to_physical_address(link_base_address + link);
+
+        const u64 run_size = (u64)SORT_DMA_BLOCK_SIZE * bus::read<u32>(run_address + LINK_SIZE_OFFSET);
+
+        // The block holding the size and next link is read even for empty runs
+        num_bytes += std::max<u64>(run_size, SORT_DMA_BLOCK_SIZE);
+
+        if (num_bytes > MAX_SORT_DMA_BYTES) {
+            std::printf("Sort-DMA Aborted after %llu bytes, link table is cyclic or corrupt (run @ %08X)\n", num_bytes, run_address);
+
+            return false;
+        }
+
+        link = bus::read<u32>(run_address + LINK_NEXT_OFFSET);
+
+        if (run_size != 0) {
+            const u8* run = bus::get_read_span(run_address, run_size);
+
+            if (run == nullptr) {
+                sort_dma_bytes.resize(run_size);
+
+                bus::read_bytes(run_address, sort_dma_bytes.data(), run_size);
+
+                run = sort_dma_bytes.data();
+            }
+
+            hw::pvr::ta::fifo_write(run, run_size);
+        }
+
+        if (link == LINK_NEXT_START) {
+            link = read_start_link(num_start_links++);
+
+            num_bytes += start_link_size;
+        }
+    }
+
+    return true;
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped read%zu @ %08X\n", 8 * sizeof(T), addr);
@@ -115,6 +234,10 @@ u32 read(const u32 addr) {
             std::puts("SB_C2DST read32");
 
             return SB_C2DST;
+        case IO_SDST:
+            std::puts("SB_SDST read32");
+
+            return SB_SDST;
         case IO_FFST:
             // There's no need to implement this properly (yet?)
             // std::puts("SB_FFST read32");
@@ -159,7 +282,13 @@ void write(const u32 addr, const u32 data) {
             SB_C2DST = (data & 1) != 0;
 
             if (SB_C2DST) {
-                hw::cpu::ocio::dmac::execute_channel_2_dma(SB_C2DSTAT, SB_C2DLEN, SB_C2DST);
+                // Data is copied immediately, SB_C2DST stays set until the transfer time has passed
+                scheduler::schedule_event(
+                    "CH2_DMA_END",
+                    finish_channel_2_dma,
+                    0,
+                    hw::cpu::ocio::dmac::execute_channel_2_dma(SB_C2DSTAT, SB_C2DLEN)
+                );
             }
             break;
         case IO_SDSTAW:
@@ -185,9 +314,25 @@ void write(const u32 addr, const u32 data) {
         case IO_SDST:
             std::printf("SB_SDST write32 = %08X\n", data);
 
-            SB_SDST = (data & 1) != 0;
+            if (((data & 1) != 0) && !SB_SDST) {
+                SB_SDST = true;
+
+                u64 num_bytes;
+
+                if (!execute_sort_dma(num_bytes)) {
+                    // Hardware stalls, SB_SDST stays set and the end interrupt never happens
+                    break;
+                }
 
-            assert(!SB_SDST);
+                // Polygon runs are sent to the TA immediately, SB_SDST stays set until the transfer time has passed
+                const i64 cycles = scheduler::to_scheduler_cycles<scheduler::HOLLY_CLOCKRATE>(
+                    num_bytes / SORT_DMA_BYTES_PER_CYCLE
+                );
+
+                trace::guest_span(trace::TRACK_DMA, "SORT_DMA", num_bytes, cycles);
+
+                scheduler::schedule_event("SORT_DMA_END", finish_sort_dma, 0, cycles);
+            }
             break;
         case IO_DBREQM:
             std::printf("SB_DBREQM write32 = %08X\n", data);
@@ -9,6 +9,7 @@
 #include <cstdlib>
 #include <cstring>
 
+#include <trace.hpp>
 #include <hw/cpu/cpu.hpp>
 
 namespace hw::holly::intc {
@@ -118,6 +119,14 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped INTC read%zu @ %08X\n", 8 * sizeof(T), addr);
@@ -290,6 +299,8 @@ void assert_normal_interrupt(const int interrupt_number) {
     if ((SB_ISTNRM & (1 << interrupt_number)) == 0) {
         std::printf("Asserting normal interrupt %d\n", interrupt_number);
 
+        trace::guest_instant(trace::TRACK_INTERRUPTS, "HOLLY_NORMAL_IRQ", interrupt_number);
+
         SB_ISTNRM |= 1 << interrupt_number;
 
         check_pending_interrupts();
@@ -300,6 +311,8 @@ void assert_external_interrupt(const int interrupt_number) {
     if ((SB_ISTEXT & (1 << interrupt_number)) == 0) {
         std::printf("Asserting external interrupt %d\n", interrupt_number);
 
+        trace::guest_instant(trace::TRACK_INTERRUPTS, "HOLLY_EXTERNAL_IRQ", interrupt_number);
+
         SB_ISTEXT |= 1 << interrupt_number;
 
         check_pending_interrupts();
@@ -12,6 +12,7 @@
 #include <vector>
 
 #include <scheduler.hpp>
+#include <trace.hpp>
 #include <hw/holly/bus.hpp>
 #include <hw/holly/intc.hpp>
 #include <hw/maple/controller.hpp>
@@ -197,6 +198,13 @@ static void execute_maple_dma() {
                 scheduler::to_scheduler_cycles<scheduler::HOLLY_CLOCKRATE>(MAPLE_DELAY)
             );
 
+            trace::guest_span(
+                trace::TRACK_DMA,
+                "MAPLE_DMA",
+                0,
+                scheduler::to_scheduler_cycles<scheduler::HOLLY_CLOCKRATE>(MAPLE_DELAY)
+            );
+
             break;
         }
     }
@@ -218,6 +226,15 @@ void shutdown() {
     }
 }
 
+void save_state(common::StateWriter& writer) {
+    // Devices are created once by initialize()
+    writer.write_range(&ctx, &ctx.devices);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read_range(&ctx, &ctx.devices);
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped MAPLE read%zu @ %08X\n", 8 * sizeof(T), addr);
@@ -0,0 +1,213 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <hw/pvr/capture.hpp>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+#include <scheduler.hpp>
+#include <common/file.hpp>
+#include <common/state.hpp>
+#include <hw/pvr/pvr.hpp>
+
+namespace hw::pvr::capture {
+
+constexpr u32 CAPTURE_MAGIC = 0x43504A4E; // "NJPC"
+constexpr u32 CAPTURE_VERSION = 1;
+
+// TA lists that were started but not rendered yet
+constexpr usize MAX_PENDING_STREAMS = 4;
+
+struct Header {
+    u32 magic;
+    u32 version;
+};
+
+struct {
+    bool is_enabled;
+
+    const char* path_prefix;
+
+    u64 first_frame;
+    u32 max_captures, num_captures;
+
+    std::deque<std::vector<u8>> ta_streams;
+
+    bool is_capturing;
+
+    Capture current_capture;
+} ctx;
+
+void initialize(const char* path_prefix, const u64 first_frame, const u32 max_captures) {
+    ctx.is_enabled = true;
+    ctx.path_prefix = path_prefix;
+    ctx.first_frame = first_frame;
+    ctx.max_captures = max_captures;
+    ctx.num_captures = 0;
+}
+
+void shutdown() {
+    if (ctx.is_enabled) {
+        std::printf("Captured %u PVR renders\n", ctx.num_captures);
+    }
+
+    ctx.is_enabled = false;
+
+    ctx.ta_streams.clear();
+}
+
+bool is_enabled() {
+    return ctx.is_enabled;
+}
+
+void begin_ta_stream() {
+    if (!ctx.is_enabled) {
+        return;
+    }
+
+    if (ctx.ta_streams.size() >= MAX_PENDING_STREAMS) {
+        ctx.ta_streams.pop_front();
+    }
+
+    ctx.ta_streams.emplace_back();
+}
+
+void record_ta_block(const u8* bytes) {
+    if (!ctx.is_enabled || ctx.ta_streams.empty()) {
+        return;
+    }
+
+    auto& stream = ctx.ta_streams.back();
+
+    stream.insert(stream.end(), bytes, bytes + TA_BLOCK_SIZE);
+}
+
+bool begin_render(const std::vector<Register>& registers, const std::vector<Region>& regions) {
+    assert(ctx.is_enabled && !ctx.is_capturing);
+
+    if (ctx.ta_streams.empty()) {
+        // TA list was started before capturing was enabled
+        return false;
+    }
+
+    Capture& capture = ctx.current_capture;
+
+    capture.ta_stream.swap(ctx.ta_streams.front());
+
+    ctx.ta_streams.pop_front();
+
+    capture.frame = scheduler::get_frame_count();
+
+    if ((capture.frame < ctx.first_frame) || (ctx.num_captures >= ctx.max_captures)) {
+        return false;
+    }
+
+    capture.registers = registers;
+    capture.regions = regions;
+    capture.region_bytes.clear();
+
+    const u8* video_ram = get_video_ram_ptr();
+
+    for (const auto& region : regions) {
+        assert((region.addr + region.size) <= VRAM_SIZE);
+
+        capture.region_bytes.insert(capture.region_bytes.end(), &video_ram[region.addr], &video_ram[region.addr + region.size]);
+    }
+
+    ctx.is_capturing = true;
+
+    return true;
+}
+
+void end_render(const u64 frame_hash) {
+    assert(ctx.is_capturing);
+
+    ctx.current_capture.frame_hash = frame_hash;
+
+    char path[512];
+
+    std::snprintf(path, sizeof(path), "%s-%04u.njpc", ctx.path_prefix, ctx.num_captures);
+
+    save(path, ctx.current_capture);
+
+    std::printf("Captured PVR render of frame %llu to \"%s\"\n", ctx.current_capture.frame, path);
+
+    ctx.num_captures++;
+
+    ctx.is_capturing = false;
+}
+
+void load(const char* path, Capture& capture) {
+    const std::vector<u8> capture_bytes = common::load_file(path);
+
+    Header header;
+
+    if (capture_bytes.size() < sizeof(header)) {
+        std::printf("PVR capture \"%s\" is truncated\n", path);
+        exit(1);
+    }
+
+    std::memcpy(&header, capture_bytes.data(), sizeof(header));
+
+    if ((header.magic != CAPTURE_MAGIC) || (header.version != CAPTURE_VERSION)) {
+        std::printf("PVR capture \"%s\" has an invalid header (magic = %08X, version = %u)\n", path, header.magic, header.version);
+        exit(1);
+    }
+
+    common::StateReader reader(capture_bytes);
+
+    reader.read(header);
+    reader.read(capture.frame);
+    reader.read(capture.frame_hash);
+    reader.read_vector(capture.registers);
+    reader.read_vector(capture.regions);
+    reader.read_vector(capture.region_bytes);
+    reader.read_vector(capture.ta_stream);
+
+    usize total_size = 0;
+
+    for (const auto& region : capture.regions) {
+        total_size += region.size;
+    }
+
+    if (
+        !reader.is_done() ||
+        (total_size != capture.region_bytes.size()) ||
+        ((capture.ta_stream.size() % TA_BLOCK_SIZE) != 0)
+    ) {
+        std::printf("PVR capture \"%s\" is corrupted\n", path);
+        exit(1);
+    }
+}
+
+void save(const char* path, const Capture& capture) {
+    std::vector<u8> capture_bytes;
+
+    common::StateWriter writer(capture_bytes);
+
+    writer.write(Header{.magic = CAPTURE_MAGIC, .version = CAPTURE_VERSION});
+    writer.write(capture.frame);
+    writer.write(capture.frame_hash);
+    writer.write_vector(capture.registers);
+    writer.write_vector(capture.regions);
+    writer.write_vector(capture.region_bytes);
+    writer.write_vector(capture.ta_stream);
+
+    FILE* file = std::fopen(path, "wb");
+
+    if (file == nullptr) {
+        std::printf("Failed to open file \"%s\"\n", path);
+        exit(1);
+    }
+
+    std::fwrite(capture_bytes.data(), sizeof(u8), capture_bytes.size(), file);
+    std::fclose(file);
+}
+
+}
@@ -5,16 +5,23 @@
 
 #include <hw/pvr/core.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <queue>
 #include <vector>
 
+#include <nejicast.hpp>
+#include <perf.hpp>
 #include <scheduler.hpp>
+#include <trace.hpp>
+#include <common/hash.hpp>
 #include <hw/holly/intc.hpp>
+#include <hw/pvr/capture.hpp>
 #include <hw/pvr/pvr.hpp>
 #include <hw/pvr/spg.hpp>
 #include <hw/pvr/ta.hpp>
@@ -79,6 +86,9 @@ enum : u32 {
     IO_TA_GLOB_TILE_CLIP = 0x005F813C,
     IO_TA_ALLOC_CTRL     = 0x005F8140,
     IO_TA_LIST_INIT      = 0x005F8144,
+    IO_TA_YUV_TEX_BASE   = 0x005F8148,
+    IO_TA_YUV_TEX_CTRL   = 0x005F814C,
+    IO_TA_YUV_TEX_CNT    = 0x005F8150,
     IO_TA_NEXT_OPB_INIT  = 0x005F8164,
     IO_FOG_TABLE         = 0x005F8200,
 };
@@ -130,20 +140,61 @@ struct VertexStrip {
     TspInstruction tsp_instr;
     TextureControlWord texture_control;
     
-    bool is_translucent;
+    u32 list_type;
+    bool is_shadowed;
 
     std::vector<Vertex> vertices;
+
+    // Two-volume polygons, used inside modifier volumes
+    bool has_two_volumes;
+
+    TspInstruction second_tsp_instr;
+    TextureControlWord second_texture_control;
+
+    std::vector<Vertex> second_vertices;
+};
+
+struct VolumeTriangle {
+    IspInstruction isp_instr;
+
+    std::array<Vertex, 3> vertices;
 };
 
 struct DisplayList {
     std::vector<VertexStrip> strips;
+
+    // Opaque modifier volumes affect opaque and punch-through polygons, translucent ones translucent polygons
+    std::vector<VolumeTriangle> volume_triangles, translucent_volume_triangles;
+};
+
+// Translucent triangle in auto-sort mode
+struct SortTriangle {
+    const VertexStrip* strip;
+
+    u32 first_vertex;
+};
+
+struct SortEntry {
+    u32 key;
+    u32 triangle;
 };
 
 struct {
+    // Host-side setting, not part of the saved state
+    bool skip_scan_out;
+
     std::array<u16, FOG_TABLE_SIZE> fog_table;
 
+    // FOG_TABLE or FOG_DENSITY changed since the fog LUT was built
+    bool is_fog_table_dirty;
+
     std::queue<DisplayList> display_lists;
 
+    // Auto-sort scratch, reused across renders
+    std::vector<SortTriangle> sort_triangles;
+    std::vector<SortEntry> sort_entries, sort_scratch;
+    std::vector<std::vector<u32>> tile_bins;
+
     u32 isp_parameter_base;
     u32 region_base;
 
@@ -436,25 +487,26 @@ static void draw_background() {
     for (u32 i = 0; i < 3; i++) {
         const u32 vertex_addr = background_addr + 12 + 4 * i * sizeof(u32);
 
-        Vertex vertex{
-            .x = to_f32(read_vram_linear<u32>(vertex_addr)),
-            .y = to_f32(read_vram_linear<u32>(vertex_addr + 1 * sizeof(u32))),
-            // .z = to_f32(read_texture_memory<u32>(vertex_addr + 2 * sizeof(u32))),
-            .z = ISP_BACKGND_D,
-            .color.raw = read_vram_linear<u32>(vertex_addr + 3 * sizeof(u32))
-        };
+        // Untextured, so UVs and the offset color are zero
+        Vertex vertex{};
+
+        vertex.x = to_f32(read_vram_linear<u32>(vertex_addr));
+        vertex.y = to_f32(read_vram_linear<u32>(vertex_addr + 1 * sizeof(u32)));
+        // vertex.z = to_f32(read_texture_memory<u32>(vertex_addr + 2 * sizeof(u32)));
+        vertex.z = ISP_BACKGND_D;
+        vertex.color.raw = read_vram_linear<u32>(vertex_addr + 3 * sizeof(u32));
+        vertex.offset_color.raw = 0;
 
         background_strip.vertices.push_back(vertex);
 
         if (i == 2) {
-            background_strip.vertices.emplace_back(
-                Vertex{
-                    .x = background_strip.vertices[1].x,
-                    .y = background_strip.vertices[2].y,
-                    .z = background_strip.vertices[0].z,
-                    .color = background_strip.vertices[0].color
-                }
-            );
+            // Fourth corner of the rectangle
+            Vertex corner = background_strip.vertices[0];
+
+            corner.x = background_strip.vertices[1].x;
+            corner.y = background_strip.vertices[2].y;
+
+            background_strip.vertices.push_back(corner);
         }
     }
 
@@ -475,39 +527,552 @@ static void draw_background() {
     pvr::set_isp_instruction(background_strip.isp_instr);
     pvr::set_tsp_instruction(background_strip.tsp_instr);
     pvr::set_texture_control(background_strip.texture_control);
-    pvr::set_translucent(false);
+    pvr::set_list_type(ta::LIST_TYPE_OPAQUE);
+    pvr::set_shadowed(ISP_BACKGND_T.enable_shadow);
     
     for (usize i = 0; i < (background_strip.vertices.size() - 2); i++) {
         pvr::submit_triangle(&background_strip.vertices[i]);
     }
 }
 
-static void start_render() {
-    if (ctx.display_lists.empty()) {
-        std::puts("CORE has no display lists");
-        exit(1);
+static FramebufferWrite get_framebuffer_write() {
+    // Interlaced renders go to the field selected by the scaler
+    const bool is_second_field = SCALER_CTL.enable_interlace && SCALER_CTL.select_field;
+
+    return FramebufferWrite{
+        .addr = is_second_field ? FB_W_SOF2 : FB_W_SOF1,
+        .line_stride = (u32)sizeof(u64) * (FB_W_LINESTRIDE & 0x1FF),
+        .format = FB_W_CTRL.format,
+        .enable_dithering = (bool)FB_W_CTRL.enable_dithering,
+        .k_value = (u8)FB_W_CTRL.k_value,
+        .alpha_threshold = (u8)FB_W_CTRL.alpha_threshold,
+        .x_min = FB_X_CLIP.clipping_min,
+        .x_max = FB_X_CLIP.clipping_max,
+        .y_min = FB_Y_CLIP.clipping_min,
+        .y_max = FB_Y_CLIP.clipping_max
+    };
+}
+
+enum {
+    CULLING_MODE_NONE,
+    CULLING_MODE_SMALL,
+    CULLING_MODE_NEGATIVE,
+    CULLING_MODE_POSITIVE,
+};
+
+constexpr int TILE_SIZE = 32;
+
+// Intersection of the pixel clip, the tile clip and the screen, inclusive
+static ClipRect get_clip_rect() {
+    const u32 tile_clip = ta::get_global_tile_clip();
+
+    const int tile_width = TILE_SIZE * ((tile_clip & 0x3F) + 1);
+    const int tile_height = TILE_SIZE * (((tile_clip >> 16) & 0xF) + 1);
+
+    return ClipRect{
+        .x_min = (int)FB_X_CLIP.clipping_min,
+        .x_max = std::min({(int)FB_X_CLIP.clipping_max, tile_width - 1, nejicast::SCREEN_WIDTH - 1}),
+        .y_min = (int)FB_Y_CLIP.clipping_min,
+        .y_max = std::min({(int)FB_Y_CLIP.clipping_max, tile_height - 1, nejicast::SCREEN_HEIGHT - 1})
+    };
+}
+
+// Geometry stage, rejects triangles before any raster setup.
+// Odd triangles of a strip have their winding reversed
+static bool is_culled(const Vertex* vertices, const bool is_odd, const IspInstruction isp_instr, const ClipRect& clip) {
+    const Vertex& a = vertices[0];
+    const Vertex& b = vertices[1];
+    const Vertex& c = vertices[2];
+
+    // Z is 1/W, vertices at or behind the eye have no meaningful screen position
+    for (int i = 0; i < 3; i++) {
+        const Vertex& vertex = vertices[i];
+
+        if (!std::isfinite(vertex.x) || !std::isfinite(vertex.y) || !(vertex.z > 0.0F) || !std::isfinite(vertex.z)) {
+            return true;
+        }
     }
 
-    pvr::clear_buffers();
+    f32 area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
 
-    draw_background();
+    if (is_odd) {
+        area = -area;
+    }
+
+    if (area == 0.0F) {
+        return true;
+    }
+
+    switch (isp_instr.regular.culling_mode) {
+        case CULLING_MODE_NONE:
+            break;
+        case CULLING_MODE_SMALL:
+            if (std::abs(area) < FPU_CULL_VAL) {
+                return true;
+            }
+            break;
+        case CULLING_MODE_NEGATIVE:
+            if ((area < 0.0F) || (std::abs(area) < FPU_CULL_VAL)) {
+                return true;
+            }
+            break;
+        case CULLING_MODE_POSITIVE:
+            if ((area > 0.0F) || (std::abs(area) < FPU_CULL_VAL)) {
+                return true;
+            }
+            break;
+    }
 
-    const auto& display_list = ctx.display_lists.front();
+    // Trivial reject against the clip rectangle
+    const f32 x_min = std::min({a.x, b.x, c.x});
+    const f32 x_max = std::max({a.x, b.x, c.x});
+    const f32 y_min = std::min({a.y, b.y, c.y});
+    const f32 y_max = std::max({a.y, b.y, c.y});
+
+    return (x_max < (f32)clip.x_min) || (x_min > (f32)clip.x_max) || (y_max < (f32)clip.y_min) || (y_min > (f32)clip.y_max);
+}
+
+static void set_strip_state(const VertexStrip& strip) {
+    pvr::set_isp_instruction(strip.isp_instr);
+    pvr::set_tsp_instruction(strip.tsp_instr);
+    pvr::set_texture_control(strip.texture_control);
+    pvr::set_list_type(strip.list_type);
+    pvr::set_shadowed(strip.is_shadowed);
+
+    if (strip.has_two_volumes) {
+        pvr::set_second_parameters(strip.second_tsp_instr, strip.second_texture_control);
+    }
+}
+
+static void submit_strip_triangle(const VertexStrip& strip, const usize first_vertex) {
+    if (strip.has_two_volumes) {
+        pvr::submit_two_volume_triangle(&strip.vertices[first_vertex], &strip.second_vertices[first_vertex]);
+    } else {
+        pvr::submit_triangle(&strip.vertices[first_vertex]);
+    }
+}
+
+// Draws all strips of one list in submission order
+static u64 draw_list(const DisplayList& display_list, const u32 list_type, const ClipRect& clip) {
+    u64 num_culled = 0;
 
     for (const auto& strip : display_list.strips) {
         assert(strip.vertices.size() > 2);
 
-        pvr::set_isp_instruction(strip.isp_instr);
-        pvr::set_tsp_instruction(strip.tsp_instr);
-        pvr::set_texture_control(strip.texture_control);
-        pvr::set_translucent(strip.is_translucent);
-        
+        if (strip.list_type != list_type) {
+            continue;
+        }
+
+        bool has_state = false;
+
         for (usize i = 0; i < (strip.vertices.size() - 2); i++) {
-            pvr::submit_triangle(&strip.vertices[i]);
+            if (is_culled(&strip.vertices[i], (i & 1) != 0, strip.isp_instr, clip)) {
+                num_culled++;
+
+                continue;
+            }
+
+            // Skip state setup for strips that are culled entirely
+            if (!has_state) {
+                set_strip_state(strip);
+
+                has_state = true;
+            }
+
+            submit_strip_triangle(strip, i);
         }
     }
 
+    return num_culled;
+}
+
+// Stable LSD radix sort, 8 bits per pass. Passes where every key has the same digit are skipped
+static void radix_sort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch) {
+    scratch.resize(entries.size());
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        std::array<u32, 256> offsets{};
+
+        for (const auto& entry : entries) {
+            offsets[(entry.key >> shift) & 0xFF]++;
+        }
+
+        if (offsets[(entries[0].key >> shift) & 0xFF] == entries.size()) {
+            continue;
+        }
+
+        u32 offset = 0;
+
+        for (u32& count : offsets) {
+            const u32 bucket_size = count;
+
+            count = offset;
+            offset += bucket_size;
+        }
+
+        for (const auto& entry : entries) {
+            scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+        }
+
+        entries.swap(scratch);
+    }
+}
+
+// Auto-sort: translucent triangles are drawn back to front per tile.
+// The keys are sorted once, binning them in that order keeps every tile list sorted
+static u64 draw_sorted_translucent_list(const DisplayList& display_list, const ClipRect& clip) {
+    auto& triangles = ctx.sort_triangles;
+    auto& entries = ctx.sort_entries;
+
+    triangles.clear();
+    entries.clear();
+
+    u64 num_culled = 0;
+
+    for (const auto& strip : display_list.strips) {
+        if (strip.list_type != ta::LIST_TYPE_TRANSLUCENT) {
+            continue;
+        }
+
+        for (usize i = 0; i < (strip.vertices.size() - 2); i++) {
+            const Vertex* vertices = &strip.vertices[i];
+
+            if (is_culled(vertices, (i & 1) != 0, strip.isp_instr, clip)) {
+                num_culled++;
+
+                continue;
+            }
+
+            // Z is 1/W and positive after culling, its bit pattern orders like the float.
+            // The nearest vertex decides, smaller means further away
+            const f32 z = std::max({vertices[0].z, vertices[1].z, vertices[2].z});
+
+            entries.emplace_back(SortEntry{.key = from_f32(z), .triangle = (u32)triangles.size()});
+            triangles.emplace_back(SortTriangle{.strip = &strip, .first_vertex = (u32)i});
+        }
+    }
+
+    if (entries.empty()) {
+        return num_culled;
+    }
+
+    radix_sort(entries, ctx.sort_scratch);
+
+    const int num_tiles_x = clip.x_max / TILE_SIZE + 1;
+    const int num_tiles_y = clip.y_max / TILE_SIZE + 1;
+
+    ctx.tile_bins.resize(num_tiles_x * num_tiles_y);
+
+    for (auto& bin : ctx.tile_bins) {
+        bin.clear();
+    }
+
+    for (const auto& entry : entries) {
+        const SortTriangle& triangle = triangles[entry.triangle];
+
+        const Vertex* vertices = &triangle.strip->vertices[triangle.first_vertex];
+
+        const f32 x_min = std::max(std::min({vertices[0].x, vertices[1].x, vertices[2].x}), (f32)clip.x_min);
+        const f32 x_max = std::min(std::max({vertices[0].x, vertices[1].x, vertices[2].x}), (f32)clip.x_max);
+        const f32 y_min = std::max(std::min({vertices[0].y, vertices[1].y, vertices[2].y}), (f32)clip.y_min);
+        const f32 y_max = std::min(std::max({vertices[0].y, vertices[1].y, vertices[2].y}), (f32)clip.y_max);
+
+        for (int tile_y = (int)y_min / TILE_SIZE; tile_y <= (int)y_max / TILE_SIZE; tile_y++) {
+            for (int tile_x = (int)x_min / TILE_SIZE; tile_x <= (int)x_max / TILE_SIZE; tile_x++) {
+                ctx.tile_bins[num_tiles_x * tile_y + tile_x].push_back(entry.triangle);
+            }
+        }
+    }
+
+    for (int tile_y = 0; tile_y < num_tiles_y; tile_y++) {
+        for (int tile_x = 0; tile_x < num_tiles_x; tile_x++) {
+            const auto& bin = ctx.tile_bins[num_tiles_x * tile_y + tile_x];
+
+            if (bin.empty()) {
+                continue;
+            }
+
+            pvr::set_clip_rect(ClipRect{
+                .x_min = std::max(clip.x_min, TILE_SIZE * tile_x),
+                .x_max = std::min(clip.x_max, TILE_SIZE * tile_x + TILE_SIZE - 1),
+                .y_min = std::max(clip.y_min, TILE_SIZE * tile_y),
+                .y_max = std::min(clip.y_max, TILE_SIZE * tile_y + TILE_SIZE - 1)
+            });
+
+            const VertexStrip* current_strip = nullptr;
+
+            for (const u32 idx : bin) {
+                const SortTriangle& triangle = triangles[idx];
+
+                if (triangle.strip != current_strip) {
+                    set_strip_state(*triangle.strip);
+
+                    current_strip = triangle.strip;
+                }
+
+                submit_strip_triangle(*triangle.strip, triangle.first_vertex);
+            }
+        }
+    }
+
+    pvr::set_clip_rect(clip);
+
+    return num_culled;
+}
+
+enum {
+    VOLUME_INSTR_NORMAL,
+    VOLUME_INSTR_INSIDE_LAST,
+    VOLUME_INSTR_OUTSIDE_LAST,
+};
+
+// The last triangle of a volume selects what the volume modifies
+static void submit_volume_triangles(const std::vector<VolumeTriangle>& triangles, const bool is_translucent) {
+    for (const auto& triangle : triangles) {
+        if (is_translucent) {
+            pvr::submit_translucent_volume_triangle(triangle.vertices.data());
+        } else {
+            pvr::submit_volume_triangle(triangle.vertices.data());
+        }
+
+        switch (triangle.isp_instr.modifier_volume.volume_instr) {
+            case VOLUME_INSTR_NORMAL:
+                break;
+            case VOLUME_INSTR_INSIDE_LAST:
+            case VOLUME_INSTR_OUTSIDE_LAST:
+                if (is_translucent) {
+                    pvr::end_translucent_volume(triangle.isp_instr.modifier_volume.volume_instr == VOLUME_INSTR_INSIDE_LAST);
+                } else {
+                    pvr::end_volume(triangle.isp_instr.modifier_volume.volume_instr == VOLUME_INSTR_INSIDE_LAST);
+                }
+                break;
+            default:
+                std::printf("CORE Unimplemented volume instruction %u\n", triangle.isp_instr.modifier_volume.volume_instr);
+                exit(1);
+        }
+    }
+}
+
+// Applies opaque modifier volumes to the opaque and punch-through polygons drawn so far
+static void draw_modifier_volumes(const DisplayList& display_list) {
+    if (display_list.volume_triangles.empty()) {
+        return;
+    }
+
+    submit_volume_triangles(display_list.volume_triangles, false);
+
+    pvr::apply_opaque_volumes();
+}
+
+static void draw_display_list(const DisplayList& display_list) {
+    const ClipRect clip = get_clip_rect();
+
+    pvr::set_clip_rect(clip);
+    pvr::clear_buffers();
+
+    if (ctx.is_fog_table_dirty) {
+        pvr::update_fog_table(ctx.fog_table.data(), FOG_DENSITY.raw);
+
+        ctx.is_fog_table_dirty = false;
+    }
+
+    pvr::set_fog_parameters(FogParameters{
+        .table_color = Color{.raw = FOG_COL_RAM.raw},
+        .vertex_color = Color{.raw = FOG_COL_VERT.raw},
+        .clamp_max = Color{.raw = FOG_CLAMP_MAX.raw},
+        .clamp_min = Color{.raw = FOG_CLAMP_MIN.raw}
+    });
+
+    pvr::set_shadow_parameters(ShadowParameters{
+        .is_intensity = (bool)FPU_SHAD_SCALE.enable_intensity_volume,
+        .scale = (u8)FPU_SHAD_SCALE.scale_value,
+        .has_opaque_volumes = !display_list.volume_triangles.empty()
+    });
+
+    draw_background();
+
+    pvr::set_alpha_threshold(FB_W_CTRL.alpha_threshold);
+
+    // Opaque and punch-through polygons first
+    u64 num_culled = draw_list(display_list, ta::LIST_TYPE_OPAQUE, clip);
+
+    num_culled += draw_list(display_list, ta::LIST_TYPE_PUNCHTHROUGH, clip);
+
+    draw_modifier_volumes(display_list);
+
+    // Tested for every shadowed translucent pixel
+    submit_volume_triangles(display_list.translucent_volume_triangles, true);
+
+    if (ISP_FEED_CFG.pre_sort_mode) {
+        num_culled += draw_list(display_list, ta::LIST_TYPE_TRANSLUCENT, clip);
+    } else {
+        num_culled += draw_sorted_translucent_list(display_list, clip);
+    }
+
+    perf::add(perf::COUNTER_CULLED_TRIANGLES, num_culled);
+
     pvr::finish_render();
+    pvr::write_back(get_framebuffer_write());
+}
+
+// Render state for captures, replayed through write() in this order
+static std::vector<capture::Register> get_capture_registers() {
+    std::vector<capture::Register> registers{
+        {IO_PARAM_BASE, PARAM_BASE},
+        {IO_REGION_BASE, REGION_BASE},
+        {IO_SPAN_SORT_CFG, SPAN_SORT_CFG.raw},
+        {IO_VO_BORDER_COLOR, VO_BORDER_COLOR.raw},
+        {IO_FB_R_CTRL, FB_R_CTRL.raw},
+        {IO_FB_W_CTRL, FB_W_CTRL.raw},
+        {IO_FB_W_LINESTRIDE, FB_W_LINESTRIDE},
+        {IO_FB_R_SOF1, FB_R_SOF1},
+        {IO_FB_R_SOF2, FB_R_SOF2},
+        {IO_FB_R_SIZE, FB_R_SIZE.raw},
+        {IO_FB_W_SOF1, FB_W_SOF1},
+        {IO_FB_W_SOF2, FB_W_SOF2},
+        {IO_FB_X_CLIP, FB_X_CLIP.raw},
+        {IO_FB_Y_CLIP, FB_Y_CLIP.raw},
+        {IO_FPU_SHAD_SCALE, FPU_SHAD_SCALE.raw},
+        {IO_FPU_CULL_VAL, from_f32(FPU_CULL_VAL)},
+        {IO_FPU_PARAM_CFG, FPU_PARAM_CFG.raw},
+        {IO_HALF_OFFSET, HALF_OFFSET.raw},
+        {IO_FPU_PERP_VAL, from_f32(FPU_PERP_VAL)},
+        {IO_ISP_BACKGND_D, from_f32(ISP_BACKGND_D)},
+        {IO_ISP_BACKGND_T, ISP_BACKGND_T.raw},
+        {IO_ISP_FEED_CFG, ISP_FEED_CFG.raw},
+        {IO_FOG_COL_RAM, FOG_COL_RAM.raw},
+        {IO_FOG_COL_VERT, FOG_COL_VERT.raw},
+        {IO_FOG_DENSITY, FOG_DENSITY.raw},
+        {IO_FOG_CLAMP_MAX, FOG_CLAMP_MAX.raw},
+        {IO_FOG_CLAMP_MIN, FOG_CLAMP_MIN.raw},
+        {IO_TEXT_CONTROL, TEXT_CONTROL.raw},
+        {IO_SCALER_CTL, SCALER_CTL.raw},
+        {IO_PAL_RAM_CTRL, PAL_RAM_CTRL},
+        {IO_Y_COEFF, Y_COEFF.raw},
+        {IO_TA_GLOB_TILE_CLIP, ta::get_global_tile_clip()},
+        {IO_TA_ALLOC_CTRL, ta::get_allocation_control()},
+    };
+
+    for (u32 i = 0; i < FOG_TABLE_SIZE; i++) {
+        registers.emplace_back(capture::Register{IO_FOG_TABLE + (u32)sizeof(u32) * i, ctx.fog_table[i]});
+    }
+
+    return registers;
+}
+
+enum {
+    SCAN_ORDER_SWIZZLED,
+    SCAN_ORDER_LINEAR,
+};
+
+// Upper bound of the texture size in the 64-bit texture address space
+static u32 get_texture_size(const TspInstruction tsp_instr, const TextureControlWord texture_control) {
+    u32 width = 8 << tsp_instr.u_size;
+
+    const u32 height = 8 << tsp_instr.v_size;
+
+    if ((texture_control.regular.scan_order == SCAN_ORDER_LINEAR) && texture_control.regular.select_stride) {
+        width = 32 * TEXT_CONTROL.stride;
+    }
+
+    // 16 bits per texel is the largest format
+    u32 size = 2 * width * height;
+
+    if (texture_control.regular.use_mipmapping) {
+        size += size / 3 + 2 * sizeof(u64);
+    }
+
+    if (texture_control.regular.use_compression) {
+        // Code book
+        size += 2048;
+    }
+
+    return size;
+}
+
+static void add_texture_regions(std::vector<capture::Region>& regions, const u32 addr, const u32 size) {
+    // 64-bit accesses interleave 32-bit words between the two halves of VRAM
+    const u32 begin = addr & (VRAM_SIZE - 1) & ~7;
+    const u32 end = std::min<u32>((begin + size + 7) & ~7, VRAM_SIZE);
+
+    for (u32 half = 0; half < 2; half++) {
+        regions.emplace_back(capture::Region{(u32)(half * (VRAM_SIZE / 2)) + begin / 2, (end - begin) / 2});
+    }
+}
+
+// Linear VRAM referenced by the textures of a display list and the background tag
+static std::vector<capture::Region> get_capture_regions(const DisplayList& display_list) {
+    std::vector<capture::Region> regions;
+
+    const u32 background_addr = ((ISP_BACKGND_T.tag_address << 2) + PARAM_BASE) & (VRAM_SIZE - 1);
+    const u32 background_size = sizeof(u32) * (3 + 3 * (3 + ISP_BACKGND_T.skip));
+
+    regions.emplace_back(capture::Region{background_addr, std::min<u32>(background_size, VRAM_SIZE - background_addr)});
+
+    for (const auto& strip : display_list.strips) {
+        if (!strip.isp_instr.regular.use_texture_mapping) {
+            continue;
+        }
+
+        add_texture_regions(
+            regions,
+            strip.texture_control.regular.texture_addr * sizeof(u64),
+            get_texture_size(strip.tsp_instr, strip.texture_control)
+        );
+    }
+
+    std::sort(regions.begin(), regions.end(), [](const capture::Region& a, const capture::Region& b) {
+        return a.addr < b.addr;
+    });
+
+    // Merge overlapping and adjacent regions
+    std::vector<capture::Region> merged_regions;
+
+    for (const auto& region : regions) {
+        if (!merged_regions.empty() && (region.addr <= (merged_regions.back().addr + merged_regions.back().size))) {
+            auto& last_region = merged_regions.back();
+
+            last_region.size = std::max(last_region.addr + last_region.size, region.addr + region.size) - last_region.addr;
+        } else {
+            merged_regions.push_back(region);
+        }
+    }
+
+    return merged_regions;
+}
+
+void start_render() {
+    perf::ScopedTimer timer(perf::SCOPE_RENDER);
+
+    if (ctx.display_lists.empty()) {
+        std::puts("CORE has no display lists");
+        exit(1);
+    }
+
+    const bool is_capturing = capture::is_enabled() && capture::begin_render(
+        get_capture_registers(),
+        get_capture_regions(ctx.display_lists.front())
+    );
+
+    trace::guest_span(
+        trace::TRACK_RENDER,
+        "RENDER",
+        0,
+        scheduler::to_scheduler_cycles<scheduler::HOLLY_CLOCKRATE>(CORE_DELAY)
+    );
+
+    {
+        // Always rendered, the frame written back to VRAM is guest-visible
+        trace::HostSpan span("rasterize");
+
+        draw_display_list(ctx.display_lists.front());
+    }
+
+    if (is_capturing) {
+        constexpr usize COLOR_BUFFER_SIZE = sizeof(u32) * nejicast::SCREEN_WIDTH * nejicast::SCREEN_HEIGHT;
+
+        capture::end_render(common::hash_bytes(get_color_buffer_ptr(), COLOR_BUFFER_SIZE));
+    }
 
     scheduler::schedule_event(
         "CORE_IRQ",
@@ -519,6 +1084,29 @@ static void start_render() {
     ctx.display_lists.pop();
 }
 
+void scan_out() {
+    if (ctx.skip_scan_out) {
+        return;
+    }
+
+    force_scan_out();
+}
+
+void force_scan_out() {
+    pvr::scan_out(FramebufferRead{
+        .enable = (bool)FB_R_CTRL.enable,
+        .addr = FB_R_SOF1,
+        .format = FB_R_CTRL.depth,
+        .concat_value = FB_R_CTRL.concat_value,
+        .line_double = (bool)FB_R_CTRL.line_double,
+        .pixel_double = (bool)VO_CONTROL.double_pixel,
+        .line_words = (u32)FB_R_SIZE.x + 1,
+        .num_lines = (u32)FB_R_SIZE.y + 1,
+        .modulus = FB_R_SIZE.modulus,
+        .border_color = VO_BORDER_COLOR.raw & 0xFFFFFF
+    });
+}
+
 void initialize() {
     VO_CONTROL.raw = 0x00000108;
     VO_STARTX = 0x9D;
@@ -526,11 +1114,92 @@ void initialize() {
 }
 
 void reset() {
-    std::memset(&ctx, 0, sizeof(ctx));
+    // Display list queue is not trivially copyable, clear it separately
+    std::queue<DisplayList> temp;
+    ctx.display_lists.swap(temp);
+
+    ctx.fog_table.fill(0);
+
+    ctx.is_fog_table_dirty = true;
+
+    std::memset(&ctx.isp_parameter_base, 0, (u8*)(&ctx + 1) - (u8*)&ctx.isp_parameter_base);
 }
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx.fog_table);
+
+    auto display_lists = ctx.display_lists;
+
+    writer.write<u64>(display_lists.size());
+
+    while (!display_lists.empty()) {
+        const auto& strips = display_lists.front().strips;
+
+        writer.write<u64>(strips.size());
+
+        for (const auto& strip : strips) {
+            writer.write(strip.isp_instr);
+            writer.write(strip.tsp_instr);
+            writer.write(strip.texture_control);
+            writer.write(strip.list_type);
+            writer.write(strip.is_shadowed);
+            writer.write_vector(strip.vertices);
+            writer.write(strip.has_two_volumes);
+            writer.write(strip.second_tsp_instr);
+            writer.write(strip.second_texture_control);
+            writer.write_vector(strip.second_vertices);
+        }
+
+        writer.write_vector(display_lists.front().volume_triangles);
+        writer.write_vector(display_lists.front().translucent_volume_triangles);
+
+        display_lists.pop();
+    }
+
+    writer.write_range(&ctx.isp_parameter_base, &ctx + 1);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx.fog_table);
+
+    ctx.is_fog_table_dirty = true;
+
+    std::queue<DisplayList> temp;
+    ctx.display_lists.swap(temp);
+
+    const u64 num_display_lists = reader.read<u64>();
+
+    for (u64 i = 0; i < num_display_lists; i++) {
+        auto& display_list = ctx.display_lists.emplace();
+
+        display_list.strips.resize(reader.read<u64>());
+
+        for (auto& strip : display_list.strips) {
+            reader.read(strip.isp_instr);
+            reader.read(strip.tsp_instr);
+            reader.read(strip.texture_control);
+            reader.read(strip.list_type);
+            reader.read(strip.is_shadowed);
+            reader.read_vector(strip.vertices);
+            reader.read(strip.has_two_volumes);
+            reader.read(strip.second_tsp_instr);
+            reader.read(strip.second_texture_control);
+            reader.read_vector(strip.second_vertices);
+        }
+
+        reader.read_vector(display_list.volume_triangles);
+        reader.read_vector(display_list.translucent_volume_triangles);
+    }
+
+    reader.read_range(&ctx.isp_parameter_base, &ctx + 1);
+}
+
+void set_scan_out_enabled(const bool is_enabled) {
+    ctx.skip_scan_out = !is_enabled;
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped PVR CORE read%zu @ %08X\n", 8 * sizeof(T), addr);
@@ -580,6 +1249,18 @@ u32 read(const u32 addr) {
 
             // Always returns 0?
             return 0;
+        case IO_TA_YUV_TEX_BASE:
+            std::puts("TA_YUV_TEX_BASE read32");
+
+            return ta::get_yuv_texture_base();
+        case IO_TA_YUV_TEX_CTRL:
+            std::puts("TA_YUV_TEX_CTRL read32");
+
+            return ta::get_yuv_texture_control();
+        case IO_TA_YUV_TEX_CNT:
+            std::puts("TA_YUV_TEX_CNT read32");
+
+            return ta::get_yuv_texture_count();
         default:
             std::printf("Unmapped PVR CORE read32 @ %08X\n", addr);
             exit(1);
@@ -603,6 +1284,8 @@ void write(const u32 addr, const u32 data) {
 
         ctx.fog_table[idx] = data;
 
+        ctx.is_fog_table_dirty = true;
+
         std::printf("FOG_TABLE[%03u] write32 = %08X\n", idx, data);
         return;
     }
@@ -753,6 +1436,8 @@ void write(const u32 addr, const u32 data) {
             std::printf("FOG_DENSITY write32 = %08X\n", data);
         
             FOG_DENSITY.raw = data;
+
+            ctx.is_fog_table_dirty = true;
             break;
         case IO_FOG_CLAMP_MAX:
             std::printf("FOG_CLAMP_MAX write32 = %08X\n", data);
@@ -881,6 +1566,16 @@ void write(const u32 addr, const u32 data) {
         
             ta::set_next_object_pointer_block(data);
             break;
+        case IO_TA_YUV_TEX_BASE:
+            std::printf("TA_YUV_TEX_BASE write32 = %08X\n", data);
+        
+            ta::set_yuv_texture_base(data);
+            break;
+        case IO_TA_YUV_TEX_CTRL:
+            std::printf("TA_YUV_TEX_CTRL write32 = %08X\n", data);
+        
+            ta::set_yuv_texture_control(data);
+            break;
         default:
             std::printf("Unmapped PVR CORE write32 @ %08X = %08X\n", addr, data);
             exit(1);
@@ -905,6 +1600,22 @@ void begin_vertex_strip(
     );
 }
 
+void begin_two_volume_strip(
+    const IspInstruction isp_instr,
+    const TspInstruction tsp_instr,
+    const TextureControlWord texture_control,
+    const TspInstruction second_tsp_instr,
+    const TextureControlWord second_texture_control
+) {
+    begin_vertex_strip(isp_instr, tsp_instr, texture_control);
+
+    auto& strip = ctx.display_lists.back().strips.back();
+
+    strip.has_two_volumes = true;
+    strip.second_tsp_instr = second_tsp_instr;
+    strip.second_texture_control = second_texture_control;
+}
+
 void push_vertex(const Vertex vertex) {
     auto& strips = ctx.display_lists.back().strips;
 
@@ -924,10 +1635,29 @@ void push_vertex(const Vertex vertex) {
     strips.back().vertices.push_back(vertex);
 }
 
-void end_vertex_strip(const bool is_translucent) {
+void push_two_volume_vertex(const Vertex vertex, const Vertex second_vertex) {
+    push_vertex(vertex);
+
+    ctx.display_lists.back().strips.back().second_vertices.push_back(second_vertex);
+}
+
+void end_vertex_strip(const u32 list_type, const bool is_shadowed) {
     auto& strips = ctx.display_lists.back().strips;
 
-    strips.back().is_translucent = is_translucent;
+    strips.back().list_type = list_type;
+    strips.back().is_shadowed = is_shadowed;
+
+    perf::add(perf::COUNTER_STRIPS, 1);
+}
+
+void push_volume_triangle(const u32 list_type, const IspInstruction isp_instr, const Vertex* vertices) {
+    auto& display_list = ctx.display_lists.back();
+
+    auto& triangles = (list_type == ta::LIST_TYPE_TRANSLUCENT_MODIFIER) ? display_list.translucent_volume_triangles : display_list.volume_triangles;
+
+    triangles.emplace_back(
+        VolumeTriangle{.isp_instr = isp_instr, .vertices = {vertices[0], vertices[1], vertices[2]}}
+    );
 }
 
 }
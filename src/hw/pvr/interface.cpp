@@ -9,6 +9,14 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <utility>
+#include <vector>
+
+#include <scheduler.hpp>
+#include <trace.hpp>
+#include <hw/cpu/cpu.hpp>
+#include <hw/holly/bus.hpp>
+#include <hw/holly/intc.hpp>
 
 namespace hw::pvr::interface {
 
@@ -63,15 +71,101 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
+constexpr int PVR_DMA_INTERRUPT = 11;
+
+// Root bus bursts like channel-2 DMA, about 400 MB/s
+constexpr i64 PVR_DMA_BYTES_PER_CYCLE = 4;
+
+constexpr u32 PVR_DMA_LENGTH_MASK = 0x00FFFFE0;
+
+// Bounce buffer for sources outside of mapped memory
+static std::vector<u8> dma_bytes;
+
+static void finish_pvr_dma(const int) {
+    SB_PDST = false;
+
+    hw::holly::intc::assert_normal_interrupt(PVR_DMA_INTERRUPT);
+}
+
+// Data is copied immediately, SB_PDST stays set until the transfer time has passed
+static void start_pvr_dma() {
+    if (!SB_PDEN || SB_PDST) {
+        return;
+    }
+
+    if (SB_PDTSEL) {
+        std::puts("PVR-DMA Unimplemented hardware trigger");
+        exit(1);
+    }
+
+    const u32 length = SB_PDLEN & PVR_DMA_LENGTH_MASK;
+
+    const u32 pvr_address = cpu::to_physical_address(SB_PDSTAP);
+    const u32 ram_address = cpu::to_physical_address(SB_PDSTAR);
+
+    u32 source_address = ram_address;
+    u32 destination_address = pvr_address;
+
+    if (SB_PDDIR) {
+        std::swap(source_address, destination_address);
+    }
+
+    const i64 cycles = scheduler::to_scheduler_cycles<scheduler::HOLLY_CLOCKRATE>(length / PVR_DMA_BYTES_PER_CYCLE);
+
+    trace::guest_span(trace::TRACK_DMA, "PVR_DMA", length, cycles);
+
+    if (length != 0) {
+        const u8* source = hw::holly::bus::get_read_span(source_address, length);
+
+        if (source == nullptr) {
+            dma_bytes.resize(length);
+
+            hw::holly::bus::read_bytes(source_address, dma_bytes.data(), length);
+
+            source = dma_bytes.data();
+        }
+
+        hw::holly::bus::write_bytes(destination_address, source, length);
+    }
+
+    SB_PDST = true;
+
+    scheduler::schedule_event("PVR_DMA_END", finish_pvr_dma, 0, cycles);
+}
+
 template<typename T>
 T read(const u32 addr) {
     std::printf("Unmapped PVR I/F read%zu @ %08X\n", 8 * sizeof(T), addr);
     exit(1);
 }
 
+template<>
+u32 read(const u32 addr) {
+    switch (addr) {
+        case IO_PDEN:
+            std::puts("SB_PDEN read32");
+
+            return SB_PDEN;
+        case IO_PDST:
+            std::puts("SB_PDST read32");
+
+            return SB_PDST;
+        default:
+            std::printf("Unmapped PVR I/F read32 @ %08X\n", addr);
+            exit(1);
+    }
+}
+
 template u8 read(u32);
 template u16 read(u32);
-template u32 read(u32);
 template u64 read(u32);
 
 template<typename T>
@@ -116,7 +210,9 @@ void write(const u32 addr, const u32 data) {
         case IO_PDST:
             std::printf("SB_PDST write32 = %08X\n", data);
 
-            assert((data & 1) == 0);
+            if ((data & 1) != 0) {
+                start_pvr_dma();
+            }
             break;
         case IO_PDAPRO:
             std::printf("SB_MDAPRO write32 = %08X\n", data);
@@ -7,13 +7,20 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <unordered_map>
+#include <vector>
 
+#include <framedump.hpp>
 #include <nejicast.hpp>
+#include <perf.hpp>
+#include <scheduler.hpp>
+#include <hw/holly/bus.hpp>
 #include <hw/pvr/core.hpp>
 #include <hw/pvr/interface.hpp>
 #include <hw/pvr/spg.hpp>
@@ -26,25 +33,109 @@ using nejicast::SCREEN_HEIGHT;
 
 constexpr bool SILENT_PVR = true;
 
-constexpr usize VRAM_SIZE = 0x800000;
+enum : u8 {
+    // clear_buffers() was called and the row has not been drawn to since
+    ROW_CLEAR_PENDING = 1 << 0,
+    // Color row may hold non-zero pixels
+    ROW_WRITTEN       = 1 << 1,
+    // Display row changed since the last get_dirty_rows()
+    ROW_DIRTY         = 1 << 2,
+};
+
+// Write-back granularity of the hardware
+constexpr u32 TILE_SIZE = 32;
+
+constexpr int STENCIL_WORDS_PER_ROW = SCREEN_WIDTH / 32;
+constexpr usize STENCIL_WORDS = STENCIL_WORDS_PER_ROW * SCREEN_HEIGHT;
+
+// Bit of each pixel in a stencil word, SSE2 has no per-lane variable shift
+constexpr std::array<u32, 32> STENCIL_LANE_BITS = [] {
+    std::array<u32, 32> bits{};
+
+    for (int i = 0; i < 32; i++) {
+        bits[i] = 1U << i;
+    }
+
+    return bits;
+}();
+
+// 64 fog LUT entries per octave of 1/W
+constexpr int FOG_LUT_SHIFT = 17;
+constexpr int FOG_LUT_STEPS = 1 << (23 - FOG_LUT_SHIFT);
+
+// Scaled 1/W is clamped to [1, 256), the LUT starts between octaves
+constexpr int FOG_LUT_SIZE = 9 * FOG_LUT_STEPS;
+
+constexpr u8 BAYER_MATRIX[4][4] = {
+    { 0,  8,  2, 10},
+    {12,  4, 14,  6},
+    { 3, 11,  1,  9},
+    {15,  7, 13,  5},
+};
+
+// Bayer rows repeated over a write-back tile so spans index them linearly, row 4 disables dithering
+constexpr auto DITHER_ROWS = [] {
+    std::array<std::array<u8, TILE_SIZE + 3>, 5> rows{};
+
+    for (int y = 0; y < 4; y++) {
+        for (u32 x = 0; x < (TILE_SIZE + 3); x++) {
+            rows[y][x] = BAYER_MATRIX[y][x & 3];
+        }
+    }
+
+    return rows;
+}();
 
 struct {
     std::array<u8, VRAM_SIZE> video_ram;
 
     std::array<u32, SCREEN_WIDTH * SCREEN_HEIGHT> color_buffer, secondary_buffer;
+
+    // Colors opaque and punch-through pixels take inside opaque modifier volumes, two-volume mode only
+    std::array<u32, SCREEN_WIDTH * SCREEN_HEIGHT> inside_color_buffer;
+
     std::array<f32, SCREEN_WIDTH * SCREEN_HEIGHT> depth_buffer;
 
+    // Video output, rebuilt from VRAM on every VBLANK IN
+    std::array<u32, SCREEN_WIDTH * SCREEN_HEIGHT> display_buffer;
+
+    // Row state, buffers are cleared when a row is first drawn to
+    std::array<u8, SCREEN_HEIGHT> row_flags;
+
+    // One bit per pixel, 32 pixels per word like the hardware tiles.
+    // Stencil is the parity of the current modifier volume, volume_mask the union of all volumes,
+    // shadow_mask marks pixels whose polygon is affected by modifier volumes
+    std::array<u32, STENCIL_WORDS> stencil, volume_mask, shadow_mask;
+
+    // Rows touched by the current modifier volume
+    int stencil_y_min, stencil_y_max;
+
+    // Fog alpha for 1/W, indexed by the upper bits of its float representation
+    std::array<f32, FOG_LUT_SIZE> fog_lut;
+    int fog_lut_base;
+
+    // Set for every render
+    ClipRect clip;
+    u8 alpha_threshold;
+    FogParameters fog;
+    ShadowParameters shadow;
+
     IspInstruction isp_instr;
     TspInstruction tsp_instr;
     TextureControlWord texture_control;
 
+    // Two-volume polygons, swapped with the current parameters to shade pixels inside modifier volumes
+    TspInstruction second_tsp_instr;
+    TextureControlWord second_texture_control;
+
     // TSP
     u32 u_size, v_size;
 
     // Texture control
     u32 texture_addr;
 
-    bool is_translucent;
+    u32 list_type;
+    bool is_shadowed;
 } ctx;
 
 template<typename T>
@@ -59,32 +150,130 @@ T read_vram_linear(const u32 addr) {
 template u16 read_vram_linear(u32);
 template u32 read_vram_linear(u32);
 
-template<typename T>
-T read_vram_interleaved(const u32 addr) {
-    std::printf("Unimplemented texture memory read%zu @ %08X\n", 8 * sizeof(T), addr);
-    exit(1);
+// 64-bit area address to linear VRAM offset, even words are in the first module
+static u32 get_interleaved_offset(const u32 addr) {
+    const u32 word = (addr & (VRAM_SIZE - 1)) / sizeof(u32);
+
+    return (((word & 1) != 0) ? (VRAM_SIZE >> 1) : 0) + sizeof(u32) * (word >> 1) + (addr % sizeof(u32));
+}
+
+// Splits a 64-bit area range into accesses within one word and runs of 64-bit words,
+// the low word of every 64-bit word is in the first module and the high word in the second
+template<typename WordAccess, typename RunAccess>
+static void split_interleaved_range(const u32 addr, const u32 size, WordAccess word_access, RunAccess run_access) {
+    u32 done = 0;
+
+    const auto access_words = [&](const u32 limit) {
+        while (done < limit) {
+            const u32 count = std::min<u32>(limit - done, sizeof(u32) - ((addr + done) % sizeof(u32)));
+
+            word_access(get_interleaved_offset(addr + done), done, count);
+
+            done += count;
+        }
+    };
+
+    // Up to the next 64-bit word
+    access_words(std::min<u32>(size, (sizeof(u64) - (addr % sizeof(u64))) % sizeof(u64)));
+
+    // Stops at the end of VRAM, the rest wraps around
+    const u32 masked_addr = (addr + done) & (VRAM_SIZE - 1);
+    const u32 num_words = std::min<u32>((size - done) / sizeof(u64), (VRAM_SIZE - masked_addr) / sizeof(u64));
+
+    if (num_words != 0) {
+        run_access(masked_addr / 2, done, num_words);
+
+        done += sizeof(u64) * num_words;
+    }
+
+    access_words(size);
+}
+
+void read_vram_interleaved_bytes(const u32 addr, u8* bytes, const u32 size) {
+    split_interleaved_range(
+        addr,
+        size,
+        [&](const u32 offset, const u32 index, const u32 count) {
+            std::memcpy(&bytes[index], &ctx.video_ram[offset], count);
+        },
+        [&](const u32 offset, const u32 index, const u32 num_words) {
+            const u8* first_module = &ctx.video_ram[offset];
+            const u8* second_module = &ctx.video_ram[(VRAM_SIZE >> 1) + offset];
+
+            u8* dst = &bytes[index];
+
+            // Merges both modules. GCC vectorizes this at -O3 only, the default Debug build runs it scalar
+            for (u32 i = 0; i < num_words; i++) {
+                std::memcpy(&dst[sizeof(u64) * i], &first_module[sizeof(u32) * i], sizeof(u32));
+                std::memcpy(&dst[sizeof(u64) * i + sizeof(u32)], &second_module[sizeof(u32) * i], sizeof(u32));
+            }
+        }
+    );
 }
 
-template<>
-u16 read_vram_interleaved(const u32 addr) {
-    const u32 masked_addr = addr & (VRAM_SIZE - 1);
+void write_vram_interleaved_bytes(const u32 addr, const u8* bytes, const u32 size) {
+    split_interleaved_range(
+        addr,
+        size,
+        [&](const u32 offset, const u32 index, const u32 count) {
+            std::memcpy(&ctx.video_ram[offset], &bytes[index], count);
+
+            hw::holly::bus::mark_dirty(hw::holly::bus::MEMORY_VRAM, offset, count);
+        },
+        [&](const u32 offset, const u32 index, const u32 num_words) {
+            u8* first_module = &ctx.video_ram[offset];
+            u8* second_module = &ctx.video_ram[(VRAM_SIZE >> 1) + offset];
+
+            const u8* src = &bytes[index];
+
+            // Splits into both modules. GCC vectorizes this at -O3 only, the default Debug build runs it scalar
+            for (u32 i = 0; i < num_words; i++) {
+                std::memcpy(&first_module[sizeof(u32) * i], &src[sizeof(u64) * i], sizeof(u32));
+                std::memcpy(&second_module[sizeof(u32) * i], &src[sizeof(u64) * i + sizeof(u32)], sizeof(u32));
+            }
 
-    const u32 offset = masked_addr >> 2;
+            hw::holly::bus::mark_dirty(hw::holly::bus::MEMORY_VRAM, offset, sizeof(u32) * num_words);
+            hw::holly::bus::mark_dirty(hw::holly::bus::MEMORY_VRAM, (VRAM_SIZE >> 1) + offset, sizeof(u32) * num_words);
+        }
+    );
+}
 
-    u32 data;
+template<typename T>
+T read_vram_interleaved(const u32 addr) {
+    T data;
 
-    if ((offset & 1) != 0) {
-        // Second VRAM module
-        std::memcpy(&data, &ctx.video_ram[(VRAM_SIZE >> 1) + sizeof(u32) * (offset >> 1)], sizeof(data));
+    if constexpr (sizeof(T) == sizeof(u64)) {
+        // Both modules
+        read_vram_interleaved_bytes(addr, (u8*)&data, sizeof(data));
     } else {
-        // First VRAM module
-        std::memcpy(&data, &ctx.video_ram[sizeof(u32) * (offset >> 1)], sizeof(data));
+        std::memcpy(&data, &ctx.video_ram[get_interleaved_offset(addr)], sizeof(data));
     }
 
-    return ((addr & 2) != 0) ? data >> 16 : data;
+    return data;
 }
 
+template u8 read_vram_interleaved(u32);
+template u16 read_vram_interleaved(u32);
 template u32 read_vram_interleaved(u32);
+template u64 read_vram_interleaved(u32);
+
+template<typename T>
+void write_vram_interleaved(const u32 addr, const T data) {
+    if constexpr (sizeof(T) == sizeof(u64)) {
+        write_vram_interleaved_bytes(addr, (const u8*)&data, sizeof(data));
+    } else {
+        const u32 offset = get_interleaved_offset(addr);
+
+        std::memcpy(&ctx.video_ram[offset], &data, sizeof(data));
+
+        hw::holly::bus::mark_dirty(hw::holly::bus::MEMORY_VRAM, offset, sizeof(data));
+    }
+}
+
+template void write_vram_interleaved(u32, u8);
+template void write_vram_interleaved(u32, u16);
+template void write_vram_interleaved(u32, u32);
+template void write_vram_interleaved(u32, u64);
 
 static u32 swizzle_to_linear(const u32 x, const u32 y) {
     u32 n = 0;
@@ -103,25 +292,6 @@ enum {
     SCAN_ORDER_LINEAR,
 };
 
-template<typename T>
-static T read_texel(const u32, const u32) {
-    std::printf("Unmapped texel read%zu\n", 8 * sizeof(T));
-    exit(1);
-}
-
-template<>
-u16 read_texel(const u32 x, const u32 y) {
-    u32 addr = ctx.texture_addr;
-
-    if (ctx.texture_control.regular.scan_order == SCAN_ORDER_SWIZZLED) {
-        addr += 2 * swizzle_to_linear(x, y);
-    } else {
-        addr += 2 * (ctx.u_size * y + x);
-    }
-
-    return read_vram_interleaved<u16>(addr);
-}
-
 static f32 edge_function(const Vertex& a, const Vertex& b, const Vertex& c) {
     return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
 }
@@ -165,20 +335,6 @@ static Color add_and_clamp(const Color color, const Color other_color) {
     };
 }
 
-static f32 clamp_uv(const f32 uv) {
-    if (uv < 0.0) {
-        return 0.0;
-    } else if (uv > 1.0) {
-        return 1.0;
-    }
-
-    return uv;
-}
-
-static f32 repeat_uv(const f32 uv) {
-    return std::abs(std::fmodf(uv, 1.0));
-}
-
 static u32 interpolate_colors(
     const f32 w0,
     const f32 w1,
@@ -195,15 +351,92 @@ static u32 interpolate_colors(
     return Color{.b = blue, .g = green, .r = red, .a = a.color.a}.raw;
 }
 
+static Color interpolate_offset_colors(
+    const f32 w0,
+    const f32 w1,
+    const f32 w2,
+    const Vertex& a,
+    const Vertex& b,
+    const Vertex& c,
+    const f32 area
+) {
+    return Color{
+        .b = clamp_color_channel(interpolate(w0, w1, w2, a.offset_color.b, b.offset_color.b, c.offset_color.b, area)),
+        .g = clamp_color_channel(interpolate(w0, w1, w2, a.offset_color.g, b.offset_color.g, c.offset_color.g, area)),
+        .r = clamp_color_channel(interpolate(w0, w1, w2, a.offset_color.r, b.offset_color.r, c.offset_color.r, area)),
+        .a = clamp_color_channel(interpolate(w0, w1, w2, a.offset_color.a, b.offset_color.a, c.offset_color.a, area))
+    };
+}
+
 enum : u32 {
+    TEXTURE_FORMAT_ARGB1555 = 0,
     TEXTURE_FORMAT_RGB565   = 1,
     TEXTURE_FORMAT_ARGB4444 = 2,
+    TEXTURE_FORMAT_YUV422   = 3,
+};
+
+enum {
+    FILTER_MODE_POINT,
+    FILTER_MODE_BILINEAR,
+    FILTER_MODE_TRILINEAR_A,
+    FILTER_MODE_TRILINEAR_B,
+};
+
+// 1024x1024 down to 1x1
+constexpr int MAX_MIP_LEVELS = 11;
+
+// Byte offset of the 1x1 level in 16-bit mipmapped textures
+constexpr u32 MIP_BASE_OFFSET = 6;
+
+// Keeps float to int conversions of texel coordinates defined
+constexpr f32 MAX_TEXEL_COORD = 16777216.0F;
+
+// ARGB8888 texels of every mip level, largest level first
+struct DecodedTexture {
+    u32 width, height;
+
+    int num_levels;
+    std::array<u32, MAX_MIP_LEVELS> level_offsets;
+
+    std::vector<u32> texels;
+};
+
+// Keyed by texture control word and TSP texture size, cleared on every render
+static std::unordered_map<u64, DecodedTexture> texture_cache;
+
+// Translucent modifier volumes are tested per pixel against the depth of each translucent polygon
+struct TranslucentVolumeTriangle {
+    Vertex a, b, c;
+    f32 area;
+
+    bool is_inclusive[3];
+
+    ClipRect bounds;
+};
+
+struct TranslucentVolume {
+    usize first_triangle, end_triangle;
+
+    bool is_inside;
 };
 
-static Color unpack_texel(const u16 texel) {
+// Cleared on every render
+static std::vector<TranslucentVolumeTriangle> translucent_volume_triangles;
+static std::vector<TranslucentVolume> translucent_volumes;
+
+static Color unpack_texel(const u16 texel, const u32 pixel_format) {
     Color color;
 
-    switch (ctx.texture_control.regular.pixel_format) {
+    switch (pixel_format) {
+        case TEXTURE_FORMAT_ARGB1555:
+            color.a = ((texel & (1 << 15)) != 0) ? 0xFF : 0;
+            color.r = (texel >> 10) << 3;
+            color.g = (texel >>  5) << 3;
+            color.b = (texel >>  0) << 3;
+            color.r |= color.r >> 5;
+            color.g |= color.g >> 5;
+            color.b |= color.b >> 5;
+            break;
         case TEXTURE_FORMAT_RGB565:
             color.a = 0xFF;
             color.r = (texel >> 11) << 3;
@@ -224,17 +457,213 @@ static Color unpack_texel(const u16 texel) {
             color.b |= color.b >> 4;
             break;
         default:
-            std::printf("TSP Unimplemented texture format %u\n", ctx.texture_control.regular.pixel_format);
+            std::printf("TSP Unimplemented texture format %u\n", pixel_format);
             exit(1);
     }
 
-    if (ctx.tsp_instr.ignore_tex_alpha) {
-        color.a = 0xFF;
+    return color;
+}
+
+// BT.601 in 6-bit fixed point
+static inline u32 convert_yuv(const int y, const int u, const int v) {
+    const u32 r = std::clamp(y + ((88 * v) >> 6), 0, 255);
+    const u32 g = std::clamp(y - ((22 * u + 44 * v) >> 6), 0, 255);
+    const u32 b = std::clamp(y + ((110 * u) >> 6), 0, 255);
+
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+// Even texels hold U and odd texels V for the pair.
+// Pairs are converted together so the loop has no gather, GCC vectorizes it at -O3
+static void convert_yuv422_row(const u16* texels, u32* colors, const u32 width) {
+    for (u32 x = 0; x < (width & ~1); x += 2) {
+        const int u = (texels[x + 0] & 0xFF) - 128;
+        const int v = (texels[x + 1] & 0xFF) - 128;
+
+        colors[x + 0] = convert_yuv(texels[x + 0] >> 8, u, v);
+        colors[x + 1] = convert_yuv(texels[x + 1] >> 8, u, v);
+    }
+
+    if ((width & 1) != 0) {
+        // The 1x1 mip level has no odd texel, U and V come from the same one
+        const u32 x = width - 1;
+
+        colors[x] = convert_yuv(texels[x] >> 8, (texels[x] & 0xFF) - 128, (texels[x] & 0xFF) - 128);
+    }
+}
+
+static DecodedTexture decode_texture() {
+    const u32 pixel_format = ctx.texture_control.regular.pixel_format;
+
+    const bool is_swizzled = ctx.texture_control.regular.scan_order == SCAN_ORDER_SWIZZLED;
+
+    DecodedTexture texture{.width = ctx.u_size, .height = ctx.v_size, .num_levels = 1, .level_offsets = {}, .texels = {}};
+
+    if (is_swizzled && ctx.texture_control.regular.use_mipmapping) {
+        // Mipmapped textures are square, V size is ignored
+        texture.height = texture.width;
+        texture.num_levels = std::countr_zero(texture.width) + 1;
     }
 
-    return color;
+    u32 num_texels = 0;
+
+    for (int level = 0; level < texture.num_levels; level++) {
+        texture.level_offsets[level] = num_texels;
+
+        num_texels += std::max(texture.width >> level, 1U) * std::max(texture.height >> level, 1U);
+    }
+
+    texture.texels.resize(num_texels);
+
+    std::vector<u16> raw_texels;
+
+    for (int level = 0; level < texture.num_levels; level++) {
+        const u32 width = std::max(texture.width >> level, 1U);
+        const u32 height = std::max(texture.height >> level, 1U);
+
+        u32 addr = ctx.texture_addr;
+
+        if (texture.num_levels > 1) {
+            // VRAM holds the chain smallest level first, the levels before this one add up to (size^2 - 1) / 3 texels
+            addr += MIP_BASE_OFFSET + sizeof(u16) * ((width * width - 1) / 3);
+        }
+
+        u32* texels = &texture.texels[texture.level_offsets[level]];
+
+        // Whole level in one bulk read, swizzled textures span up to the index of the last texel
+        const u32 num_raw_texels = is_swizzled ? (swizzle_to_linear(width - 1, height - 1) + 1) : (width * height);
+
+        raw_texels.resize(num_raw_texels);
+
+        read_vram_interleaved_bytes(addr, (u8*)raw_texels.data(), sizeof(u16) * num_raw_texels);
+
+        std::array<u16, 1024> row;
+
+        for (u32 y = 0; y < height; y++) {
+            const u16* raw_row = &raw_texels[width * y];
+
+            if (is_swizzled) {
+                for (u32 x = 0; x < width; x++) {
+                    row[x] = raw_texels[swizzle_to_linear(x, y)];
+                }
+
+                raw_row = row.data();
+            }
+
+            if (pixel_format == TEXTURE_FORMAT_YUV422) {
+                convert_yuv422_row(raw_row, &texels[width * y], width);
+                continue;
+            }
+
+            for (u32 x = 0; x < width; x++) {
+                texels[width * y + x] = unpack_texel(raw_row[x], pixel_format).raw;
+            }
+        }
+    }
+
+    return texture;
+}
+
+static const DecodedTexture& get_texture() {
+    const u64 key = ((u64)ctx.texture_control.raw << 32) | (ctx.tsp_instr.raw & 0x3F);
+
+    auto texture = texture_cache.find(key);
+
+    if (texture == texture_cache.end()) {
+        texture = texture_cache.emplace(key, decode_texture()).first;
+    }
+
+    return texture->second;
+}
+
+// Clamp takes priority over flip, flip mirrors every other repetition
+static int address_texel(const int coord, const int size, const bool clamp, const bool flip) {
+    if (clamp) {
+        return std::clamp(coord, 0, size - 1);
+    }
+
+    if (flip) {
+        const int mirrored_coord = coord & (2 * size - 1);
+
+        return (mirrored_coord < size) ? mirrored_coord : (2 * size - 1 - mirrored_coord);
+    }
+
+    return coord & (size - 1);
+}
+
+// Blends ARGB8888 colors by weight / 256, two channels per multiply
+static u32 lerp_color(const u32 color, const u32 other_color, const u32 weight) {
+    const u32 red_blue = (color & 0xFF00FF) * (256 - weight) + (other_color & 0xFF00FF) * weight;
+    const u32 alpha_green = ((color >> 8) & 0xFF00FF) * (256 - weight) + ((other_color >> 8) & 0xFF00FF) * weight;
+
+    return ((red_blue >> 8) & 0xFF00FF) | (alpha_green & 0xFF00FF00);
+}
+
+static u32 average_colors(const u32 color, const u32 other_color) {
+    return (color & other_color) + (((color ^ other_color) & 0xFEFEFEFE) >> 1);
+}
+
+static u32 sample_level(const DecodedTexture& texture, const int level, const f32 u, const f32 v, const bool is_bilinear) {
+    const int width = std::max(texture.width >> level, 1U);
+    const int height = std::max(texture.height >> level, 1U);
+
+    const u32* texels = &texture.texels[texture.level_offsets[level]];
+
+    const auto fetch = [&](const int x, const int y) {
+        const int tex_x = address_texel(x, width, ctx.tsp_instr.clamp_u, ctx.tsp_instr.flip_u);
+        const int tex_y = address_texel(y, height, ctx.tsp_instr.clamp_v, ctx.tsp_instr.flip_v);
+
+        return texels[width * tex_y + tex_x];
+    };
+
+    // Texel centers are at half-integer coordinates
+    const f32 offset = is_bilinear ? 0.5F : 0.0F;
+
+    const f32 s = std::fmin(std::fmax(u * width - offset, -MAX_TEXEL_COORD), MAX_TEXEL_COORD);
+    const f32 t = std::fmin(std::fmax(v * height - offset, -MAX_TEXEL_COORD), MAX_TEXEL_COORD);
+
+    const f32 s_floor = std::floor(s);
+    const f32 t_floor = std::floor(t);
+
+    const int x = (int)s_floor;
+    const int y = (int)t_floor;
+
+    if (!is_bilinear) {
+        return fetch(x, y);
+    }
+
+    const u32 weight_x = (u32)(256.0F * (s - s_floor));
+    const u32 weight_y = (u32)(256.0F * (t - t_floor));
+
+    return lerp_color(
+        lerp_color(fetch(x, y), fetch(x + 1, y), weight_x),
+        lerp_color(fetch(x, y + 1), fetch(x + 1, y + 1), weight_x),
+        weight_y
+    );
 }
 
+// LOD is clamped to [0, num_levels - 1]
+static u32 sample_texture(const DecodedTexture& texture, const f32 u, const f32 v, const f32 lod) {
+    const u32 filter_mode = ctx.tsp_instr.filter_mode;
+
+    const bool is_bilinear = filter_mode != FILTER_MODE_POINT;
+
+    if ((texture.num_levels == 1) || (filter_mode < FILTER_MODE_TRILINEAR_A)) {
+        return sample_level(texture, (int)(lod + 0.5F), u, v, is_bilinear);
+    }
+
+    const int level = (int)lod;
+
+    if (level == (texture.num_levels - 1)) {
+        return sample_level(texture, level, u, v, true);
+    }
+
+    return lerp_color(
+        sample_level(texture, level, u, v, true),
+        sample_level(texture, level + 1, u, v, true),
+        (u32)(256.0F * (lod - level))
+    );
+}
 enum {
     DEPTH_MODE_NEVER,
     DEPTH_MODE_LESS,
@@ -317,6 +746,64 @@ static Color combine_colors(const Color vertex_color, const Color texel_color) {
     return color;
 }
 
+enum {
+    FOG_MODE_TABLE,
+    FOG_MODE_VERTEX,
+    FOG_MODE_NONE,
+    FOG_MODE_TABLE_2,
+};
+
+static f32 get_table_fog_alpha(const f32 z) {
+    const int index = (int)(std::bit_cast<u32>(z) >> FOG_LUT_SHIFT) - ctx.fog_lut_base;
+
+    return ctx.fog_lut[std::clamp(index, 0, FOG_LUT_SIZE - 1)];
+}
+
+static u8 blend_fog_channel(const u8 channel, const u8 fog_channel, const f32 fog_alpha) {
+    return (u8)(channel + (fog_channel - channel) * fog_alpha);
+}
+
+static Color blend_fog(const Color color, const Color fog_color, const f32 fog_alpha) {
+    return Color{
+        .b = blend_fog_channel(color.b, fog_color.b, fog_alpha),
+        .g = blend_fog_channel(color.g, fog_color.g, fog_alpha),
+        .r = blend_fog_channel(color.r, fog_color.r, fog_alpha),
+        .a = color.a
+    };
+}
+
+static Color clamp_color(const Color color) {
+    return Color{
+        .b = std::clamp(color.b, ctx.fog.clamp_min.b, ctx.fog.clamp_max.b),
+        .g = std::clamp(color.g, ctx.fog.clamp_min.g, ctx.fog.clamp_max.g),
+        .r = std::clamp(color.r, ctx.fog.clamp_min.r, ctx.fog.clamp_max.r),
+        .a = std::clamp(color.a, ctx.fog.clamp_min.a, ctx.fog.clamp_max.a)
+    };
+}
+
+// Color clamp, then fog from the LUT or the offset color alpha
+static Color apply_fog(const Color color, const f32 z, const u8 vertex_fog_alpha) {
+    const Color clamped_color = ctx.tsp_instr.clamp_color ? clamp_color(color) : color;
+
+    switch (ctx.tsp_instr.fog_control) {
+        case FOG_MODE_TABLE:
+            return blend_fog(clamped_color, ctx.fog.table_color, get_table_fog_alpha(z));
+        case FOG_MODE_VERTEX:
+            return blend_fog(clamped_color, ctx.fog.vertex_color, vertex_fog_alpha / 255.0F);
+        case FOG_MODE_TABLE_2:
+            {
+                // Fog color replaces the pixel color, the table only provides alpha
+                Color fog_color = ctx.fog.table_color;
+
+                fog_color.a = (u8)(255.0F * get_table_fog_alpha(z));
+
+                return fog_color;
+            }
+        default:
+            return clamped_color;
+    }
+}
+
 enum {
     BLEND_FUNCTION_ZERO                 = 0,
     BLEND_FUNCTION_ONE                  = 1,
@@ -324,19 +811,18 @@ enum {
     BLEND_FUNCTION_INVERSE_SOURCE_ALPHA = 5,
 };
 
-static void blend_and_flush(const Color source_color, const u32 x, const u32 y) {
+// Buffer color is used as the destination unless the secondary buffer is selected
+static Color blend_colors(const Color source_color, const Color buffer_color, const u32 x, const u32 y) {
     Color src = source_color;
 
     if (ctx.tsp_instr.source_select) {
         src = Color{.raw = ctx.secondary_buffer[SCREEN_WIDTH * y + x]};
     }
 
-    Color dst;
+    Color dst = buffer_color;
 
     if (ctx.tsp_instr.destination_select) {
         dst = Color{.raw = ctx.secondary_buffer[SCREEN_WIDTH * y + x]};
-    } else {
-        dst = Color{.raw = ctx.color_buffer[SCREEN_WIDTH * y + x]};
     }
 
     const Color src_saved = src;
@@ -371,121 +857,851 @@ static void blend_and_flush(const Color source_color, const u32 x, const u32 y)
             exit(1);
     }
 
-    dst = add_and_clamp(src, dst);
-    
-    if (ctx.tsp_instr.destination_select) {
-        ctx.secondary_buffer[SCREEN_WIDTH * y + x] = dst.raw;
-    } else {
-        ctx.color_buffer[SCREEN_WIDTH * y + x] = dst.raw;
-    }
+    return add_and_clamp(src, dst);
 }
 
-static void draw_triangle(const Vertex* vertices) {
-    const Vertex& a = vertices[0];
-    Vertex b = vertices[1];
-    Vertex c = vertices[2];
+static void blend_and_flush(const Color source_color, const u32 x, const u32 y) {
+    const Color color = blend_colors(source_color, Color{.raw = ctx.color_buffer[SCREEN_WIDTH * y + x]}, x, y);
 
-    if (edge_function(a, b, c) < 0.0) {
-        std::swap(b, c);
-    }
+    if (ctx.tsp_instr.destination_select) {
+        ctx.secondary_buffer[SCREEN_WIDTH * y + x] = color.raw;
+    } else {
+        ctx.color_buffer[SCREEN_WIDTH * y + x] = color.raw;
 
-    const f32 area = edge_function(a, b, c);
+        ctx.row_flags[y] |= ROW_WRITTEN;
 
-    // Calculate bounding box
-    const int x_min = std::max(std::min(c.x, std::min(a.x, b.x)), 0.0F);
-    const int x_max = std::min(std::max(c.x, std::max(a.x, b.x)), (f32)SCREEN_WIDTH - 1);
-    const int y_min = std::max(std::min(c.y, std::min(a.y, b.y)), 0.0F);
-    const int y_max = std::min(std::max(c.y, std::max(a.y, b.y)), (f32)SCREEN_HEIGHT - 1);
+        u32& shadow_bits = ctx.shadow_mask[STENCIL_WORDS_PER_ROW * y + x / 32];
 
-    if constexpr (!SILENT_PVR) std::printf("PVR Bounding box (xmin: %d, xmax: %d, ymin: %d, ymax: %d)\n", x_min, x_max, y_min, y_max);
+        shadow_bits = (shadow_bits & ~(1U << (x % 32))) | ((u32)ctx.is_shadowed << (x % 32));
+    }
+}
 
-    if ((x_min >= x_max) || (y_min >= y_max)) {
+// Same blend against the colors pixels have inside opaque modifier volumes
+static void blend_inside_color(const Color source_color, const u32 x, const u32 y) {
+    if (ctx.tsp_instr.destination_select) {
         return;
     }
 
-    for (int y = y_min; y <= y_max; y++) {
-        for (int x = x_min; x <= x_max; x++) {
-            Vertex p{};
+    u32& pixel = ctx.inside_color_buffer[SCREEN_WIDTH * y + x];
 
-            p.x = (f32)x;
-            p.y = (f32)y;
+    pixel = blend_colors(source_color, Color{.raw = pixel}, x, y).raw;
+}
 
-            // Calculate weights
-            const f32 w0 = edge_function(b, c, p);
-            const f32 w1 = edge_function(c, a, p);
-            const f32 w2 = edge_function(a, b, p);
+// Cheap shadow, scales the color by scale / 256
+static Color scale_intensity(const Color color) {
+    const u32 scale = ctx.shadow.scale;
 
-            if ((w0 >= 0.0) && (w1 >= 0.0) && (w2 >= 0.0)) {
-                const f32 z = interpolate(w0, w1, w2, a.z, b.z, c.z, area);
+    return Color{
+        .b = (u8)((color.b * scale) >> 8),
+        .g = (u8)((color.g * scale) >> 8),
+        .r = (u8)((color.r * scale) >> 8),
+        .a = color.a
+    };
+}
 
-                if (!depth_test(z, x, y)) {
-                    continue;
-                }
+// Swaps in the parameters of the other volume of a two-volume polygon
+static void swap_parameters() {
+    const TspInstruction tsp_instr = ctx.tsp_instr;
+    const TextureControlWord texture_control = ctx.texture_control;
 
-                Color color = c.color;
+    set_tsp_instruction(ctx.second_tsp_instr);
+    set_texture_control(ctx.second_texture_control);
 
-                if (ctx.isp_instr.regular.use_gouraud_shading) {
-                    color.raw = interpolate_colors(w0, w1, w2, a, b, c, area);
-                }
+    ctx.second_tsp_instr = tsp_instr;
+    ctx.second_texture_control = texture_control;
+}
 
-                if (!ctx.tsp_instr.use_alpha) {
-                    color.a = 0xFF;
+// Same edge and depth tests as draw_volume_triangle()
+static bool is_inside_volume_triangle(const TranslucentVolumeTriangle& triangle, const int x, const int y, const f32 z) {
+    const ClipRect& bounds = triangle.bounds;
+
+    if ((x < bounds.x_min) || (x > bounds.x_max) || (y < bounds.y_min) || (y > bounds.y_max)) {
+        return false;
+    }
+
+    Vertex p{};
+
+    p.x = (f32)x;
+    p.y = (f32)y;
+
+    const f32 w0 = edge_function(triangle.b, triangle.c, p);
+    const f32 w1 = edge_function(triangle.c, triangle.a, p);
+    const f32 w2 = edge_function(triangle.a, triangle.b, p);
+
+    const bool is_inside = ((w0 > 0.0F) || (triangle.is_inclusive[0] && (w0 == 0.0F)))
+        && ((w1 > 0.0F) || (triangle.is_inclusive[1] && (w1 == 0.0F)))
+        && ((w2 > 0.0F) || (triangle.is_inclusive[2] && (w2 == 0.0F)));
+
+    return is_inside && (interpolate(w0, w1, w2, triangle.a.z, triangle.b.z, triangle.c.z, triangle.area) > z);
+}
+
+// A pixel is inside a volume if an odd number of its triangles are in front of it
+static bool is_in_translucent_volume(const int x, const int y, const f32 z) {
+    for (const auto& volume : translucent_volumes) {
+        bool parity = false;
+
+        for (usize i = volume.first_triangle; i < volume.end_triangle; i++) {
+            parity ^= is_inside_volume_triangle(translucent_volume_triangles[i], x, y, z);
+        }
+
+        if (parity == volume.is_inside) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Opaque and punch-through pixels also blend into the inside color buffer
+static bool keeps_inside_colors() {
+    return ctx.shadow.has_opaque_volumes && !ctx.shadow.is_intensity;
+}
+
+static void clear_color_row(const int y) {
+    std::fill_n(&ctx.color_buffer[SCREEN_WIDTH * y], SCREEN_WIDTH, 0);
+
+    ctx.row_flags[y] &= ~ROW_WRITTEN;
+}
+
+// Performs the clear requested by clear_buffers() for a row about to be drawn to
+static void prepare_row(const int y) {
+    if ((ctx.row_flags[y] & ROW_CLEAR_PENDING) == 0) {
+        return;
+    }
+
+    if ((ctx.row_flags[y] & ROW_WRITTEN) != 0) {
+        clear_color_row(y);
+    }
+
+    std::fill_n(&ctx.secondary_buffer[SCREEN_WIDTH * y], SCREEN_WIDTH, 0);
+    std::fill_n(&ctx.depth_buffer[SCREEN_WIDTH * y], SCREEN_WIDTH, 0.0F);
+
+    if (keeps_inside_colors()) {
+        std::fill_n(&ctx.inside_color_buffer[SCREEN_WIDTH * y], SCREEN_WIDTH, 0);
+    }
+
+    ctx.row_flags[y] &= ~ROW_CLEAR_PENDING;
+}
+
+// Screen-space derivatives and mip level of a 2x2 quad
+struct QuadLod {
+    f32 du_dx, dv_dx, du_dy, dv_dy, lod;
+
+    // Top row of the quad, -1 if not computed yet
+    int quad_y;
+};
+
+// Texture state of one parameter set, two-volume polygons have a second one
+struct TextureSampler {
+    const DecodedTexture* texture;
+
+    // Texture coordinates divided by W, interpolated linearly in screen space
+    f32 u_over_w[3], v_over_w[3];
+
+    bool use_derivatives;
+
+    // One entry per quad column, shared by both rows of a quad
+    std::array<QuadLod, SCREEN_WIDTH / 2> quads;
+};
+
+// Uses the current parameters, only quads in [x_min, x_max] are reset
+static void init_sampler(TextureSampler& sampler, const Vertex& a, const Vertex& b, const Vertex& c, const int x_min, const int x_max) {
+    sampler.texture = nullptr;
+    sampler.use_derivatives = false;
+
+    if (!ctx.isp_instr.regular.use_texture_mapping) {
+        return;
+    }
+
+    sampler.texture = &get_texture();
+
+    const Vertex* triangle[3] = {&a, &b, &c};
+
+    for (int i = 0; i < 3; i++) {
+        sampler.u_over_w[i] = triangle[i]->u * triangle[i]->z;
+        sampler.v_over_w[i] = triangle[i]->v * triangle[i]->z;
+    }
+
+    sampler.use_derivatives = (sampler.texture->num_levels > 1) || ctx.tsp_instr.super_sample;
+
+    if (sampler.use_derivatives) {
+        for (int quad_x = x_min / 2; quad_x <= (x_max / 2); quad_x++) {
+            sampler.quads[quad_x].quad_y = -1;
+        }
+    }
+}
+
+static void get_uv(
+    const Vertex& a,
+    const Vertex& b,
+    const Vertex& c,
+    const f32 area,
+    const TextureSampler& sampler,
+    const int x,
+    const int y,
+    f32& u,
+    f32& v
+) {
+    Vertex p{};
+
+    p.x = (f32)x;
+    p.y = (f32)y;
+
+    const f32 w0 = edge_function(b, c, p);
+    const f32 w1 = edge_function(c, a, p);
+    const f32 w2 = edge_function(a, b, p);
+
+    const f32 z = interpolate(w0, w1, w2, a.z, b.z, c.z, area);
+
+    u = interpolate(w0, w1, w2, sampler.u_over_w[0], sampler.u_over_w[1], sampler.u_over_w[2], area) / z;
+    v = interpolate(w0, w1, w2, sampler.v_over_w[0], sampler.v_over_w[1], sampler.v_over_w[2], area) / z;
+}
+
+// Quad with its top-left pixel at (x, y), both even
+static void update_quad(const Vertex& a, const Vertex& b, const Vertex& c, const f32 area, const TextureSampler& sampler, QuadLod& quad, const int x, const int y) {
+    f32 u, v, u_right, v_right, u_below, v_below;
+
+    get_uv(a, b, c, area, sampler, x, y, u, v);
+    get_uv(a, b, c, area, sampler, x + 1, y, u_right, v_right);
+    get_uv(a, b, c, area, sampler, x, y + 1, u_below, v_below);
+
+    quad.du_dx = u_right - u;
+    quad.dv_dx = v_right - v;
+    quad.du_dy = u_below - u;
+    quad.dv_dy = v_below - v;
+
+    const f32 width = sampler.texture->width;
+    const f32 height = sampler.texture->height;
+
+    const f32 length_x = (quad.du_dx * width) * (quad.du_dx * width) + (quad.dv_dx * height) * (quad.dv_dx * height);
+    const f32 length_y = (quad.du_dy * width) * (quad.du_dy * width) + (quad.dv_dy * height) * (quad.dv_dy * height);
+
+    // D adjust scales the derivatives in quarters, 0 is treated as 1.0
+    const f32 d_adjust = (ctx.tsp_instr.d_adjust != 0) ? (0.25F * ctx.tsp_instr.d_adjust) : 1.0F;
+
+    quad.lod = 0.5F * std::log2(std::max(length_x, length_y)) + std::log2(d_adjust);
+    quad.lod = std::fmin(std::fmax(quad.lod, 0.0F), (f32)(sampler.texture->num_levels - 1));
+
+    quad.quad_y = y;
+}
+
+// Without modifier volumes the pixel loop only shades the first parameter set
+template<bool USE_VOLUMES>
+static void draw_triangle(const Vertex* vertices, const Vertex* second_vertices) {
+    // Two-volume polygons have the same positions in both vertex sets
+    const bool is_two_volume = second_vertices != nullptr;
+
+    const Vertex& a = vertices[0];
+    Vertex b = vertices[1];
+    Vertex c = vertices[2];
+
+    const Vertex& second_a = is_two_volume ? second_vertices[0] : a;
+    Vertex second_b = is_two_volume ? second_vertices[1] : b;
+    Vertex second_c = is_two_volume ? second_vertices[2] : c;
+
+    if (edge_function(a, b, c) < 0.0) {
+        std::swap(b, c);
+        std::swap(second_b, second_c);
+    }
+
+    const f32 area = edge_function(a, b, c);
+
+    // Calculate bounding box
+    const int x_min = std::max(std::min(c.x, std::min(a.x, b.x)), (f32)ctx.clip.x_min);
+    const int x_max = std::min(std::max(c.x, std::max(a.x, b.x)), (f32)ctx.clip.x_max);
+    const int y_min = std::max(std::min(c.y, std::min(a.y, b.y)), (f32)ctx.clip.y_min);
+    const int y_max = std::min(std::max(c.y, std::max(a.y, b.y)), (f32)ctx.clip.y_max);
+
+    if constexpr (!SILENT_PVR) std::printf("PVR Bounding box (xmin: %d, xmax: %d, ymin: %d, ymax: %d)\n", x_min, x_max, y_min, y_max);
+
+    if ((x_min > x_max) || (y_min > y_max)) {
+        return;
+    }
+
+    u64 num_pixels = 0;
+
+    const bool is_punch_through = ctx.list_type == ta::LIST_TYPE_PUNCHTHROUGH;
+    const bool is_translucent = ctx.list_type == ta::LIST_TYPE_TRANSLUCENT;
+
+    TextureSampler first_sampler, second_sampler;
+
+    init_sampler(first_sampler, a, b, c, x_min, x_max);
+
+    if (is_two_volume) {
+        swap_parameters();
+
+        init_sampler(second_sampler, second_a, second_b, second_c, x_min, x_max);
+
+        swap_parameters();
+    }
+
+    // Color of one parameter set before blending, the vertices only provide colors and UVs
+    const auto shade_pixel = [&](
+        const Vertex& va,
+        const Vertex& vb,
+        const Vertex& vc,
+        TextureSampler& sampler,
+        const int x,
+        const int y,
+        const f32 w0,
+        const f32 w1,
+        const f32 w2,
+        const f32 z
+    ) {
+        Color color = vc.color;
+
+        if (ctx.isp_instr.regular.use_gouraud_shading) {
+            color.raw = interpolate_colors(w0, w1, w2, va, vb, vc, area);
+        }
+
+        if (!ctx.tsp_instr.use_alpha) {
+            color.a = 0xFF;
+        }
+
+        Color offset_color{};
+
+        if (ctx.isp_instr.regular.use_offset_color) {
+            offset_color = vc.offset_color;
+
+            if (ctx.isp_instr.regular.use_gouraud_shading) {
+                offset_color = interpolate_offset_colors(w0, w1, w2, va, vb, vc, area);
+            }
+        }
+
+        if (sampler.texture != nullptr) {
+            const DecodedTexture& texture = *sampler.texture;
+
+            const f32 u = interpolate(w0, w1, w2, sampler.u_over_w[0], sampler.u_over_w[1], sampler.u_over_w[2], area) / z;
+            const f32 v = interpolate(w0, w1, w2, sampler.v_over_w[0], sampler.v_over_w[1], sampler.v_over_w[2], area) / z;
+
+            f32 lod = 0.0F;
+
+            const QuadLod* quad = nullptr;
+
+            if (sampler.use_derivatives) {
+                QuadLod& cached_quad = sampler.quads[x / 2];
+
+                if (cached_quad.quad_y != (y & ~1)) {
+                    update_quad(va, vb, vc, area, sampler, cached_quad, x & ~1, y & ~1);
                 }
 
-                if (ctx.isp_instr.regular.use_texture_mapping) {
-                    f32 u = interpolate(w0, w1, w2, a.u / (1.0 / a.z), b.u / (1.0 / b.z), c.u / (1.0 / c.z), area);
-                    f32 v = interpolate(w0, w1, w2, a.v / (1.0 / a.z), b.v / (1.0 / b.z), c.v / (1.0 / c.z), area);
+                lod = cached_quad.lod;
+                quad = &cached_quad;
+            }
 
-                    u /= z;
-                    v /= z;
+            Color texel;
 
-                    if (ctx.tsp_instr.clamp_u) {
-                        u = clamp_uv(u);
-                    } else {
-                        u = repeat_uv(u);
-                    }
+            if (ctx.tsp_instr.super_sample) {
+                // Four samples a quarter pixel from the center, super-sampling always has derivatives
+                const f32 du0 = 0.25F * (quad->du_dx + quad->du_dy), du1 = 0.25F * (quad->du_dx - quad->du_dy);
+                const f32 dv0 = 0.25F * (quad->dv_dx + quad->dv_dy), dv1 = 0.25F * (quad->dv_dx - quad->dv_dy);
 
-                    if (ctx.tsp_instr.clamp_v) {
-                        v = clamp_uv(v);
-                    } else {
-                        v = repeat_uv(v);
-                    }
+                texel.raw = average_colors(
+                    average_colors(sample_texture(texture, u - du0, v - dv0, lod), sample_texture(texture, u + du0, v + dv0, lod)),
+                    average_colors(sample_texture(texture, u - du1, v - dv1, lod), sample_texture(texture, u + du1, v + dv1, lod))
+                );
+            } else {
+                texel.raw = sample_texture(texture, u, v, lod);
+            }
 
-                    if (ctx.tsp_instr.flip_u) {
-                        u = 1.0 - u;
-                    }
+            if (ctx.tsp_instr.ignore_tex_alpha) {
+                texel.a = 0xFF;
+            }
 
-                    if (ctx.tsp_instr.flip_v) {
-                        v = 1.0 - v;
-                    }
+            color = combine_colors(color, texel);
+
+            if (ctx.isp_instr.regular.use_offset_color) {
+                color = add_and_clamp(color, Color{.b = offset_color.b, .g = offset_color.g, .r = offset_color.r, .a = 0});
+            }
+        }
 
-                    const int tex_x = ctx.u_size * u;
-                    const int tex_y = ctx.v_size * v;
+        return apply_fog(color, z, offset_color.a);
+    };
+
+    // Color of pixels inside modifier volumes, single-volume polygons are unchanged in two-volume mode
+    const auto shade_inside = [&](const Color color, const int x, const int y, const f32 w0, const f32 w1, const f32 w2, const f32 z) {
+        if (!is_two_volume) {
+            return ctx.shadow.is_intensity ? scale_intensity(color) : color;
+        }
+
+        swap_parameters();
+
+        const Color inside_color = shade_pixel(second_a, second_b, second_c, second_sampler, x, y, w0, w1, w2, z);
+
+        swap_parameters();
 
-                    color = combine_colors(
-                        color,
-                        unpack_texel(read_texel<u16>(tex_x, tex_y))
-                    );
+        return inside_color;
+    };
+
+    for (int y = y_min; y <= y_max; y++) {
+        prepare_row(y);
+
+        for (int x = x_min; x <= x_max; x++) {
+            Vertex p{};
+
+            p.x = (f32)x;
+            p.y = (f32)y;
+
+            // Calculate weights
+            const f32 w0 = edge_function(b, c, p);
+            const f32 w1 = edge_function(c, a, p);
+            const f32 w2 = edge_function(a, b, p);
+
+            if ((w0 >= 0.0) && (w1 >= 0.0) && (w2 >= 0.0)) {
+                const f32 z = interpolate(w0, w1, w2, a.z, b.z, c.z, area);
+
+                // Punch-through polygons only write depth for texels that pass the alpha test
+                if (!is_punch_through && !depth_test(z, x, y)) {
+                    continue;
+                }
+
+                Color color = shade_pixel(a, b, c, first_sampler, x, y, w0, w1, w2, z);
+
+                if (is_punch_through && ((color.a < ctx.alpha_threshold) || !depth_test(z, x, y))) {
+                    continue;
+                }
+
+                if constexpr (USE_VOLUMES) {
+                    // Opaque volumes are applied after the opaque and punch-through lists, translucent ones per pixel
+                    if (!is_translucent) {
+                        blend_inside_color(ctx.is_shadowed ? shade_inside(color, x, y, w0, w1, w2, z) : color, x, y);
+                    } else if (is_in_translucent_volume(x, y, z)) {
+                        color = shade_inside(color, x, y, w0, w1, w2, z);
+                    }
                 }
 
                 blend_and_flush(color, x, y);
+
+                num_pixels++;
+            }
+        }
+    }
+
+    perf::add(perf::COUNTER_PIXELS, num_pixels);
+}
+
+static void draw_triangle(const Vertex* vertices, const Vertex* second_vertices) {
+    perf::ScopedTimer timer(perf::SCOPE_TRIANGLE);
+
+    perf::add(perf::COUNTER_TRIANGLES, 1);
+
+    const bool uses_volumes = (ctx.list_type == ta::LIST_TYPE_TRANSLUCENT)
+        ? (ctx.is_shadowed && !translucent_volumes.empty())
+        : keeps_inside_colors();
+
+    if (uses_volumes) {
+        draw_triangle<true>(vertices, second_vertices);
+    } else {
+        draw_triangle<false>(vertices, nullptr);
+    }
+}
+
+// Top-left fill rule, shared edges of volume triangles must toggle the stencil exactly once
+static bool is_top_left_edge(const Vertex& from, const Vertex& to) {
+    const f32 dx = to.x - from.x;
+    const f32 dy = to.y - from.y;
+
+    return (dy < 0.0F) || ((dy == 0.0F) && (dx > 0.0F));
+}
+
+static void draw_volume_triangle(const Vertex* vertices) {
+    const Vertex& a = vertices[0];
+    Vertex b = vertices[1];
+    Vertex c = vertices[2];
+
+    if (edge_function(a, b, c) < 0.0) {
+        std::swap(b, c);
+    }
+
+    const f32 area = edge_function(a, b, c);
+
+    if (area == 0.0F) {
+        return;
+    }
+
+    const int x_min = std::max(std::min(c.x, std::min(a.x, b.x)), (f32)ctx.clip.x_min);
+    const int x_max = std::min(std::max(c.x, std::max(a.x, b.x)), (f32)ctx.clip.x_max);
+    const int y_min = std::max(std::min(c.y, std::min(a.y, b.y)), (f32)ctx.clip.y_min);
+    const int y_max = std::min(std::max(c.y, std::max(a.y, b.y)), (f32)ctx.clip.y_max);
+
+    if ((x_min > x_max) || (y_min > y_max)) {
+        return;
+    }
+
+    ctx.stencil_y_min = std::min(ctx.stencil_y_min, y_min);
+    ctx.stencil_y_max = std::max(ctx.stencil_y_max, y_max);
+
+    // Edges that are not top-left exclude pixels exactly on them
+    const u32 is_inclusive0 = is_top_left_edge(b, c);
+    const u32 is_inclusive1 = is_top_left_edge(c, a);
+    const u32 is_inclusive2 = is_top_left_edge(a, b);
+
+    // x steps of edge_function(), the products are the same as in its per-pixel form
+    const f32 x_step0 = c.y - b.y;
+    const f32 x_step1 = a.y - c.y;
+    const f32 x_step2 = b.y - a.y;
+    const f32 z0 = a.z;
+    const f32 z1 = b.z;
+    const f32 z2 = c.z;
+
+    for (int y = y_min; y <= y_max; y++) {
+        prepare_row(y);
+
+        const f32* depth_row = &ctx.depth_buffer[SCREEN_WIDTH * y];
+
+        const f32 row0 = (c.x - b.x) * ((f32)y - b.y);
+        const f32 row1 = (a.x - c.x) * ((f32)y - c.y);
+        const f32 row2 = (b.x - a.x) * ((f32)y - a.y);
+
+        for (int word_x = x_min & ~31; word_x <= x_max; word_x += 32) {
+            const f32* depth_word = &depth_row[word_x];
+
+            u32 mask = 0;
+
+            // Tests are combined with bitwise operators, without control flow GCC vectorizes this at -O2
+            for (int i = 0; i < 32; i++) {
+                const int x = word_x + i;
+
+                const f32 w0 = row0 - x_step0 * ((f32)x - b.x);
+                const f32 w1 = row1 - x_step1 * ((f32)x - c.x);
+                const f32 w2 = row2 - x_step2 * ((f32)x - a.x);
+
+                const u32 is_inside = ((u32)(w0 > 0.0F) | (is_inclusive0 & (u32)(w0 == 0.0F)))
+                    & ((u32)(w1 > 0.0F) | (is_inclusive1 & (u32)(w1 == 0.0F)))
+                    & ((u32)(w2 > 0.0F) | (is_inclusive2 & (u32)(w2 == 0.0F)));
+
+                // Toggle where the volume surface is in front of the opaque surface
+                const u32 is_in_front = interpolate(w0, w1, w2, z0, z1, z2, area) > depth_word[i];
+
+                const u32 is_in_span = (u32)(x >= x_min) & (u32)(x <= x_max);
+
+                mask |= STENCIL_LANE_BITS[i] & (0U - (is_inside & is_in_front & is_in_span));
+            }
+
+            ctx.stencil[STENCIL_WORDS_PER_ROW * y + word_x / 32] ^= mask;
+        }
+    }
+}
+
+void submit_volume_triangle(const Vertex* vertices) {
+    draw_volume_triangle(vertices);
+}
+
+void submit_translucent_volume_triangle(const Vertex* vertices) {
+    TranslucentVolumeTriangle triangle{};
+
+    triangle.a = vertices[0];
+    triangle.b = vertices[1];
+    triangle.c = vertices[2];
+
+    if (edge_function(triangle.a, triangle.b, triangle.c) < 0.0) {
+        std::swap(triangle.b, triangle.c);
+    }
+
+    triangle.area = edge_function(triangle.a, triangle.b, triangle.c);
+
+    if (triangle.area == 0.0F) {
+        return;
+    }
+
+    triangle.is_inclusive[0] = is_top_left_edge(triangle.b, triangle.c);
+    triangle.is_inclusive[1] = is_top_left_edge(triangle.c, triangle.a);
+    triangle.is_inclusive[2] = is_top_left_edge(triangle.a, triangle.b);
+
+    triangle.bounds = ClipRect{
+        .x_min = (int)std::max(std::min(triangle.c.x, std::min(triangle.a.x, triangle.b.x)), (f32)ctx.clip.x_min),
+        .x_max = (int)std::min(std::max(triangle.c.x, std::max(triangle.a.x, triangle.b.x)), (f32)ctx.clip.x_max),
+        .y_min = (int)std::max(std::min(triangle.c.y, std::min(triangle.a.y, triangle.b.y)), (f32)ctx.clip.y_min),
+        .y_max = (int)std::min(std::max(triangle.c.y, std::max(triangle.a.y, triangle.b.y)), (f32)ctx.clip.y_max)
+    };
+
+    translucent_volume_triangles.push_back(triangle);
+}
+
+void end_translucent_volume(const bool is_inside) {
+    const usize first_triangle = translucent_volumes.empty() ? 0 : translucent_volumes.back().end_triangle;
+
+    translucent_volumes.push_back(TranslucentVolume{
+        .first_triangle = first_triangle,
+        .end_triangle = translucent_volume_triangles.size(),
+        .is_inside = is_inside
+    });
+}
+
+void end_volume(const bool is_inside) {
+    if (is_inside) {
+        for (int y = ctx.stencil_y_min; y <= ctx.stencil_y_max; y++) {
+            for (int i = STENCIL_WORDS_PER_ROW * y; i < (STENCIL_WORDS_PER_ROW * (y + 1)); i++) {
+                ctx.volume_mask[i] |= ctx.stencil[i];
             }
         }
+    } else {
+        // Everything outside the volume, including rows it does not touch
+        for (usize i = 0; i < STENCIL_WORDS; i++) {
+            ctx.volume_mask[i] |= ~ctx.stencil[i];
+        }
+    }
+
+    if (ctx.stencil_y_min <= ctx.stencil_y_max) {
+        std::fill(
+            &ctx.stencil[STENCIL_WORDS_PER_ROW * ctx.stencil_y_min],
+            &ctx.stencil[STENCIL_WORDS_PER_ROW * (ctx.stencil_y_max + 1)],
+            0
+        );
+    }
+
+    ctx.stencil_y_min = SCREEN_HEIGHT;
+    ctx.stencil_y_max = -1;
+}
+
+void apply_opaque_volumes() {
+    for (usize i = 0; i < STENCIL_WORDS; i++) {
+        u32 bits = ctx.shadow_mask[i] & ctx.volume_mask[i];
+
+        while (bits != 0) {
+            const int bit = std::countr_zero(bits);
+
+            u32& pixel = ctx.color_buffer[32 * i + bit];
+
+            if (ctx.shadow.is_intensity) {
+                pixel = scale_intensity(Color{.raw = pixel}).raw;
+            } else {
+                pixel = ctx.inside_color_buffer[32 * i + bit];
+            }
+
+            bits &= bits - 1;
+        }
     }
 }
 
 void finish_render() {
-    /* FILE* file = std::fopen("frame_dump.ppm", "w+");
+    // Rows nothing was drawn to still have to show the clear color.
+    // Depth and secondary rows stay pending, they are only read while drawing
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        if ((ctx.row_flags[y] & (ROW_CLEAR_PENDING | ROW_WRITTEN)) == (ROW_CLEAR_PENDING | ROW_WRITTEN)) {
+            clear_color_row(y);
+        }
+    }
+}
 
-    std::fprintf(file, "P6\n%d %d\n255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+static u32 get_write_pixel_size(const u32 format) {
+    switch (format) {
+        case WRITE_FORMAT_KRGB0555:
+        case WRITE_FORMAT_RGB565:
+        case WRITE_FORMAT_ARGB4444:
+        case WRITE_FORMAT_ARGB1555:
+            return sizeof(u16);
+        case WRITE_FORMAT_RGB888:
+            return 3;
+        case WRITE_FORMAT_KRGB0888:
+        case WRITE_FORMAT_ARGB8888:
+            return sizeof(u32);
+        default:
+            std::printf("Unimplemented framebuffer write format %u\n", format);
+            exit(1);
+    }
+}
+
+static u32 add_dither(const u32 channel, const u32 dither, const int lost_bits) {
+    return std::min<u32>(channel + (dither >> (4 - lost_bits)), 0xFF);
+}
+
+// Channels are extracted with shifts, GCC does not vectorize the byte fields of Color.
+// Every format vectorizes at -O3 except RGB888, which GCC does not find profitable
+template<u32 FORMAT>
+static void pack_span(const FramebufferWrite& fb, const u32* src, u8* dst, const u32 x, const u32 y, const u32 count) {
+    const u8* dither_row = &DITHER_ROWS[fb.enable_dithering ? (y & 3) : 4][x & 3];
+
+    for (u32 i = 0; i < count; i++) {
+        const u32 color = src[i];
+
+        const u32 a = color >> 24;
+        u32 r = (color >> 16) & 0xFF;
+        u32 g = (color >> 8) & 0xFF;
+        u32 b = color & 0xFF;
+
+        if constexpr (FORMAT <= WRITE_FORMAT_ARGB1555) {
+            const u32 dither = dither_row[i];
+
+            const int lost_bits = (FORMAT == WRITE_FORMAT_ARGB4444) ? 4 : 3;
+
+            r = add_dither(r, dither, lost_bits);
+            g = add_dither(g, dither, (FORMAT == WRITE_FORMAT_RGB565) ? 2 : lost_bits);
+            b = add_dither(b, dither, lost_bits);
+        }
 
-    for (u32 color : ctx.color_buffer) {
-        fputc(color >> 16, file);
-        fputc(color >> 8, file);
-        fputc(color, file);
+        u16 pixel;
+        u32 word;
+
+        switch (FORMAT) {
+            case WRITE_FORMAT_KRGB0555:
+                pixel = ((fb.k_value >> 7) << 15) | ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+                std::memcpy(&dst[sizeof(u16) * i], &pixel, sizeof(pixel));
+                break;
+            case WRITE_FORMAT_RGB565:
+                pixel = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+                std::memcpy(&dst[sizeof(u16) * i], &pixel, sizeof(pixel));
+                break;
+            case WRITE_FORMAT_ARGB4444:
+                pixel = ((a >> 4) << 12) | ((r >> 4) << 8) | ((g >> 4) << 4) | (b >> 4);
+                std::memcpy(&dst[sizeof(u16) * i], &pixel, sizeof(pixel));
+                break;
+            case WRITE_FORMAT_ARGB1555:
+                pixel = ((a >= fb.alpha_threshold) << 15) | ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+                std::memcpy(&dst[sizeof(u16) * i], &pixel, sizeof(pixel));
+                break;
+            case WRITE_FORMAT_RGB888:
+                dst[3 * i + 0] = b;
+                dst[3 * i + 1] = g;
+                dst[3 * i + 2] = r;
+                break;
+            case WRITE_FORMAT_KRGB0888:
+                word = ((u32)fb.k_value << 24) | (color & 0xFFFFFF);
+                std::memcpy(&dst[sizeof(u32) * i], &word, sizeof(word));
+                break;
+            case WRITE_FORMAT_ARGB8888:
+                std::memcpy(&dst[sizeof(u32) * i], &color, sizeof(color));
+                break;
+        }
     }
+}
 
-    std::fclose(file); */
+static void pack_span(const FramebufferWrite& fb, const u32* src, u8* dst, const u32 x, const u32 y, const u32 count) {
+    switch (fb.format) {
+        case WRITE_FORMAT_KRGB0555:
+            return pack_span<WRITE_FORMAT_KRGB0555>(fb, src, dst, x, y, count);
+        case WRITE_FORMAT_RGB565:
+            return pack_span<WRITE_FORMAT_RGB565>(fb, src, dst, x, y, count);
+        case WRITE_FORMAT_ARGB4444:
+            return pack_span<WRITE_FORMAT_ARGB4444>(fb, src, dst, x, y, count);
+        case WRITE_FORMAT_ARGB1555:
+            return pack_span<WRITE_FORMAT_ARGB1555>(fb, src, dst, x, y, count);
+        case WRITE_FORMAT_RGB888:
+            return pack_span<WRITE_FORMAT_RGB888>(fb, src, dst, x, y, count);
+        case WRITE_FORMAT_KRGB0888:
+            return pack_span<WRITE_FORMAT_KRGB0888>(fb, src, dst, x, y, count);
+        case WRITE_FORMAT_ARGB8888:
+            return pack_span<WRITE_FORMAT_ARGB8888>(fb, src, dst, x, y, count);
+    }
+}
+
+void write_back(const FramebufferWrite& fb) {
+    const u32 pixel_size = get_write_pixel_size(fb.format);
+
+    const u32 x_max = std::min<u32>(fb.x_max, SCREEN_WIDTH - 1);
+    const u32 y_max = std::min<u32>(fb.y_max, SCREEN_HEIGHT - 1);
+
+    if ((fb.x_min > x_max) || (fb.y_min > y_max)) {
+        return;
+    }
+
+    for (u32 tile_y = fb.y_min; tile_y <= y_max; tile_y += TILE_SIZE) {
+        for (u32 tile_x = fb.x_min; tile_x <= x_max; tile_x += TILE_SIZE) {
+            const u32 width = std::min(TILE_SIZE, x_max - tile_x + 1);
+
+            for (u32 y = tile_y; y <= std::min(tile_y + TILE_SIZE - 1, y_max); y++) {
+                const u32 addr = (fb.addr + fb.line_stride * y + pixel_size * tile_x) & (VRAM_SIZE - 1);
+
+                if ((addr + pixel_size * width) > VRAM_SIZE) {
+                    continue;
+                }
+
+                pack_span(fb, &ctx.color_buffer[SCREEN_WIDTH * y + tile_x], &ctx.video_ram[addr], tile_x, y, width);
+            }
+        }
+    }
+
+    // Let snapshots see the new frame, rows past the end of VRAM wrap around to its start
+    const u32 first_addr = (fb.addr + fb.line_stride * fb.y_min) & (VRAM_SIZE - 1);
+    const u32 size = std::min<u32>(fb.line_stride * (y_max - fb.y_min) + pixel_size * (x_max + 1), VRAM_SIZE);
+    const u32 end_size = std::min<u32>(size, VRAM_SIZE - first_addr);
+
+    hw::holly::bus::mark_dirty(hw::holly::bus::MEMORY_VRAM, first_addr, end_size);
+    hw::holly::bus::mark_dirty(hw::holly::bus::MEMORY_VRAM, 0, size - end_size);
+}
+
+static u32 get_read_pixel_size(const u32 format) {
+    switch (format) {
+        case READ_FORMAT_RGB0555:
+        case READ_FORMAT_RGB565:
+            return sizeof(u16);
+        case READ_FORMAT_RGB888:
+            return 3;
+        default:
+            return sizeof(u32);
+    }
+}
+
+static u32 unpack_pixel(const FramebufferRead& fb, const u32 addr) {
+    u32 pixel;
+    u32 r, g, b;
+
+    switch (fb.format) {
+        case READ_FORMAT_RGB0555:
+            pixel = read_vram_linear<u16>(addr);
+
+            r = (((pixel >> 10) & 0x1F) << 3) | fb.concat_value;
+            g = (((pixel >>  5) & 0x1F) << 3) | fb.concat_value;
+            b = (((pixel >>  0) & 0x1F) << 3) | fb.concat_value;
+            break;
+        case READ_FORMAT_RGB565:
+            pixel = read_vram_linear<u16>(addr);
+
+            r = (((pixel >> 11) & 0x1F) << 3) | fb.concat_value;
+            g = (((pixel >>  5) & 0x3F) << 2) | (fb.concat_value & 3);
+            b = (((pixel >>  0) & 0x1F) << 3) | fb.concat_value;
+            break;
+        case READ_FORMAT_RGB888:
+            b = ctx.video_ram[(addr + 0) & (VRAM_SIZE - 1)];
+            g = ctx.video_ram[(addr + 1) & (VRAM_SIZE - 1)];
+            r = ctx.video_ram[(addr + 2) & (VRAM_SIZE - 1)];
+            break;
+        default:
+            return read_vram_linear<u32>(addr) & 0xFFFFFF;
+    }
+
+    return (r << 16) | (g << 8) | b;
+}
+
+void scan_out(const FramebufferRead& fb) {
+    const u32 pixel_size = get_read_pixel_size(fb.format);
+
+    const u32 line_pixels = (sizeof(u32) * fb.line_words) / pixel_size;
+    const u32 line_size = sizeof(u32) * (fb.line_words + fb.modulus - 1);
+
+    std::array<u32, SCREEN_WIDTH> line;
+
+    for (u32 y = 0; y < SCREEN_HEIGHT; y++) {
+        const u32 src_y = fb.line_double ? (y / 2) : y;
+
+        if (!fb.enable || (src_y >= fb.num_lines)) {
+            line.fill(fb.border_color);
+        } else {
+            const u32 line_addr = fb.addr + line_size * src_y;
+
+            for (u32 x = 0; x < SCREEN_WIDTH; x++) {
+                const u32 src_x = fb.pixel_double ? (x / 2) : x;
+
+                if (src_x >= line_pixels) {
+                    line[x] = fb.border_color;
+                } else {
+                    line[x] = unpack_pixel(fb, line_addr + pixel_size * src_x);
+                }
+            }
+        }
+
+        u32* display_line = &ctx.display_buffer[SCREEN_WIDTH * y];
+
+        if (std::memcmp(display_line, line.data(), sizeof(line)) != 0) {
+            std::memcpy(display_line, line.data(), sizeof(line));
+
+            ctx.row_flags[y] |= ROW_DIRTY;
+        }
+    }
+
+    if (framedump::is_enabled()) {
+        framedump::submit_frame(ctx.display_buffer.data(), scheduler::get_timestamp());
+    }
 }
 
 void initialize() {
@@ -502,6 +1718,8 @@ void reset() {
     ta::reset();
 
     std::memset(&ctx, 0, sizeof(ctx));
+
+    texture_cache.clear();
 }
 
 void shutdown() {
@@ -511,6 +1729,25 @@ void shutdown() {
     ta::shutdown();
 }
 
+void save_state(common::StateWriter& writer) {
+    core::save_state(writer);
+    interface::save_state(writer);
+    spg::save_state(writer);
+    ta::save_state(writer);
+
+    // VRAM is tracked by the snapshot code, render buffers are rebuilt every frame
+    writer.write_range(&ctx.isp_instr, &ctx + 1);
+}
+
+void load_state(common::StateReader& reader) {
+    core::load_state(reader);
+    interface::load_state(reader);
+    spg::load_state(reader);
+    ta::load_state(reader);
+
+    reader.read_range(&ctx.isp_instr, &ctx + 1);
+}
+
 void set_isp_instruction(const IspInstruction isp_instr) {
     ctx.isp_instr = isp_instr;
 }
@@ -530,24 +1767,117 @@ void set_texture_control(const TextureControlWord texture_control) {
     ctx.texture_addr = texture_control.regular.texture_addr * sizeof(u64);
 }
 
-void set_translucent(const bool is_translucent) {
-    ctx.is_translucent = is_translucent;
+void set_list_type(const u32 list_type) {
+    ctx.list_type = list_type;
+}
+
+void set_shadowed(const bool is_shadowed) {
+    ctx.is_shadowed = is_shadowed;
+}
+
+void set_alpha_threshold(const u8 alpha_threshold) {
+    ctx.alpha_threshold = alpha_threshold;
+}
+
+void set_clip_rect(const ClipRect& clip) {
+    ctx.clip = ClipRect{
+        .x_min = std::max(clip.x_min, 0),
+        .x_max = std::min(clip.x_max, SCREEN_WIDTH - 1),
+        .y_min = std::max(clip.y_min, 0),
+        .y_max = std::min(clip.y_max, SCREEN_HEIGHT - 1)
+    };
+}
+
+void set_fog_parameters(const FogParameters& fog) {
+    ctx.fog = fog;
+}
+
+void set_shadow_parameters(const ShadowParameters& shadow) {
+    ctx.shadow = shadow;
+}
+
+void set_second_parameters(const TspInstruction tsp_instr, const TextureControlWord texture_control) {
+    ctx.second_tsp_instr = tsp_instr;
+    ctx.second_texture_control = texture_control;
+}
+
+// Alpha of the hardware table for density scaled 1/W
+static f32 lookup_fog_table(const u16* fog_table, const f32 fog_w) {
+    const u32 bits = std::bit_cast<u32>(std::fmin(std::fmax(fog_w, 1.0F), 255.999985F));
+
+    // Exponent and the top 4 mantissa bits select an entry, the next 8 bits blend its two halves
+    const u32 index = (((bits >> 23) - 127) << 4) | ((bits >> 19) & 0xF);
+    const u32 weight = (bits >> 11) & 0xFF;
+
+    const u32 entry = fog_table[index];
+
+    return ((entry >> 8) * (256 - weight) + (entry & 0xFF) * weight) / (256.0F * 255.0F);
+}
+
+void update_fog_table(const u16* fog_table, const u32 fog_density) {
+    // 1.7 fixed-point mantissa, signed exponent
+    const f32 density = ((fog_density >> 8) & 0xFF) / 128.0F * std::exp2((f32)(i8)fog_density);
+
+    ctx.fog_lut_base = (int)(std::bit_cast<u32>(1.0F / density) >> FOG_LUT_SHIFT);
+
+    for (int i = 0; i < FOG_LUT_SIZE; i++) {
+        // Sample the middle of every entry
+        const u32 bits = ((u32)(ctx.fog_lut_base + i) << FOG_LUT_SHIFT) | (1 << (FOG_LUT_SHIFT - 1));
+
+        ctx.fog_lut[i] = lookup_fog_table(fog_table, density * std::bit_cast<f32>(bits));
+    }
 }
 
 void clear_buffers() {
-    ctx.color_buffer.fill(0);
-    ctx.secondary_buffer.fill(0);
-    ctx.depth_buffer.fill(0.0);
+    // Textures may have been written since the last render
+    texture_cache.clear();
+
+    for (u8& flags : ctx.row_flags) {
+        flags |= ROW_CLEAR_PENDING;
+    }
+
+    ctx.volume_mask.fill(0);
+    ctx.shadow_mask.fill(0);
+
+    translucent_volume_triangles.clear();
+    translucent_volumes.clear();
+
+    ctx.stencil_y_min = SCREEN_HEIGHT;
+    ctx.stencil_y_max = -1;
 }
 
 void submit_triangle(const Vertex* vertices) {
-    draw_triangle(vertices);
+    draw_triangle(vertices, nullptr);
+}
+
+void submit_two_volume_triangle(const Vertex* vertices, const Vertex* second_vertices) {
+    draw_triangle(vertices, second_vertices);
 }
 
 u32* get_color_buffer_ptr() {
     return ctx.color_buffer.data();
 }
 
+u32* get_display_buffer_ptr() {
+    return ctx.display_buffer.data();
+}
+
+bool get_dirty_rows(int& first_row, int& last_row) {
+    first_row = SCREEN_HEIGHT;
+    last_row = -1;
+
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        if ((ctx.row_flags[y] & ROW_DIRTY) != 0) {
+            first_row = std::min(first_row, y);
+            last_row = y;
+
+            ctx.row_flags[y] &= ~ROW_DIRTY;
+        }
+    }
+
+    return last_row >= 0;
+}
+
 // For HOLLY access
 u8* get_video_ram_ptr() {
     return ctx.video_ram.data();
@@ -12,6 +12,7 @@
 
 #include <scheduler.hpp>
 #include <hw/holly/intc.hpp>
+#include <hw/pvr/core.hpp>
 
 namespace hw::pvr::spg {
 
@@ -175,6 +176,9 @@ static void hblank(const int) {
     VCOUNTER++;
 
     if (VCOUNTER == SPG_VBLANK_INT.in_position) {
+        // Show the frame that was just displayed before the guest can flip buffers
+        core::scan_out();
+
         hw::holly::intc::assert_normal_interrupt(VBLANK_IN_INTERRUPT);
     } else if (VCOUNTER == SPG_VBLANK_INT.out_position) {
         hw::holly::intc::assert_normal_interrupt(VBLANK_OUT_INTERRUPT);
@@ -208,6 +212,14 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 u32 get_status() {
     return SPG_STATUS.raw;
 }
@@ -10,8 +10,11 @@
 #include <cstdlib>
 #include <cstring>
 
+#include <perf.hpp>
 #include <scheduler.hpp>
+#include <trace.hpp>
 #include <hw/holly/intc.hpp>
+#include <hw/pvr/capture.hpp>
 #include <hw/pvr/core.hpp>
 #include <hw/pvr/pvr.hpp>
 
@@ -27,6 +30,16 @@ constexpr bool SILENT_TA = true;
 #define TA_OL_BASE        ctx.object_list_base
 #define TA_OL_LIMIT       ctx.object_list_limit
 #define TA_NEXT_OPB_INIT  ctx.next_object_pointer_block
+#define TA_YUV_TEX_BASE   ctx.yuv.texture_base
+#define TA_YUV_TEX_CTRL   ctx.yuv.texture_control
+#define TA_YUV_TEX_CNT    ctx.yuv.texture_count
+
+constexpr u32 FIFO_BLOCK_SIZE = 32;
+
+// YUV420 and YUV422 macroblocks, 16x16 pixels
+constexpr u32 MACROBLOCK_SIZE = 16;
+constexpr u32 YUV420_MACROBLOCK_BYTES = 384;
+constexpr u32 YUV422_MACROBLOCK_BYTES = 512;
 
 union ParameterControlWord {
     u32 raw;
@@ -54,11 +67,20 @@ struct {
     TspInstruction current_tsp_instr;
     TextureControlWord current_texture_control;
 
-    u32 intensity_colors[4];
+    // Parameters used inside modifier volumes by two-volume polygons
+    TspInstruction current_second_tsp_instr;
+    TextureControlWord current_second_texture_control;
+
+    u32 intensity_colors[4], second_intensity_colors[4];
 
+    bool has_display_list;
     bool has_list_type;
     bool is_first_vertex;
 
+    // Modifier volume vertices and some two-volume parameters span two blocks
+    bool has_first_block;
+    u32 first_block[8];
+
     union {
         u32 raw;
 
@@ -95,6 +117,33 @@ struct {
     u32 object_list_limit;
     u32 next_object_pointer_block;
     u32 itp_current_address;
+
+    struct {
+        u32 texture_base;
+
+        union {
+            u32 raw;
+
+            struct {
+                u32 u_size               : 6;
+                u32                      : 2;
+                u32 v_size               : 6;
+                u32                      : 2;
+                u32 is_multiple_textures : 1;
+                u32                      : 7;
+                u32 is_yuv422            : 1;
+                u32                      : 7;
+            };
+        } texture_control;
+
+        // Converted macroblocks since TA_YUV_TEX_BASE was written
+        u32 texture_count;
+
+        // Macroblock being received and the position it is converted to
+        u8 macroblock[YUV422_MACROBLOCK_BYTES];
+        u32 macroblock_bytes;
+        u32 macroblock_x, macroblock_y;
+    } yuv;
 } ctx;
 
 void initialize() {}
@@ -105,10 +154,26 @@ void reset() {
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    writer.write(ctx);
+}
+
+void load_state(common::StateReader& reader) {
+    reader.read(ctx);
+}
+
 u32 get_itp_current_address() {
     return TA_ITP_CURRENT;
 }
 
+u32 get_allocation_control() {
+    return TA_ALLOC_CTRL.raw;
+}
+
+u32 get_global_tile_clip() {
+    return TA_GLOB_TILE_CLIP.raw;
+}
+
 void set_allocation_control(const u32 data) {
     TA_ALLOC_CTRL.raw = data;
 }
@@ -138,21 +203,45 @@ void set_object_list_limit(const u32 data) {
     TA_OL_LIMIT = data;
 }
 
+u32 get_yuv_texture_base() {
+    return TA_YUV_TEX_BASE;
+}
+
+u32 get_yuv_texture_control() {
+    return TA_YUV_TEX_CTRL.raw;
+}
+
+u32 get_yuv_texture_count() {
+    return TA_YUV_TEX_CNT;
+}
+
+void set_yuv_texture_base(const u32 data) {
+    TA_YUV_TEX_BASE = data & 0xFFFFF8;
+
+    // Restarts the converter
+    TA_YUV_TEX_CNT = 0;
+
+    ctx.yuv.macroblock_bytes = 0;
+    ctx.yuv.macroblock_x = 0;
+    ctx.yuv.macroblock_y = 0;
+}
+
+void set_yuv_texture_control(const u32 data) {
+    TA_YUV_TEX_CTRL.raw = data;
+}
+
 void initialize_lists() {
     // TODO: initialize TA lists
+    ctx.has_display_list = false;
     ctx.has_list_type = false;
     ctx.is_first_vertex = true;
-}
+    ctx.has_first_block = false;
 
-enum {
-    LIST_TYPE_OPAQUE               = 0,
-    LIST_TYPE_OPAQUE_MODIFIER      = 1,
-    LIST_TYPE_TRANSLUCENT          = 2,
-    LIST_TYPE_TRANSLUCENT_MODIFIER = 3,
-    LIST_TYPE_PUNCHTHROUGH         = 4,
-};
+    capture::begin_ta_stream();
+}
 
 enum {
+    INTERRUPT_YUV                       =  6,
     INTERRUPT_OPAQUE_LIST               =  7,
     INTERRUPT_OPAQUE_MODIFIER_LIST      =  8,
     INTERRUPT_TRANSLUCENT_LIST          =  9,
@@ -173,6 +262,8 @@ constexpr i64 TA_DELAY = 0x1000;
 static void finish_list(const int list_type) {
     assert(ctx.has_list_type);
 
+    trace::guest_instant(trace::TRACK_TA, "TA_LIST_END", list_type);
+
     scheduler::schedule_event(
         "TA_LIST_END",
         send_interrupt,
@@ -199,13 +290,322 @@ enum {
     PARAM_TYPE_VERTEX         = 7,
 };
 
+// PCW volume bits
+enum {
+    VOLUME_TYPE_TWO_VOLUMES = 1 << 0,
+    VOLUME_TYPE_SHADOW      = 1 << 1,
+};
+
 enum {
     COLOR_TYPE_PACKED,
     COLOR_TYPE_FLOAT,
     COLOR_TYPE_INTENSITY_1,
 };
 
-void fifo_block_write(const u8 *bytes) {
+static bool is_modifier_list(const u32 list_type) {
+    return (list_type == LIST_TYPE_OPAQUE_MODIFIER) || (list_type == LIST_TYPE_TRANSLUCENT_MODIFIER);
+}
+
+static bool is_two_volume(const ParameterControlWord parameter_control) {
+    return (parameter_control.volume_type & VOLUME_TYPE_TWO_VOLUMES) != 0;
+}
+
+// Two-volume intensity globals carry both face colors in a second block
+static bool is_long_global_parameter(const ParameterControlWord parameter_control) {
+    return is_two_volume(parameter_control) && (parameter_control.color_type == COLOR_TYPE_INTENSITY_1);
+}
+
+// Modifier volume vertices and textured two-volume vertices take two blocks
+static bool is_long_vertex_parameter() {
+    const ParameterControlWord global_parameter = ctx.current_global_parameter;
+
+    if (is_modifier_list(global_parameter.list_type)) {
+        return true;
+    }
+
+    return is_two_volume(global_parameter) && global_parameter.use_texture_mapping;
+}
+
+static Vertex get_volume_vertex(const u32 x, const u32 y, const u32 z) {
+    Vertex vertex{};
+
+    vertex.x = to_f32(x);
+    vertex.y = to_f32(y);
+    vertex.z = to_f32(z);
+
+    return vertex;
+}
+
+static void push_volume_triangle(const u32* first_block, const u32* second_block) {
+    const Vertex vertices[3] = {
+        get_volume_vertex(first_block[1], first_block[2], first_block[3]),
+        get_volume_vertex(first_block[4], first_block[5], first_block[6]),
+        get_volume_vertex(first_block[7], second_block[0], second_block[1]),
+    };
+
+    core::push_volume_triangle(ctx.current_global_parameter.list_type, ctx.current_isp_instr, vertices);
+}
+
+// Writes a macroblock as YUV422 texels (U, Y0, V, Y1), one 32-byte row at a time
+static void convert_macroblock() {
+    const u8* macroblock = ctx.yuv.macroblock;
+
+    const bool is_yuv422 = TA_YUV_TEX_CTRL.is_yuv422;
+
+    // U and V planes are 8 samples wide, followed by four 8x8 Y blocks
+    const u32 chroma_plane_size = is_yuv422 ? 128 : 64;
+
+    const u8* luma = &macroblock[2 * chroma_plane_size];
+
+    const u32 width = MACROBLOCK_SIZE * (TA_YUV_TEX_CTRL.u_size + 1);
+
+    for (u32 y = 0; y < MACROBLOCK_SIZE; y++) {
+        const u8* u_row = &macroblock[8 * (is_yuv422 ? y : (y / 2))];
+        const u8* v_row = &u_row[chroma_plane_size];
+
+        // Left and right Y blocks of this row
+        const u8* y_row = &luma[64 * (2 * (y / 8)) + 8 * (y % 8)];
+
+        u32 texels[MACROBLOCK_SIZE / 2];
+
+        for (u32 x = 0; x < (MACROBLOCK_SIZE / 2); x++) {
+            const u32 luma_offset = 64 * (x / 4) + 2 * (x % 4);
+
+            texels[x] = u_row[x] | (y_row[luma_offset] << 8) | (v_row[x] << 16) | (y_row[luma_offset + 1] << 24);
+        }
+
+        u32 addr = TA_YUV_TEX_BASE;
+
+        if (TA_YUV_TEX_CTRL.is_multiple_textures) {
+            // Every macroblock is a separate 16x16 texture
+            addr += sizeof(texels) * (MACROBLOCK_SIZE * TA_YUV_TEX_CNT + y);
+        } else {
+            addr += sizeof(u16) * (width * (MACROBLOCK_SIZE * ctx.yuv.macroblock_y + y) + MACROBLOCK_SIZE * ctx.yuv.macroblock_x);
+        }
+
+        write_vram_interleaved_bytes(addr, (const u8*)texels, sizeof(texels));
+    }
+
+    TA_YUV_TEX_CNT++;
+
+    if (++ctx.yuv.macroblock_x > TA_YUV_TEX_CTRL.u_size) {
+        ctx.yuv.macroblock_x = 0;
+
+        if (++ctx.yuv.macroblock_y > TA_YUV_TEX_CTRL.v_size) {
+            ctx.yuv.macroblock_y = 0;
+
+            trace::guest_instant(trace::TRACK_TA, "YUV_END", TA_YUV_TEX_CNT);
+
+            scheduler::schedule_event(
+                "YUV_END",
+                hw::holly::intc::assert_normal_interrupt,
+                INTERRUPT_YUV,
+                scheduler::to_scheduler_cycles<scheduler::HOLLY_CLOCKRATE>(TA_DELAY)
+            );
+        }
+    }
+}
+
+void yuv_block_write(const u8* bytes) {
+    std::memcpy(&ctx.yuv.macroblock[ctx.yuv.macroblock_bytes], bytes, FIFO_BLOCK_SIZE);
+
+    ctx.yuv.macroblock_bytes += FIFO_BLOCK_SIZE;
+
+    const u32 macroblock_size = TA_YUV_TEX_CTRL.is_yuv422 ? YUV422_MACROBLOCK_BYTES : YUV420_MACROBLOCK_BYTES;
+
+    if (ctx.yuv.macroblock_bytes >= macroblock_size) {
+        convert_macroblock();
+
+        ctx.yuv.macroblock_bytes = 0;
+    }
+}
+
+static void set_global_parameter(const u32* first_block, const u32* second_block) {
+    if constexpr (!SILENT_TA) std::puts("TA Global parameter (polygon)");
+
+    ctx.current_global_parameter = ParameterControlWord{.raw = first_block[0]};
+
+    ctx.current_isp_instr = IspInstruction{.raw = first_block[1]};
+    ctx.current_tsp_instr = TspInstruction{.raw = first_block[2]};
+    ctx.current_texture_control = TextureControlWord{.raw = first_block[3]};
+
+    ctx.current_isp_instr.regular.short_uv = ctx.current_global_parameter.use_short_texture_coordinates;
+    ctx.current_isp_instr.regular.use_gouraud_shading = ctx.current_global_parameter.use_gouraud_shading;
+    ctx.current_isp_instr.regular.use_texture_mapping = ctx.current_global_parameter.use_texture_mapping;
+    ctx.current_isp_instr.regular.use_offset_color = ctx.current_global_parameter.use_bump_mapping;
+
+    if (is_two_volume(ctx.current_global_parameter)) {
+        ctx.current_second_tsp_instr = TspInstruction{.raw = first_block[4]};
+        ctx.current_second_texture_control = TextureControlWord{.raw = first_block[5]};
+
+        if (second_block != nullptr) {
+            std::memcpy(ctx.intensity_colors, &second_block[0], sizeof(ctx.intensity_colors));
+            std::memcpy(ctx.second_intensity_colors, &second_block[4], sizeof(ctx.second_intensity_colors));
+        }
+    } else {
+        std::memcpy(ctx.intensity_colors, &first_block[4], sizeof(ctx.intensity_colors));
+    }
+
+    if constexpr (!SILENT_TA) {
+        std::printf("ISP instruction = %08X\n", ctx.current_isp_instr.raw);
+        std::printf("TSP instruction = %08X\n", ctx.current_tsp_instr.raw);
+        std::printf("Texture control = %08X\n", ctx.current_texture_control.raw);
+    }
+
+    // Offset colors are only parsed from packed vertices
+    assert(!ctx.current_global_parameter.use_bump_mapping || (ctx.current_global_parameter.color_type == COLOR_TYPE_PACKED));
+
+    if (!ctx.has_list_type) {
+        // All lists between TA_LIST_INIT and STARTRENDER share a display list
+        if (!ctx.has_display_list) {
+            core::begin_display_list();
+
+            ctx.has_display_list = true;
+        }
+
+        switch (ctx.current_global_parameter.list_type) {
+            case LIST_TYPE_OPAQUE:
+                if constexpr (!SILENT_TA) std::puts("TA Opaque list");
+                break;
+            case LIST_TYPE_OPAQUE_MODIFIER:
+                if constexpr (!SILENT_TA) std::puts("TA Opaque Modifier list");
+                break;
+            case LIST_TYPE_TRANSLUCENT:
+                if constexpr (!SILENT_TA) std::puts("TA Translucent list");
+                break;
+            case LIST_TYPE_TRANSLUCENT_MODIFIER:
+                if constexpr (!SILENT_TA) std::puts("TA Translucent Modifier list");
+                break;
+            case LIST_TYPE_PUNCHTHROUGH:
+                if constexpr (!SILENT_TA) std::puts("TA Punchthrough list");
+                break;
+            default:
+                printf("Unimplemented TA list type %u\n", ctx.current_global_parameter.list_type);
+                exit(1);
+        }
+
+        ctx.has_list_type = true;
+    }
+}
+
+// Two-volume vertices hold packed colors, or intensities that take the face colors.
+// Textured ones have the second UVs and colors in the second block
+static pvr::Vertex get_second_vertex(const pvr::Vertex& vertex, const u32* first_block, const u32* second_block) {
+    pvr::Vertex second_vertex = vertex;
+
+    second_vertex.offset_color = Color{};
+
+    const bool is_packed = ctx.current_global_parameter.color_type == COLOR_TYPE_PACKED;
+
+    if (second_block == nullptr) {
+        second_vertex.color = is_packed ? Color{.raw = first_block[5]} : from_floats(ctx.second_intensity_colors);
+
+        return second_vertex;
+    }
+
+    second_vertex.u = to_f32(second_block[0]);
+    second_vertex.v = to_f32(second_block[1]);
+    second_vertex.color = is_packed ? Color{.raw = second_block[2]} : from_floats(ctx.second_intensity_colors);
+
+    if (is_packed && ctx.current_isp_instr.regular.use_offset_color) {
+        second_vertex.offset_color.raw = second_block[3];
+    }
+
+    return second_vertex;
+}
+
+static void push_vertex(const u32* first_block, const u32* second_block) {
+    const ParameterControlWord parameter_control{.raw = first_block[0]};
+
+    const bool is_two_volume_vertex = is_two_volume(ctx.current_global_parameter);
+
+    if (ctx.is_first_vertex) {
+        if (is_two_volume_vertex) {
+            core::begin_two_volume_strip(
+                ctx.current_isp_instr,
+                ctx.current_tsp_instr,
+                ctx.current_texture_control,
+                ctx.current_second_tsp_instr,
+                ctx.current_second_texture_control
+            );
+        } else {
+            core::begin_vertex_strip(
+                ctx.current_isp_instr,
+                ctx.current_tsp_instr,
+                ctx.current_texture_control
+            );
+        }
+
+        ctx.is_first_vertex = false;
+    }
+
+    Color color, offset_color{};
+
+    switch (ctx.current_global_parameter.color_type) {
+        case COLOR_TYPE_PACKED:
+            // Untextured two-volume vertices have both colors where the UVs would be
+            color.raw = (is_two_volume_vertex && !ctx.current_isp_instr.regular.use_texture_mapping) ? first_block[4] : first_block[6];
+
+            if (ctx.current_isp_instr.regular.use_texture_mapping && ctx.current_isp_instr.regular.use_offset_color) {
+                offset_color.raw = first_block[7];
+            }
+            break;
+        case COLOR_TYPE_FLOAT:
+            color = from_floats(&first_block[4]);
+            break;
+        case COLOR_TYPE_INTENSITY_1:
+            color = from_floats(ctx.intensity_colors);
+            break;
+        default:
+            std::printf("PVR Unimplemented color type %u\n", ctx.current_global_parameter.color_type);
+            exit(1);
+    }
+
+    // FIXME: this only works for a small number of vertex configs
+    const pvr::Vertex vertex{
+        to_f32(first_block[1]),
+        to_f32(first_block[2]),
+        to_f32(first_block[3]),
+        to_f32(first_block[4]),
+        to_f32(first_block[5]),
+        color,
+        offset_color
+    };
+
+    if (is_two_volume_vertex) {
+        core::push_two_volume_vertex(vertex, get_second_vertex(vertex, first_block, second_block));
+    } else {
+        core::push_vertex(vertex);
+    }
+
+    if (parameter_control.end_of_strip) {
+        core::end_vertex_strip(
+            ctx.current_global_parameter.list_type,
+            (ctx.current_global_parameter.volume_type & VOLUME_TYPE_SHADOW) != 0
+        );
+
+        ctx.is_first_vertex = true;
+    }
+}
+
+// Completes a parameter whose first block was kept
+static void parse_second_block(const u32* fifo_bytes) {
+    const ParameterControlWord parameter_control{.raw = ctx.first_block[0]};
+
+    ctx.has_first_block = false;
+
+    if (parameter_control.parameter_type == PARAM_TYPE_GLOBAL_POLYGON) {
+        set_global_parameter(ctx.first_block, fifo_bytes);
+    } else if (is_modifier_list(ctx.current_global_parameter.list_type)) {
+        push_volume_triangle(ctx.first_block, fifo_bytes);
+    } else {
+        push_vertex(ctx.first_block, fifo_bytes);
+    }
+}
+
+static void parse_block(const u8* bytes) {
+    capture::record_ta_block(bytes);
+
     u32 fifo_bytes[8];
 
     std::memcpy(fifo_bytes, bytes, sizeof(fifo_bytes));
@@ -216,8 +616,26 @@ void fifo_block_write(const u8 *bytes) {
         }
     }
 
+    if (ctx.has_first_block) {
+        parse_second_block(fifo_bytes);
+
+        return;
+    }
+
     const ParameterControlWord parameter_control{.raw = fifo_bytes[0]};
 
+    const bool is_long_parameter = (parameter_control.parameter_type == PARAM_TYPE_GLOBAL_POLYGON)
+        ? is_long_global_parameter(parameter_control)
+        : ((parameter_control.parameter_type == PARAM_TYPE_VERTEX) && is_long_vertex_parameter());
+
+    if (is_long_parameter) {
+        std::memcpy(ctx.first_block, fifo_bytes, sizeof(fifo_bytes));
+
+        ctx.has_first_block = true;
+
+        return;
+    }
+
     switch (parameter_control.parameter_type) {
         case PARAM_TYPE_END_OF_LIST:
             if constexpr (!SILENT_TA) std::puts("TA End of list");
@@ -225,110 +643,38 @@ void fifo_block_write(const u8 *bytes) {
             finish_list(ctx.current_global_parameter.list_type);
             break;
         case PARAM_TYPE_GLOBAL_POLYGON:
-            if constexpr (!SILENT_TA) std::puts("TA Global parameter (polygon)");
-
-            ctx.current_global_parameter = parameter_control;
+            set_global_parameter(fifo_bytes, nullptr);
+            break;
+        case PARAM_TYPE_VERTEX:
+            push_vertex(fifo_bytes, nullptr);
+            break;
+        default:
+            printf("Unimplemented TA parameter type %u\n", parameter_control.parameter_type);
+            exit(1);
+    }
+}
 
-            ctx.current_isp_instr = IspInstruction{.raw = fifo_bytes[1]};
-            ctx.current_tsp_instr = TspInstruction{.raw = fifo_bytes[2]};
-            ctx.current_texture_control = TextureControlWord{.raw = fifo_bytes[3]};
+void fifo_block_write(const u8* bytes) {
+    perf::ScopedTimer timer(perf::SCOPE_TA);
 
-            ctx.current_isp_instr.regular.short_uv = ctx.current_global_parameter.use_short_texture_coordinates;
-            ctx.current_isp_instr.regular.use_gouraud_shading = ctx.current_global_parameter.use_gouraud_shading;
-            ctx.current_isp_instr.regular.use_texture_mapping = ctx.current_global_parameter.use_texture_mapping;
-            ctx.current_isp_instr.regular.use_offset_color = ctx.current_global_parameter.use_bump_mapping;
+    perf::add(perf::COUNTER_TA_BLOCKS, 1);
 
-            std::memcpy(ctx.intensity_colors, &fifo_bytes[4], sizeof(ctx.intensity_colors));
-            
-            if constexpr (!SILENT_TA) {
-                std::printf("ISP instruction = %08X\n", ctx.current_isp_instr.raw);
-                std::printf("TSP instruction = %08X\n", ctx.current_tsp_instr.raw);
-                std::printf("Texture control = %08X\n", ctx.current_texture_control.raw);   
-            }
+    parse_block(bytes);
+}
 
-            assert(!ctx.current_global_parameter.use_bump_mapping);
-            assert(ctx.current_global_parameter.volume_type == 0);
-
-            if (!ctx.has_list_type) {
-                switch (ctx.current_global_parameter.list_type) {
-                    case LIST_TYPE_OPAQUE:
-                        if constexpr (!SILENT_TA) std::puts("TA Opaque list");
-
-                        core::begin_display_list();
-                        break;
-                    case LIST_TYPE_OPAQUE_MODIFIER:
-                        if constexpr (!SILENT_TA) std::puts("TA Opaque Modifier list");
-                        break;
-                    case LIST_TYPE_TRANSLUCENT:
-                        if constexpr (!SILENT_TA) std::puts("TA Translucent list");
-                        break;
-                    case LIST_TYPE_TRANSLUCENT_MODIFIER:
-                        if constexpr (!SILENT_TA) std::puts("TA Translucent Modifier list");
-                        break;
-                    case LIST_TYPE_PUNCHTHROUGH:
-                        if constexpr (!SILENT_TA) std::puts("TA Punchthrough list");
-                        break;
-                    default:
-                        printf("Unimplemented TA list type %u\n", ctx.current_global_parameter.list_type);
-                        exit(1);
-                }
-
-                ctx.has_list_type = true;
-            }
-            break;
-        case PARAM_TYPE_VERTEX:
-            if (ctx.is_first_vertex) {
-                core::begin_vertex_strip(
-                    ctx.current_isp_instr,
-                    ctx.current_tsp_instr,
-                    ctx.current_texture_control
-                );
-
-                ctx.is_first_vertex = false;
-            }
+void fifo_write(const u8* bytes, const u32 size) {
+    perf::ScopedTimer timer(perf::SCOPE_TA);
 
-            {
-                Color color;
-
-                switch (ctx.current_global_parameter.color_type) {
-                    case COLOR_TYPE_PACKED:
-                        color.raw = fifo_bytes[6];
-                        break;
-                    case COLOR_TYPE_FLOAT:
-                        color = from_floats(&fifo_bytes[4]);
-                        break;
-                    case COLOR_TYPE_INTENSITY_1:
-                        color = from_floats(ctx.intensity_colors);
-                        break;
-                    default:
-                        std::printf("PVR Unimplemented color type %u\n", ctx.current_global_parameter.color_type);
-                        exit(1);
-                }
-
-                // FIXME: this only works for a small number of vertex configs
-                core::push_vertex(
-                    pvr::Vertex {
-                        to_f32(fifo_bytes[1]),
-                        to_f32(fifo_bytes[2]),
-                        to_f32(fifo_bytes[3]),
-                        to_f32(fifo_bytes[4]),
-                        to_f32(fifo_bytes[5]),
-                        color
-                    }
-                );
-            }
+    perf::add(perf::COUNTER_TA_BLOCKS, size / FIFO_BLOCK_SIZE);
 
-            if (parameter_control.end_of_strip) {
-                core::end_vertex_strip(
-                    ctx.current_global_parameter.list_type >= LIST_TYPE_TRANSLUCENT
-                );
+    for (u32 i = 0; i < size; i += FIFO_BLOCK_SIZE) {
+        parse_block(&bytes[i]);
+    }
+}
 
-                ctx.is_first_vertex = true;
-            }
-            break;
-        default:
-            printf("Unimplemented TA parameter type %u\n", parameter_control.parameter_type);
-            exit(1);
+void yuv_write(const u8* bytes, const u32 size) {
+    for (u32 i = 0; i < size; i += FIFO_BLOCK_SIZE) {
+        yuv_block_write(&bytes[i]);
     }
 }
 
@@ -0,0 +1,171 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <movie.hpp>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <scheduler.hpp>
+#include <common/file.hpp>
+
+namespace movie {
+
+constexpr u32 MOVIE_MAGIC = 0x564D4A4E; // "NJMV"
+constexpr u32 MOVIE_VERSION = 1;
+
+struct Header {
+    u32 magic;
+    u32 version;
+    u64 num_polls;
+};
+
+// One controller poll, keyed by when the guest asked for it
+struct Poll {
+    u64 frame;
+    i64 timestamp;
+    u16 button_state;
+    u16 reserved[3];
+};
+
+static_assert(sizeof(Poll) == 24);
+
+enum class Mode {
+    Off,
+    Recording,
+    Replaying,
+};
+
+struct {
+    Mode mode;
+
+    const char* path;
+
+    std::vector<Poll> polls;
+    usize poll_idx;
+
+    bool has_desynced;
+} ctx;
+
+void start_recording(const char* path) {
+    assert(ctx.mode == Mode::Off);
+
+    ctx.mode = Mode::Recording;
+    ctx.path = path;
+
+    ctx.polls.clear();
+}
+
+void start_replay(const char* path) {
+    assert(ctx.mode == Mode::Off);
+
+    const std::vector<u8> movie_bytes = common::load_file(path);
+
+    Header header;
+
+    if (movie_bytes.size() < sizeof(header)) {
+        std::printf("Movie \"%s\" is truncated\n", path);
+        exit(1);
+    }
+
+    std::memcpy(&header, movie_bytes.data(), sizeof(header));
+
+    if ((header.magic != MOVIE_MAGIC) || (header.version != MOVIE_VERSION)) {
+        std::printf("Movie \"%s\" has an invalid header (magic = %08X, version = %u)\n", path, header.magic, header.version);
+        exit(1);
+    }
+
+    if (movie_bytes.size() != (sizeof(header) + sizeof(Poll) * header.num_polls)) {
+        std::printf("Movie \"%s\" is truncated\n", path);
+        exit(1);
+    }
+
+    ctx.polls.resize(header.num_polls);
+
+    std::memcpy(ctx.polls.data(), &movie_bytes[sizeof(header)], sizeof(Poll) * header.num_polls);
+
+    ctx.mode = Mode::Replaying;
+    ctx.path = path;
+    ctx.poll_idx = 0;
+    ctx.has_desynced = false;
+}
+
+void shutdown() {
+    if (ctx.mode == Mode::Recording) {
+        FILE* file = std::fopen(ctx.path, "wb");
+
+        if (file == nullptr) {
+            std::printf("Failed to open file \"%s\"\n", ctx.path);
+            exit(1);
+        }
+
+        const Header header{.magic = MOVIE_MAGIC, .version = MOVIE_VERSION, .num_polls = ctx.polls.size()};
+
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fwrite(ctx.polls.data(), sizeof(Poll), ctx.polls.size(), file);
+        std::fclose(file);
+
+        std::printf("Recorded %zu polls to \"%s\"\n", ctx.polls.size(), ctx.path);
+    }
+
+    ctx.mode = Mode::Off;
+
+    std::vector<Poll> temp;
+    ctx.polls.swap(temp);
+}
+
+bool is_recording() {
+    return ctx.mode == Mode::Recording;
+}
+
+bool is_replaying() {
+    return ctx.mode == Mode::Replaying;
+}
+
+bool is_finished() {
+    return (ctx.mode == Mode::Replaying) && (ctx.poll_idx >= ctx.polls.size());
+}
+
+u16 poll(const u16 button_state) {
+    const u64 frame = scheduler::get_frame_count();
+    const i64 timestamp = scheduler::get_timestamp();
+
+    switch (ctx.mode) {
+        case Mode::Off:
+            return button_state;
+        case Mode::Recording:
+            ctx.polls.push_back(Poll{.frame = frame, .timestamp = timestamp, .button_state = button_state, .reserved = {}});
+
+            return button_state;
+        case Mode::Replaying:
+            break;
+    }
+
+    if (ctx.poll_idx >= ctx.polls.size()) {
+        // Movie is over, hand control back to the player
+        return button_state;
+    }
+
+    const Poll& poll = ctx.polls[ctx.poll_idx++];
+
+    if (!ctx.has_desynced && ((poll.frame != frame) || (poll.timestamp != timestamp))) {
+        std::printf("Movie desync at poll %zu (expected frame %llu @ %lld, got frame %llu @ %lld)\n",
+            ctx.poll_idx - 1,
+            poll.frame,
+            poll.timestamp,
+            frame,
+            timestamp
+        );
+
+        ctx.has_desynced = true;
+    }
+
+    return poll.button_state;
+}
+
+}
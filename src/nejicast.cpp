@@ -13,21 +13,37 @@
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
 
+#include <cassert>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
+#include <framedump.hpp>
+#include <history.hpp>
+#include <movie.hpp>
+#include <perf.hpp>
+#include <profiler.hpp>
+#include <runahead.hpp>
 #include <scheduler.hpp>
+#include <snapshot.hpp>
+#include <trace.hpp>
 #include <common/elf.hpp>
+#include <common/hash.hpp>
 #include <hw/cpu/cpu.hpp>
 #include <hw/g1/g1.hpp>
 #include <hw/g2/g2.hpp>
 #include <hw/holly/bus.hpp>
 #include <hw/holly/holly.hpp>
 #include <hw/maple/maple.hpp>
+#include <hw/pvr/capture.hpp>
 #include <hw/pvr/pvr.hpp>
 
 constexpr int NUM_ARGS = 4;
 
+// Frames between performance counter dumps
+constexpr int STATS_DUMP_INTERVAL = 60;
+
 namespace nejicast {
 
 // All pressed
@@ -82,7 +98,7 @@ static void release_button(const SDL_Keycode keycode) {
 }
 
 u16 get_button_state() {
-    return BUTTON_STATE;
+    return movie::poll(BUTTON_STATE);
 }
 
 void initialize(const common::Config& config) {
@@ -120,6 +136,30 @@ void reset() {
     hw::pvr::reset();
 }
 
+void save_state(common::StateWriter& writer) {
+    scheduler::save_state(writer);
+
+    hw::cpu::save_state(writer);
+    hw::g1::save_state(writer);
+    hw::g2::save_state(writer);
+    hw::holly::save_state(writer);
+    hw::maple::save_state(writer);
+    hw::pvr::save_state(writer);
+}
+
+void load_state(common::StateReader& reader) {
+    scheduler::load_state(reader);
+
+    hw::cpu::load_state(reader);
+    hw::g1::load_state(reader);
+    hw::g2::load_state(reader);
+    hw::holly::load_state(reader);
+    hw::maple::load_state(reader);
+    hw::pvr::load_state(reader);
+
+    assert(reader.is_done());
+}
+
 void sideload(const u32 entry) {
     hw::holly::bus::setup_for_sideload();
     hw::cpu::setup_for_sideload(entry);
@@ -136,14 +176,289 @@ static struct {
     SDL_Texture* texture;
 } screen;
 
+static struct {
+    common::Config config;
+
+    bool is_rewinding;
+    bool show_stats_overlay;
+
+    std::chrono::steady_clock::time_point start_time;
+} frontend;
+
+// Parses optional arguments following the positional ones
+static bool parse_options(common::Config& config, const int argc, char** argv) {
+    for (int i = NUM_ARGS; i < argc; i++) {
+        if (std::strcmp(argv[i], "--rewind") == 0) {
+            config.rewind_bytes = history::DEFAULT_MAX_BYTES;
+        } else if ((std::strcmp(argv[i], "--rewind-mb") == 0) && ((i + 1) < argc)) {
+            config.rewind_bytes = (usize)std::strtoull(argv[++i], nullptr, 0) << 20;
+        } else if ((std::strcmp(argv[i], "--run-ahead") == 0) && ((i + 1) < argc)) {
+            config.run_ahead_frames = std::atoi(argv[++i]);
+
+            if ((config.run_ahead_frames < 0) || (config.run_ahead_frames > runahead::MAX_FRAMES)) {
+                std::printf("Run-ahead frame count must be between 0 and %d\n", runahead::MAX_FRAMES);
+
+                return false;
+            }
+        } else if ((std::strcmp(argv[i], "--record") == 0) && ((i + 1) < argc)) {
+            config.record_path = argv[++i];
+        } else if ((std::strcmp(argv[i], "--replay") == 0) && ((i + 1) < argc)) {
+            config.replay_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--headless") == 0) {
+            config.is_headless = true;
+        } else if ((std::strcmp(argv[i], "--frames") == 0) && ((i + 1) < argc)) {
+            config.max_frames = std::strtoull(argv[++i], nullptr, 0);
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            config.enable_stats = true;
+        } else if ((std::strcmp(argv[i], "--stats-json") == 0) && ((i + 1) < argc)) {
+            config.enable_stats = true;
+            config.stats_json_path = argv[++i];
+        } else if ((std::strcmp(argv[i], "--trace") == 0) && ((i + 1) < argc)) {
+            config.trace_path = argv[++i];
+        } else if ((std::strcmp(argv[i], "--profile") == 0) && ((i + 1) < argc)) {
+            config.profile_path = argv[++i];
+        } else if ((std::strcmp(argv[i], "--profile-interval") == 0) && ((i + 1) < argc)) {
+            config.profile_interval = std::strtoll(argv[++i], nullptr, 0);
+
+            if (config.profile_interval <= 0) {
+                std::puts("Profiler interval must be positive");
+
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--profile-blocks") == 0) {
+            config.profile_blocks = true;
+        } else if (std::strcmp(argv[i], "--instr-histogram") == 0) {
+            config.enable_instr_histogram = true;
+        } else if ((std::strcmp(argv[i], "--cpu-trace") == 0) && ((i + 1) < argc)) {
+            config.cpu_trace_path = argv[++i];
+        } else if ((std::strcmp(argv[i], "--cpu-trace-limit") == 0) && ((i + 1) < argc)) {
+            config.cpu_trace_limit = std::strtoull(argv[++i], nullptr, 0);
+        } else if (std::strcmp(argv[i], "--lockstep") == 0) {
+            config.enable_lockstep = true;
+        } else if ((std::strcmp(argv[i], "--pvr-capture") == 0) && ((i + 1) < argc)) {
+            config.pvr_capture_path = argv[++i];
+        } else if ((std::strcmp(argv[i], "--pvr-capture-start") == 0) && ((i + 1) < argc)) {
+            config.pvr_capture_start = std::strtoull(argv[++i], nullptr, 0);
+        } else if ((std::strcmp(argv[i], "--pvr-capture-count") == 0) && ((i + 1) < argc)) {
+            config.pvr_capture_count = std::strtoul(argv[++i], nullptr, 0);
+        } else if ((std::strcmp(argv[i], "--frame-dump") == 0) && ((i + 1) < argc)) {
+            config.frame_dump_path = argv[++i];
+        } else {
+            std::printf("Unrecognized option %s\n", argv[i]);
+
+            return false;
+        }
+    }
+
+    if (config.enable_lockstep && (config.cpu_trace_path != nullptr)) {
+        std::puts("Cannot record a CPU trace in lockstep mode");
+
+        return false;
+    }
+
+    if ((config.record_path != nullptr) && (config.replay_path != nullptr)) {
+        std::puts("Cannot record and replay a movie at the same time");
+
+        return false;
+    }
+
+    // Speculative and rewound frames would poll the controller out of order
+    const bool has_movie = (config.record_path != nullptr) || (config.replay_path != nullptr);
+
+    if (has_movie && ((config.rewind_bytes != 0) || (config.run_ahead_frames != 0))) {
+        std::puts("Movies cannot be combined with rewind or run-ahead");
+
+        return false;
+    }
+
+    // Profiler samples split time slices, which shifts both the poll timestamps and the CPU timeline
+    if (has_movie && (config.profile_path != nullptr)) {
+        std::puts("Movies cannot be combined with the profiler");
+
+        return false;
+    }
+
+    if ((config.profile_blocks || (config.profile_interval != profiler::DEFAULT_INTERVAL)) && (config.profile_path == nullptr)) {
+        std::puts("Profiler options need --profile");
+
+        return false;
+    }
+
+    if (config.is_headless && (config.replay_path == nullptr) && (config.max_frames == 0)) {
+        std::puts("Headless mode needs a movie to replay or a frame count");
+
+        return false;
+    }
+
+    return true;
+}
+
+static void draw_stats_overlay() {
+    const perf::FrameStats& stats = perf::get_frame_stats();
+
+    char line[64];
+
+    f32 y = 4.0F;
+
+    const auto draw_line = [&]() {
+        SDL_RenderDebugText(screen.renderer, 4.0F, y, line);
+
+        y += 10.0F;
+    };
+
+    SDL_SetRenderDrawColor(screen.renderer, 0xFF, 0xFF, 0x00, 0xFF);
+
+    std::snprintf(line, sizeof(line), "frame %.2f ms", stats.frame_time_ms);
+    draw_line();
+
+    for (int scope = 0; scope < perf::NUM_SCOPES; scope++) {
+        std::snprintf(line, sizeof(line), "%-10s %7.2f ms", perf::get_scope_name((perf::Scope)scope), stats.scope_time_ms[scope]);
+        draw_line();
+    }
+
+    for (int counter = 0; counter < perf::NUM_COUNTERS; counter++) {
+        std::snprintf(line, sizeof(line), "%-12s %llu", perf::get_counter_name((perf::Counter)counter), stats.counters[counter]);
+        draw_line();
+    }
+
+    SDL_SetRenderDrawColor(screen.renderer, 0x00, 0x00, 0x00, 0xFF);
+}
+
+static void present_frame() {
+    perf::ScopedTimer timer(perf::SCOPE_PRESENT);
+    trace::HostSpan span("present");
+
+    int first_row, last_row;
+
+    // The texture keeps its contents, only upload rows the video output changed
+    if (hw::pvr::get_dirty_rows(first_row, last_row)) {
+        const SDL_Rect rect{.x = 0, .y = first_row, .w = SCREEN_WIDTH, .h = last_row - first_row + 1};
+
+        void* pixels;
+        int pitch;
+
+        if (SDL_LockTexture(screen.texture, &rect, &pixels, &pitch)) {
+            const u32* display_buffer = hw::pvr::get_display_buffer_ptr();
+
+            for (int y = 0; y < rect.h; y++) {
+                std::memcpy(
+                    (u8*)pixels + pitch * y,
+                    &display_buffer[SCREEN_WIDTH * (first_row + y)],
+                    sizeof(u32) * SCREEN_WIDTH
+                );
+            }
+
+            SDL_UnlockTexture(screen.texture);
+
+            perf::add(perf::COUNTER_UPLOADED_ROWS, rect.h);
+        }
+    }
+
+    SDL_RenderClear(screen.renderer);
+    SDL_RenderTexture(screen.renderer, screen.texture, nullptr, nullptr);
+
+    if (frontend.show_stats_overlay) {
+        draw_stats_overlay();
+    }
+
+    SDL_RenderPresent(screen.renderer);
+}
+
+static bool is_run_finished() {
+    const common::Config& config = frontend.config;
+
+    if ((config.max_frames != 0) && (scheduler::get_frame_count() >= config.max_frames)) {
+        return true;
+    }
+
+    return config.is_headless && movie::is_finished();
+}
+
+static void print_run_summary() {
+    const u64 num_frames = scheduler::get_frame_count();
+
+    const auto elapsed_time = std::chrono::steady_clock::now() - frontend.start_time;
+    const f64 elapsed_seconds = std::chrono::duration<f64>(elapsed_time).count();
+
+    const u64 frame_hash = common::hash_bytes(
+        hw::pvr::get_display_buffer_ptr(),
+        sizeof(u32) * SCREEN_WIDTH * SCREEN_HEIGHT
+    );
+
+    // Guest-visible, must not depend on host settings like run-ahead
+    const u64 vram_hash = common::hash_bytes(hw::pvr::get_video_ram_ptr(), hw::pvr::VRAM_SIZE);
+
+    std::printf("Ran %llu frames in %.3f s (%.2f FPS), final frame hash = %016llX, VRAM hash = %016llX\n",
+        num_frames,
+        elapsed_seconds,
+        (f64)num_frames / elapsed_seconds,
+        frame_hash,
+        vram_hash
+    );
+}
+
 SDL_AppResult SDL_AppInit(void**, int argc, char** argv) {
     if (argc < NUM_ARGS) {
-        std::puts("Usage: nejicast [path to boot ROM] [path to FLASH ROM] [path to ELF]");
+        std::puts("Usage: nejicast [path to boot ROM] [path to FLASH ROM] [path to ELF] [options]");
+        std::puts("Options:");
+        std::puts("  --rewind            Hold Backspace to rewind");
+        std::puts("  --rewind-mb [size]  Rewind history budget in MiB");
+        std::puts("  --run-ahead [n]     Run n frames ahead to hide input latency");
+        std::puts("  --record [path]     Record controller input to a movie");
+        std::puts("  --replay [path]     Replay controller input from a movie");
+        std::puts("  --headless          Run without a window until the movie ends");
+        std::puts("  --frames [n]        Stop after n frames");
+        std::puts("  --stats             Print performance counters every second, F1 toggles the overlay");
+        std::puts("  --stats-json [path] Same as --stats, also writes them to a JSON Lines file");
+        std::puts("  --trace [path]      Write a Chrome trace of the emulation timeline on exit");
+        std::puts("  --profile [path]    Sample the guest PC and call stack, write folded stacks on exit");
+        std::puts("  --profile-interval [cycles]  Sampling interval in SH-4 cycles");
+        std::puts("  --profile-blocks    Also count executions of every branch target");
+        std::puts("  --instr-histogram   Print the most executed SH-4 handlers and opcodes on exit");
+        std::puts("  --cpu-trace [path]  Record every executed SH-4 instruction");
+        std::puts("  --cpu-trace-limit [n]  Stop the CPU trace after n instructions");
+        std::puts("  --lockstep          Cross-check every SH-4 block between two execution engines");
+        std::puts("  --pvr-capture [prefix]  Capture PVR renders for nejicast-bench-pvr");
+        std::puts("  --pvr-capture-start [frame]  First frame to capture");
+        std::puts("  --pvr-capture-count [n]  Number of renders to capture");
+        std::puts("  --frame-dump [path] Dump video output to a .png sequence, .y4m or .raw video");
+
+        return SDL_APP_FAILURE;
+    }
+
+    common::Config config {
+        .boot_path = argv[1],
+        .flash_path = argv[2],
+        .elf_path = argv[3],
+        .rewind_bytes = 0,
+        .run_ahead_frames = 0,
+        .record_path = nullptr,
+        .replay_path = nullptr,
+        .is_headless = false,
+        .max_frames = 0,
+        .enable_stats = false,
+        .stats_json_path = nullptr,
+        .trace_path = nullptr,
+        .profile_path = nullptr,
+        .profile_interval = profiler::DEFAULT_INTERVAL,
+        .profile_blocks = false,
+        .enable_instr_histogram = false,
+        .cpu_trace_path = nullptr,
+        .cpu_trace_limit = 0,
+        .enable_lockstep = false,
+        .pvr_capture_path = nullptr,
+        .pvr_capture_start = 0,
+        .pvr_capture_count = 1,
+        .frame_dump_path = nullptr
+    };
 
+    if (!parse_options(config, argc, argv)) {
         return SDL_APP_FAILURE;
     }
 
-    if (!SDL_CreateWindowAndRenderer(
+    frontend.config = config;
+
+    if (!config.is_headless && !SDL_CreateWindowAndRenderer(
             "nejicast",
             SCREEN_WIDTH,
             SCREEN_HEIGHT,
@@ -157,31 +472,75 @@ SDL_AppResult SDL_AppInit(void**, int argc, char** argv) {
         return SDL_APP_FAILURE;
     }
 
-    screen.texture = SDL_CreateTexture(
-        screen.renderer,
-        SDL_PIXELFORMAT_XRGB8888,
-        SDL_TEXTUREACCESS_STREAMING,
-        SCREEN_WIDTH,
-        SCREEN_HEIGHT
-    );
+    if (!config.is_headless) {
+        screen.texture = SDL_CreateTexture(
+            screen.renderer,
+            SDL_PIXELFORMAT_XRGB8888,
+            SDL_TEXTUREACCESS_STREAMING,
+            SCREEN_WIDTH,
+            SCREEN_HEIGHT
+        );
 
-    if (screen.texture == nullptr) {
-        SDL_Log("Failed to create texture: %s", SDL_GetError());
+        if (screen.texture == nullptr) {
+            SDL_Log("Failed to create texture: %s", SDL_GetError());
 
-        return SDL_APP_FAILURE;
-    }
+            return SDL_APP_FAILURE;
+        }
 
-    SDL_SetHint(SDL_HINT_RENDER_VSYNC, "1");
+        SDL_SetHint(SDL_HINT_RENDER_VSYNC, "1");
+    }
 
-    common::Config config {
-        .boot_path = argv[1],
-        .flash_path = argv[2],
-        .elf_path = argv[3]
-    };
-    
     nejicast::reset();
     nejicast::initialize(config);
 
+    if (config.rewind_bytes != 0) {
+        history::initialize(config.rewind_bytes);
+    }
+
+    if (config.run_ahead_frames != 0) {
+        runahead::initialize(config.run_ahead_frames);
+    }
+
+    if (config.record_path != nullptr) {
+        movie::start_recording(config.record_path);
+    } else if (config.replay_path != nullptr) {
+        movie::start_replay(config.replay_path);
+    }
+
+    if (config.enable_stats) {
+        perf::initialize(STATS_DUMP_INTERVAL, config.stats_json_path);
+    }
+
+    if (config.trace_path != nullptr) {
+        trace::initialize(config.trace_path);
+    }
+
+    if (config.enable_instr_histogram) {
+        hw::cpu::set_instr_histogram_enabled(true);
+    }
+
+    if (config.cpu_trace_path != nullptr) {
+        hw::cpu::start_trace(config.cpu_trace_path, config.cpu_trace_limit);
+    }
+
+    if (config.enable_lockstep) {
+        hw::cpu::enable_lockstep(hw::cpu::ENGINE_INTERPRETER, hw::cpu::ENGINE_INTERPRETER);
+    }
+
+    if (config.pvr_capture_path != nullptr) {
+        hw::pvr::capture::initialize(config.pvr_capture_path, config.pvr_capture_start, config.pvr_capture_count);
+    }
+
+    if (config.frame_dump_path != nullptr) {
+        framedump::initialize(config.frame_dump_path);
+    }
+
+    if (config.profile_path != nullptr) {
+        profiler::initialize(config.elf_path, config.profile_path, config.profile_interval, config.profile_blocks);
+    }
+
+    frontend.start_time = std::chrono::steady_clock::now();
+
     return SDL_APP_CONTINUE;
 }
 
@@ -190,9 +549,19 @@ SDL_AppResult SDL_AppEvent(void*, SDL_Event* event) {
         case SDL_EVENT_QUIT:
             return SDL_APP_SUCCESS;
         case SDL_EVENT_KEY_DOWN:
+            if (event->key.key == SDLK_BACKSPACE) {
+                frontend.is_rewinding = true;
+            } else if ((event->key.key == SDLK_F1) && perf::is_enabled()) {
+                frontend.show_stats_overlay = !frontend.show_stats_overlay;
+            }
+
             nejicast::press_button(event->key.key);
             break;
         case SDL_EVENT_KEY_UP:
+            if (event->key.key == SDLK_BACKSPACE) {
+                frontend.is_rewinding = false;
+            }
+
             nejicast::release_button(event->key.key);
             break;
     }
@@ -201,21 +570,92 @@ SDL_AppResult SDL_AppEvent(void*, SDL_Event* event) {
 }
 
 SDL_AppResult SDL_AppIterate(void*) {
-    // Run emulator for a frame
-    while (scheduler::run()) {}
+    trace::HostSpan span("frame");
 
-    SDL_UpdateTexture(screen.texture, nullptr, hw::pvr::get_color_buffer_ptr(), sizeof(u32) * SCREEN_WIDTH);
-    SDL_RenderClear(screen.renderer);
-    SDL_RenderTexture(screen.renderer, screen.texture, nullptr, nullptr);
-    SDL_RenderPresent(screen.renderer);
+    if (frontend.is_rewinding && history::is_enabled()) {
+        trace::HostSpan step_back_span("rewind");
+
+        // Show the previous frame instead of running a new one
+        history::step_back();
+    } else {
+        {
+            trace::HostSpan emulate_span("emulate");
+
+            // Run emulator for a frame
+            while (scheduler::run()) {}
+        }
+
+        // Must see the real frame's changes before run-ahead takes its own snapshot
+        if (history::is_enabled()) {
+            trace::HostSpan capture_span("rewind_capture");
+
+            history::capture_frame();
+        }
+
+        if (runahead::is_enabled()) {
+            trace::HostSpan run_ahead_span("run_ahead");
+
+            runahead::run_ahead();
+        }
+    }
+
+    if (is_run_finished()) {
+        return SDL_APP_SUCCESS;
+    }
+
+    if (!frontend.config.is_headless) {
+        present_frame();
+    }
+
+    perf::end_frame();
 
     return SDL_APP_CONTINUE;
 }
 
-void SDL_AppQuit(void*, SDL_AppResult) {
-    SDL_DestroyTexture(screen.texture);
-    SDL_DestroyRenderer(screen.renderer);
-    SDL_DestroyWindow(screen.window);
+void SDL_AppQuit(void*, SDL_AppResult result) {
+    if (!frontend.config.is_headless) {
+        SDL_DestroyTexture(screen.texture);
+        SDL_DestroyRenderer(screen.renderer);
+        SDL_DestroyWindow(screen.window);
+    }
+
+    if (result == SDL_APP_SUCCESS) {
+        print_run_summary();
+    }
+
+    movie::shutdown();
+
+    if (perf::is_enabled()) {
+        perf::shutdown();
+    }
+
+    if (trace::is_enabled()) {
+        trace::shutdown();
+    }
+
+    if (profiler::is_enabled()) {
+        profiler::shutdown();
+    }
+
+    if (hw::pvr::capture::is_enabled()) {
+        hw::pvr::capture::shutdown();
+    }
+
+    if (framedump::is_enabled()) {
+        framedump::shutdown();
+    }
+
+    if (history::is_enabled()) {
+        history::shutdown();
+    }
+
+    if (runahead::is_enabled()) {
+        runahead::shutdown();
+    }
+
+    if (snapshot::is_initialized()) {
+        snapshot::shutdown();
+    }
 
     nejicast::shutdown();
 }
@@ -0,0 +1,253 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <perf.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace perf {
+
+constexpr const char* SCOPE_NAMES[NUM_SCOPES] = {
+    "other",
+    "cpu",
+    "scheduler",
+    "ta",
+    "render",
+    "triangle",
+    "present",
+};
+
+constexpr const char* COUNTER_NAMES[NUM_COUNTERS] = {
+    "instructions",
+    "events",
+    "ta_blocks",
+    "strips",
+    "triangles",
+    "culled_triangles",
+    "pixels",
+    "uploaded_rows",
+};
+
+typedef std::chrono::steady_clock Clock;
+
+struct {
+    bool is_enabled;
+
+    Scope current_scope;
+    u64 scope_start;
+
+    // Raw counts for the current frame
+    std::array<u64, NUM_SCOPES> scope_ticks;
+    std::array<u64, NUM_COUNTERS> counters;
+
+    u64 frame_start;
+    Clock::time_point frame_start_time;
+
+    FrameStats frame_stats;
+
+    // Sums over the current dump interval
+    FrameStats interval_stats;
+    int num_interval_frames;
+
+    int dump_interval;
+    FILE* json_file;
+} ctx;
+
+static u64 read_timestamp() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return Clock::now().time_since_epoch().count();
+#endif
+}
+
+static void dump_stats(const FrameStats& stats) {
+    std::printf("[perf] frame %llu: %.3f ms/frame\n", stats.frame, stats.frame_time_ms);
+
+    for (int scope = 0; scope < NUM_SCOPES; scope++) {
+        std::printf("[perf]   %-10s %8.3f ms (%5.1f%%)\n",
+            SCOPE_NAMES[scope],
+            stats.scope_time_ms[scope],
+            100.0 * stats.scope_time_ms[scope] / stats.frame_time_ms
+        );
+    }
+
+    for (int counter = 0; counter < NUM_COUNTERS; counter++) {
+        std::printf("[perf]   %-12s %llu\n", COUNTER_NAMES[counter], stats.counters[counter]);
+    }
+
+    if (ctx.json_file == nullptr) {
+        return;
+    }
+
+    std::fprintf(ctx.json_file, "{\"frame\":%llu,\"frame_time_ms\":%.4f,\"scopes_ms\":{", stats.frame, stats.frame_time_ms);
+
+    for (int scope = 0; scope < NUM_SCOPES; scope++) {
+        std::fprintf(ctx.json_file, "%s\"%s\":%.4f", (scope == 0) ? "" : ",", SCOPE_NAMES[scope], stats.scope_time_ms[scope]);
+    }
+
+    std::fputs("},\"counters\":{", ctx.json_file);
+
+    for (int counter = 0; counter < NUM_COUNTERS; counter++) {
+        std::fprintf(ctx.json_file, "%s\"%s\":%llu", (counter == 0) ? "" : ",", COUNTER_NAMES[counter], stats.counters[counter]);
+    }
+
+    std::fputs("}}\n", ctx.json_file);
+    std::fflush(ctx.json_file);
+}
+
+void initialize(const int dump_interval, const char* json_path) {
+    ctx.is_enabled = true;
+
+    ctx.current_scope = SCOPE_OTHER;
+    ctx.scope_start = read_timestamp();
+
+    ctx.frame_start = ctx.scope_start;
+    ctx.frame_start_time = Clock::now();
+
+    ctx.dump_interval = dump_interval;
+
+    if (json_path != nullptr) {
+        ctx.json_file = std::fopen(json_path, "w");
+
+        if (ctx.json_file == nullptr) {
+            std::printf("Failed to open file \"%s\"\n", json_path);
+            exit(1);
+        }
+    }
+}
+
+void shutdown() {
+    if (ctx.json_file != nullptr) {
+        std::fclose(ctx.json_file);
+
+        ctx.json_file = nullptr;
+    }
+
+    ctx.is_enabled = false;
+}
+
+bool is_enabled() {
+    return ctx.is_enabled;
+}
+
+Scope enter_scope(const Scope scope) {
+    const Scope parent_scope = ctx.current_scope;
+
+    if (!ctx.is_enabled) {
+        return parent_scope;
+    }
+
+    const u64 now = read_timestamp();
+
+    ctx.scope_ticks[parent_scope] += now - ctx.scope_start;
+
+    ctx.current_scope = scope;
+    ctx.scope_start = now;
+
+    return parent_scope;
+}
+
+void exit_scope(const Scope parent_scope) {
+    if (!ctx.is_enabled) {
+        return;
+    }
+
+    const u64 now = read_timestamp();
+
+    ctx.scope_ticks[ctx.current_scope] += now - ctx.scope_start;
+
+    ctx.current_scope = parent_scope;
+    ctx.scope_start = now;
+}
+
+void add(const Counter counter, const u64 value) {
+    ctx.counters[counter] += value;
+}
+
+void end_frame() {
+    if (!ctx.is_enabled) {
+        return;
+    }
+
+    const u64 now = read_timestamp();
+    const Clock::time_point now_time = Clock::now();
+
+    ctx.scope_ticks[ctx.current_scope] += now - ctx.scope_start;
+    ctx.scope_start = now;
+
+    // Calibrate timestamp ticks against the wall clock every frame
+    const f64 frame_time_ms = std::chrono::duration<f64, std::milli>(now_time - ctx.frame_start_time).count();
+    const f64 ms_per_tick = (now != ctx.frame_start) ? (frame_time_ms / (f64)(now - ctx.frame_start)) : 0.0;
+
+    FrameStats& stats = ctx.frame_stats;
+
+    stats.frame++;
+    stats.frame_time_ms = frame_time_ms;
+
+    for (int scope = 0; scope < NUM_SCOPES; scope++) {
+        stats.scope_time_ms[scope] = ms_per_tick * (f64)ctx.scope_ticks[scope];
+
+        ctx.interval_stats.scope_time_ms[scope] += stats.scope_time_ms[scope];
+    }
+
+    stats.counters = ctx.counters;
+
+    for (int counter = 0; counter < NUM_COUNTERS; counter++) {
+        ctx.interval_stats.counters[counter] += stats.counters[counter];
+    }
+
+    ctx.interval_stats.frame_time_ms += frame_time_ms;
+
+    ctx.scope_ticks.fill(0);
+    ctx.counters.fill(0);
+
+    ctx.frame_start = now;
+    ctx.frame_start_time = now_time;
+
+    if ((ctx.dump_interval == 0) || (++ctx.num_interval_frames < ctx.dump_interval)) {
+        return;
+    }
+
+    // Report per-frame averages over the interval
+    FrameStats& interval_stats = ctx.interval_stats;
+
+    interval_stats.frame = stats.frame;
+    interval_stats.frame_time_ms /= ctx.num_interval_frames;
+
+    for (auto& scope_time_ms : interval_stats.scope_time_ms) {
+        scope_time_ms /= ctx.num_interval_frames;
+    }
+
+    for (auto& counter : interval_stats.counters) {
+        counter /= ctx.num_interval_frames;
+    }
+
+    dump_stats(interval_stats);
+
+    interval_stats = FrameStats{};
+
+    ctx.num_interval_frames = 0;
+}
+
+const FrameStats& get_frame_stats() {
+    return ctx.frame_stats;
+}
+
+const char* get_scope_name(const Scope scope) {
+    return SCOPE_NAMES[scope];
+}
+
+const char* get_counter_name(const Counter counter) {
+    return COUNTER_NAMES[counter];
+}
+
+}
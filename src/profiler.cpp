@@ -0,0 +1,277 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <profiler.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <scheduler.hpp>
+#include <common/elf.hpp>
+#include <hw/cpu/cpu.hpp>
+
+namespace profiler {
+
+// Deeper call chains lose their outermost frames
+constexpr usize MAX_STACK_DEPTH = 64;
+
+constexpr usize NUM_TOP_ENTRIES = 20;
+
+// Frames are symbol indices, or ~addr for addresses outside any symbol
+typedef i64 FrameId;
+
+struct {
+    bool is_enabled;
+
+    const char* output_path;
+
+    i64 interval;
+
+    // Physical addresses, so P0-P3 mirrors of a function match the same symbol
+    std::vector<common::ElfSymbol> symbols;
+
+    // Shadow call stack of return addresses
+    std::vector<u32> call_stack;
+
+    // Sample counts per call chain, outermost frame first
+    std::map<std::vector<FrameId>, u64> stacks;
+    u64 num_samples;
+
+    bool count_blocks;
+
+    std::unordered_map<u32, u64> block_counts;
+} ctx;
+
+static FrameId get_frame_id(const u32 addr) {
+    const u32 physical_addr = hw::cpu::to_physical_address(addr);
+
+    const auto it = std::upper_bound(
+        ctx.symbols.begin(),
+        ctx.symbols.end(),
+        physical_addr,
+        [](const u32 addr, const common::ElfSymbol& symbol) {
+            return addr < symbol.addr;
+        }
+    );
+
+    if (it == ctx.symbols.begin()) {
+        return ~(FrameId)addr;
+    }
+
+    const common::ElfSymbol& symbol = *(it - 1);
+
+    if ((symbol.size != 0) && (physical_addr >= (symbol.addr + symbol.size))) {
+        return ~(FrameId)addr;
+    }
+
+    return (it - 1) - ctx.symbols.begin();
+}
+
+static std::string get_frame_name(const FrameId id) {
+    if (id >= 0) {
+        return ctx.symbols[id].name;
+    }
+
+    char name[16];
+
+    std::snprintf(name, sizeof(name), "0x%08X", (u32)~id);
+
+    return name;
+}
+
+static std::string get_addr_name(const u32 addr) {
+    const FrameId id = get_frame_id(addr);
+
+    if (id < 0) {
+        return get_frame_name(id);
+    }
+
+    char offset[16];
+
+    std::snprintf(offset, sizeof(offset), "+0x%X", hw::cpu::to_physical_address(addr) - ctx.symbols[id].addr);
+
+    return ctx.symbols[id].name + offset;
+}
+
+static void sample(const int) {
+    std::vector<FrameId> stack;
+
+    stack.reserve(ctx.call_stack.size() + 1);
+
+    for (const u32 return_addr : ctx.call_stack) {
+        // Return addresses point after the delay slot of the call
+        stack.push_back(get_frame_id(return_addr - 4));
+    }
+
+    stack.push_back(get_frame_id(hw::cpu::get_pc()));
+
+    ctx.stacks[stack]++;
+    ctx.num_samples++;
+
+    scheduler::schedule_event("PROFILER_SAMPLE", sample, 0, ctx.interval);
+}
+
+static void write_folded_stacks() {
+    FILE* file = std::fopen(ctx.output_path, "w");
+
+    if (file == nullptr) {
+        std::printf("Failed to open file \"%s\"\n", ctx.output_path);
+        exit(1);
+    }
+
+    for (const auto& [stack, count] : ctx.stacks) {
+        for (usize i = 0; i < stack.size(); i++) {
+            std::fprintf(file, "%s%s", (i == 0) ? "" : ";", get_frame_name(stack[i]).c_str());
+        }
+
+        std::fprintf(file, " %llu\n", count);
+    }
+
+    std::fclose(file);
+}
+
+static void print_flat_profile() {
+    // Self and total (inclusive) samples per frame
+    std::unordered_map<FrameId, std::pair<u64, u64>> frames;
+
+    for (const auto& [stack, count] : ctx.stacks) {
+        frames[stack.back()].first += count;
+
+        std::vector<FrameId> seen_frames;
+
+        for (const FrameId id : stack) {
+            // Count recursive frames once
+            if (std::find(seen_frames.begin(), seen_frames.end(), id) != seen_frames.end()) {
+                continue;
+            }
+
+            seen_frames.push_back(id);
+
+            frames[id].second += count;
+        }
+    }
+
+    std::vector<std::pair<FrameId, std::pair<u64, u64>>> sorted_frames(frames.begin(), frames.end());
+
+    std::sort(sorted_frames.begin(), sorted_frames.end(), [](const auto& a, const auto& b) {
+        return a.second.first > b.second.first;
+    });
+
+    std::printf("[profiler] %llu samples, top %zu by self time:\n", ctx.num_samples, NUM_TOP_ENTRIES);
+    std::puts("[profiler]    self%   total%  symbol");
+
+    for (usize i = 0; i < std::min(sorted_frames.size(), NUM_TOP_ENTRIES); i++) {
+        const auto& [id, counts] = sorted_frames[i];
+
+        std::printf("[profiler]  %6.2f%%  %6.2f%%  %s\n",
+            100.0 * (f64)counts.first / (f64)ctx.num_samples,
+            100.0 * (f64)counts.second / (f64)ctx.num_samples,
+            get_frame_name(id).c_str()
+        );
+    }
+}
+
+static void write_block_counts() {
+    const std::string path = std::string(ctx.output_path) + ".blocks";
+
+    FILE* file = std::fopen(path.c_str(), "w");
+
+    if (file == nullptr) {
+        std::printf("Failed to open file \"%s\"\n", path.c_str());
+        exit(1);
+    }
+
+    std::vector<std::pair<u32, u64>> blocks(ctx.block_counts.begin(), ctx.block_counts.end());
+
+    std::sort(blocks.begin(), blocks.end(), [](const auto& a, const auto& b) {
+        return a.second > b.second;
+    });
+
+    for (const auto& [addr, count] : blocks) {
+        std::fprintf(file, "%08X %12llu %s\n", addr, count, get_addr_name(addr).c_str());
+    }
+
+    std::fclose(file);
+}
+
+void initialize(const char* elf_path, const char* output_path, const i64 interval, const bool count_blocks) {
+    assert(interval > 0);
+
+    ctx.is_enabled = true;
+
+    ctx.output_path = output_path;
+    ctx.interval = interval;
+    ctx.count_blocks = count_blocks;
+
+    ctx.symbols = common::load_elf_symbols(elf_path);
+
+    // Masking can reorder symbols linked to different regions, sort again by the lookup key
+    for (auto& symbol : ctx.symbols) {
+        symbol.addr = hw::cpu::to_physical_address(symbol.addr);
+    }
+
+    std::stable_sort(ctx.symbols.begin(), ctx.symbols.end(), [](const common::ElfSymbol& a, const common::ElfSymbol& b) {
+        return a.addr < b.addr;
+    });
+
+    hw::cpu::set_profiler_hooks(true, count_blocks);
+
+    scheduler::schedule_event("PROFILER_SAMPLE", sample, 0, ctx.interval);
+}
+
+void shutdown() {
+    assert(ctx.is_enabled);
+
+    hw::cpu::set_profiler_hooks(false, false);
+
+    write_folded_stacks();
+    print_flat_profile();
+
+    std::printf("[profiler] Wrote folded stacks to \"%s\"\n", ctx.output_path);
+
+    if (ctx.count_blocks) {
+        write_block_counts();
+
+        std::printf("[profiler] Wrote %zu block counts to \"%s.blocks\"\n", ctx.block_counts.size(), ctx.output_path);
+    }
+
+    ctx.is_enabled = false;
+}
+
+bool is_enabled() {
+    return ctx.is_enabled;
+}
+
+void push_call(const u32 return_addr) {
+    if (ctx.call_stack.size() >= MAX_STACK_DEPTH) {
+        ctx.call_stack.erase(ctx.call_stack.begin());
+    }
+
+    ctx.call_stack.push_back(return_addr);
+}
+
+void pop_call(const u32 return_addr) {
+    // Unwind to the matching frame, returns that don't match a call (longjmp-style code) are ignored
+    for (usize i = ctx.call_stack.size(); i > 0; i--) {
+        if (ctx.call_stack[i - 1] == return_addr) {
+            ctx.call_stack.resize(i - 1);
+
+            return;
+        }
+    }
+}
+
+void count_block(const u32 addr) {
+    ctx.block_counts[addr]++;
+}
+
+}
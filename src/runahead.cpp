@@ -0,0 +1,65 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <runahead.hpp>
+
+#include <cassert>
+#include <vector>
+
+#include <scheduler.hpp>
+#include <snapshot.hpp>
+#include <hw/pvr/core.hpp>
+
+namespace runahead {
+
+struct {
+    int num_frames;
+
+    std::vector<u8> state;
+} ctx;
+
+void initialize(const int num_frames) {
+    assert((num_frames > 0) && (num_frames <= MAX_FRAMES));
+
+    if (!snapshot::is_initialized()) {
+        snapshot::initialize();
+    }
+
+    ctx.num_frames = num_frames;
+
+    // Real frames are never presented
+    hw::pvr::core::set_scan_out_enabled(false);
+}
+
+void shutdown() {
+    ctx.num_frames = 0;
+
+    hw::pvr::core::set_scan_out_enabled(true);
+
+    std::vector<u8> temp;
+    ctx.state.swap(temp);
+}
+
+bool is_enabled() {
+    return ctx.num_frames != 0;
+}
+
+void run_ahead() {
+    assert(is_enabled());
+
+    snapshot::save(ctx.state);
+
+    for (int frame = 0; frame < ctx.num_frames; frame++) {
+        hw::pvr::core::set_scan_out_enabled(frame == (ctx.num_frames - 1));
+
+        while (scheduler::run()) {}
+    }
+
+    snapshot::restore(ctx.state);
+
+    hw::pvr::core::set_scan_out_enabled(false);
+}
+
+}
@@ -12,6 +12,8 @@
 #include <queue>
 #include <vector>
 
+#include <perf.hpp>
+#include <trace.hpp>
 #include <hw/cpu/cpu.hpp>
 
 namespace scheduler {
@@ -21,6 +23,8 @@ constexpr i64 FRAME_CYCLES = SCHEDULER_CLOCKRATE / 60;
 constexpr i64 MAX_CYCLES = 512;
 
 struct Event {
+    const char* name;
+
     Callback callback;
 
     int arg;
@@ -38,6 +42,8 @@ static EventQueue scheduled_events;
 static i64 global_timestamp;
 static i64 elapsed_cycles;
 
+static u64 frame_count;
+
 static void set_cpu_cycles_and_step(const i64 cycles) {
     *hw::cpu::get_cycles() = cycles;
 
@@ -53,19 +59,61 @@ void reset() {
 
     global_timestamp = 0;
     elapsed_cycles = 0;
+
+    frame_count = 0;
 }
 
 void shutdown() {}
 
+void save_state(common::StateWriter& writer) {
+    auto events = scheduled_events;
+
+    writer.write<u64>(events.size());
+
+    while (!events.empty()) {
+        writer.write(events.top());
+
+        events.pop();
+    }
+
+    writer.write(global_timestamp);
+    writer.write(elapsed_cycles);
+    writer.write(frame_count);
+}
+
+void load_state(common::StateReader& reader) {
+    EventQueue temp;
+    scheduled_events.swap(temp);
+
+    const u64 num_events = reader.read<u64>();
+
+    for (u64 i = 0; i < num_events; i++) {
+        scheduled_events.emplace(reader.read<Event>());
+    }
+
+    reader.read(global_timestamp);
+    reader.read(elapsed_cycles);
+    reader.read(frame_count);
+}
+
 void schedule_event(const char *name, Callback callback, const int arg, const i64 cycles) {
     if (
         (std::strcmp(name, "HBLANK") != 0) &&
-        (std::strcmp(name, "SCIF_TX") != 0)
+        (std::strcmp(name, "SCIF_TX") != 0) &&
+        (std::strcmp(name, "PROFILER_SAMPLE") != 0)
     ) {
         std::printf("Scheduling event %s with arg = %d, cycles = %lld\n", name, arg, cycles);
     }
 
-    scheduled_events.emplace(Event{callback, arg, global_timestamp + cycles - *hw::cpu::get_cycles()});
+    scheduled_events.emplace(Event{name, callback, arg, global_timestamp + cycles - *hw::cpu::get_cycles()});
+}
+
+i64 get_timestamp() {
+    return global_timestamp;
+}
+
+u64 get_frame_count() {
+    return frame_count;
 }
 
 bool run() {
@@ -74,6 +122,7 @@ bool run() {
     elapsed_cycles += MAX_CYCLES;
 
     while (!scheduled_events.empty() && (scheduled_events.top().timestamp <= new_timestamp)) {
+        const char* name = scheduled_events.top().name;
         const Callback callback = scheduled_events.top().callback;
 
         const int arg = scheduled_events.top().arg;
@@ -85,6 +134,12 @@ bool run() {
 
         global_timestamp = timestamp;
 
+        perf::add(perf::COUNTER_EVENTS, 1);
+
+        trace::guest_instant(trace::TRACK_SCHEDULER, name, arg);
+
+        perf::ScopedTimer timer(perf::SCOPE_SCHEDULER);
+
         callback(arg);
     }
 
@@ -95,6 +150,8 @@ bool run() {
     if (elapsed_cycles >= FRAME_CYCLES) {
         elapsed_cycles -= FRAME_CYCLES;
 
+        frame_count++;
+
         return false;
     }
 
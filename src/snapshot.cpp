@@ -0,0 +1,115 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <snapshot.hpp>
+
+#include <array>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include <nejicast.hpp>
+#include <common/state.hpp>
+#include <hw/holly/bus.hpp>
+
+namespace snapshot {
+
+using hw::holly::bus::NUM_MEMORY_REGIONS;
+using hw::holly::bus::PAGE_SIZE;
+
+struct {
+    std::array<std::vector<u8>, NUM_MEMORY_REGIONS> shadow_memory;
+
+    // Scratch list of dirty pages
+    std::vector<u32> dirty_pages;
+
+    bool is_initialized;
+} ctx;
+
+void initialize() {
+    for (int region = 0; region < NUM_MEMORY_REGIONS; region++) {
+        const u8* mem = hw::holly::bus::get_memory_ptr(region);
+
+        ctx.shadow_memory[region].assign(mem, mem + hw::holly::bus::get_memory_size(region));
+    }
+
+    hw::holly::bus::clear_dirty_pages();
+
+    ctx.is_initialized = true;
+}
+
+void shutdown() {
+    for (auto& shadow_memory : ctx.shadow_memory) {
+        std::vector<u8> temp;
+
+        shadow_memory.swap(temp);
+    }
+
+    ctx.is_initialized = false;
+}
+
+bool is_initialized() {
+    return ctx.is_initialized;
+}
+
+void save(std::vector<u8>& state, PageCallback callback) {
+    assert(ctx.is_initialized);
+
+    for (int region = 0; region < NUM_MEMORY_REGIONS; region++) {
+        const u8* mem = hw::holly::bus::get_memory_ptr(region);
+
+        u8* shadow_mem = ctx.shadow_memory[region].data();
+
+        ctx.dirty_pages.clear();
+
+        hw::holly::bus::collect_dirty_pages(region, ctx.dirty_pages);
+
+        for (const u32 page : ctx.dirty_pages) {
+            const usize offset = PAGE_SIZE * page;
+
+            if (callback != nullptr) {
+                callback(region, page, &shadow_mem[offset], &mem[offset]);
+            }
+
+            std::memcpy(&shadow_mem[offset], &mem[offset], PAGE_SIZE);
+        }
+    }
+
+    common::StateWriter writer(state);
+
+    nejicast::save_state(writer);
+}
+
+void restore(const std::vector<u8>& state) {
+    assert(ctx.is_initialized);
+
+    for (int region = 0; region < NUM_MEMORY_REGIONS; region++) {
+        u8* mem = hw::holly::bus::get_memory_ptr(region);
+
+        const u8* shadow_mem = ctx.shadow_memory[region].data();
+
+        ctx.dirty_pages.clear();
+
+        hw::holly::bus::collect_dirty_pages(region, ctx.dirty_pages);
+
+        for (const u32 page : ctx.dirty_pages) {
+            const usize offset = PAGE_SIZE * page;
+
+            std::memcpy(&mem[offset], &shadow_mem[offset], PAGE_SIZE);
+        }
+    }
+
+    common::StateReader reader(state);
+
+    nejicast::load_state(reader);
+}
+
+u8* get_shadow_ptr(const int region) {
+    assert(region < NUM_MEMORY_REGIONS);
+
+    return ctx.shadow_memory[region].data();
+}
+
+}
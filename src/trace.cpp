@@ -0,0 +1,231 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+#include <trace.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <scheduler.hpp>
+
+namespace trace {
+
+// Caps the buffer at 160 MiB
+constexpr usize MAX_EVENTS = 4 * 1024 * 1024;
+
+// Chrome trace "processes"
+enum {
+    PID_GUEST = 1,
+    PID_HOST  = 2,
+};
+
+constexpr const char* TRACK_NAMES[NUM_TRACKS] = {
+    "Scheduler",
+    "Interrupts",
+    "DMA",
+    "TA",
+    "Render",
+};
+
+struct Event {
+    const char* name;
+
+    // 'i' (instant) or 'X' (complete)
+    char phase;
+
+    int pid, tid;
+    int arg;
+
+    // In microseconds
+    f64 timestamp;
+    f64 duration;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+struct {
+    bool is_enabled;
+
+    const char* path;
+
+    std::vector<Event> events;
+    usize num_dropped_events;
+
+    Clock::time_point start_time;
+
+    // Open host spans
+    std::vector<Event> host_spans;
+} ctx;
+
+static f64 get_guest_time() {
+    return 1E6 * (f64)scheduler::get_timestamp() / (f64)scheduler::SCHEDULER_CLOCKRATE;
+}
+
+static f64 get_host_time() {
+    return std::chrono::duration<f64, std::micro>(Clock::now() - ctx.start_time).count();
+}
+
+static void push_event(const Event& event) {
+    if (ctx.events.size() >= MAX_EVENTS) {
+        ctx.num_dropped_events++;
+
+        return;
+    }
+
+    ctx.events.push_back(event);
+}
+
+static void write_metadata(FILE* file, const int pid, const int tid, const char* type, const char* name) {
+    std::fprintf(file, "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"args\":{\"name\":\"%s\"}},\n",
+        pid,
+        tid,
+        type,
+        name
+    );
+}
+
+void initialize(const char* path) {
+    ctx.is_enabled = true;
+    ctx.path = path;
+
+    ctx.events.reserve(MAX_EVENTS / 16);
+
+    ctx.start_time = Clock::now();
+}
+
+void shutdown() {
+    assert(ctx.is_enabled);
+
+    while (!ctx.host_spans.empty()) {
+        end_host_span();
+    }
+
+    ctx.is_enabled = false;
+
+    FILE* file = std::fopen(ctx.path, "w");
+
+    if (file == nullptr) {
+        std::printf("Failed to open file \"%s\"\n", ctx.path);
+        exit(1);
+    }
+
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+
+    write_metadata(file, PID_GUEST, 0, "process_name", "Guest (scheduler time)");
+    write_metadata(file, PID_HOST, 0, "process_name", "Host (wall time)");
+
+    for (int track = 0; track < NUM_TRACKS; track++) {
+        write_metadata(file, PID_GUEST, track, "thread_name", TRACK_NAMES[track]);
+    }
+
+    write_metadata(file, PID_HOST, 0, "thread_name", "Emulator thread");
+
+    for (usize i = 0; i < ctx.events.size(); i++) {
+        const Event& event = ctx.events[i];
+
+        std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,",
+            event.name,
+            event.phase,
+            event.pid,
+            event.tid,
+            event.timestamp
+        );
+
+        if (event.phase == 'X') {
+            std::fprintf(file, "\"dur\":%.3f,", event.duration);
+        } else {
+            std::fputs("\"s\":\"t\",", file);
+        }
+
+        std::fprintf(file, "\"args\":{\"arg\":%d}}%s\n", event.arg, ((i + 1) == ctx.events.size()) ? "" : ",");
+    }
+
+    std::fputs("]}\n", file);
+    std::fclose(file);
+
+    std::printf("Wrote %zu trace events to \"%s\"", ctx.events.size(), ctx.path);
+
+    if (ctx.num_dropped_events != 0) {
+        std::printf(" (%zu dropped, buffer full)", ctx.num_dropped_events);
+    }
+
+    std::puts("");
+
+    std::vector<Event> temp;
+    ctx.events.swap(temp);
+}
+
+bool is_enabled() {
+    return ctx.is_enabled;
+}
+
+void guest_instant(const Track track, const char* name, const int arg) {
+    if (!ctx.is_enabled) {
+        return;
+    }
+
+    push_event(Event{
+        .name = name,
+        .phase = 'i',
+        .pid = PID_GUEST,
+        .tid = track,
+        .arg = arg,
+        .timestamp = get_guest_time(),
+        .duration = 0.0
+    });
+}
+
+void guest_span(const Track track, const char* name, const int arg, const i64 cycles) {
+    if (!ctx.is_enabled) {
+        return;
+    }
+
+    push_event(Event{
+        .name = name,
+        .phase = 'X',
+        .pid = PID_GUEST,
+        .tid = track,
+        .arg = arg,
+        .timestamp = get_guest_time(),
+        .duration = 1E6 * (f64)cycles / (f64)scheduler::SCHEDULER_CLOCKRATE
+    });
+}
+
+void begin_host_span(const char* name) {
+    if (!ctx.is_enabled) {
+        return;
+    }
+
+    ctx.host_spans.push_back(Event{
+        .name = name,
+        .phase = 'X',
+        .pid = PID_HOST,
+        .tid = 0,
+        .arg = 0,
+        .timestamp = get_host_time(),
+        .duration = 0.0
+    });
+}
+
+void end_host_span() {
+    if (!ctx.is_enabled) {
+        return;
+    }
+
+    assert(!ctx.host_spans.empty());
+
+    Event event = ctx.host_spans.back();
+
+    ctx.host_spans.pop_back();
+
+    event.duration = get_host_time() - event.timestamp;
+
+    push_event(event);
+}
+
+}
@@ -0,0 +1,32 @@
+# nejicast is a Sega Dreamcast emulator.
+# Copyright (C) 2025  noumidev
+
+# Runs the same frames headless with and without run-ahead and fails if guest VRAM differs.
+# Expects NEJICAST (emulator path), ARGS (boot ROM;FLASH ROM;ELF), FRAMES and RUN_AHEAD
+
+function(get_vram_hash out_var)
+    execute_process(
+        COMMAND ${NEJICAST} ${ARGS} --headless --frames ${FRAMES} ${ARGN}
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE result
+    )
+
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "nejicast ${ARGN} exited with ${result}")
+    endif()
+
+    if(NOT output MATCHES "VRAM hash = ([0-9A-F]+)")
+        message(FATAL_ERROR "nejicast ${ARGN} printed no VRAM hash")
+    endif()
+
+    set(${out_var} ${CMAKE_MATCH_1} PARENT_SCOPE)
+endfunction()
+
+get_vram_hash(reference_hash)
+get_vram_hash(run_ahead_hash --run-ahead ${RUN_AHEAD})
+
+if(NOT reference_hash STREQUAL run_ahead_hash)
+    message(FATAL_ERROR "VRAM differs with run-ahead: ${reference_hash} vs ${run_ahead_hash}")
+endif()
+
+message(STATUS "VRAM hash ${reference_hash} matches with ${RUN_AHEAD} frames of run-ahead")
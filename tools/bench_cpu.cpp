@@ -0,0 +1,735 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+// Runs small SH-4 kernels through hw::cpu::step() and reports guest MIPS and host ns per instruction.
+// The emulator logs to stdout, --json writes the results as JSON Lines for tracking over time
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <nejicast.hpp>
+#include <perf.hpp>
+#include <scheduler.hpp>
+#include <common/types.hpp>
+#include <hw/cpu/cpu.hpp>
+#include <hw/cpu/ocio.hpp>
+#include <hw/holly/bus.hpp>
+#include <hw/holly/intc.hpp>
+
+// Minimal bus, only system RAM is mapped
+namespace hw::holly::bus {
+
+constexpr u32 BASE_DRAM = 0x0C000000;
+constexpr u32 SIZE_DRAM = 0x01000000;
+
+// Includes mirrors
+constexpr u32 SIZE_DRAM_AREA = 0x04000000;
+
+static std::vector<u8> dram(SIZE_DRAM);
+
+static u8* get_ram_ptr(const u32 addr, const u32 size) {
+    if ((addr < BASE_DRAM) || ((addr + size) > (BASE_DRAM + SIZE_DRAM_AREA))) {
+        std::printf("Unmapped bench bus access @ %08X (%u bytes)\n", addr, size);
+        exit(1);
+    }
+
+    return &dram[addr & (SIZE_DRAM - 1)];
+}
+
+template<typename T>
+T read(const u32 addr) {
+    T data;
+
+    std::memcpy(&data, get_ram_ptr(addr, sizeof(T)), sizeof(T));
+
+    return data;
+}
+
+template u8 read(u32);
+template u16 read(u32);
+template u32 read(u32);
+template u64 read(u32);
+
+void block_read(const u32 addr, u8* bytes) {
+    std::memcpy(bytes, get_ram_ptr(addr, 32), 32);
+}
+
+template<typename T>
+void write(const u32 addr, const T data) {
+    std::memcpy(get_ram_ptr(addr, sizeof(T)), &data, sizeof(T));
+}
+
+template void write(u32, u8);
+template void write(u32, u16);
+template void write(u32, u32);
+template void write(u32, u64);
+
+void block_write(const u32 addr, const u8* bytes) {
+    std::memcpy(get_ram_ptr(addr, 32), bytes, 32);
+}
+
+const u8* get_read_span(const u32 addr, const u32 size) {
+    return get_ram_ptr(addr, size);
+}
+
+u8* get_write_span(const u32 addr, const u32 size) {
+    return get_ram_ptr(addr, size);
+}
+
+void read_bytes(const u32 addr, u8* bytes, const u32 size) {
+    std::memcpy(bytes, get_ram_ptr(addr, size), size);
+}
+
+void write_bytes(const u32 addr, const u8* bytes, const u32 size) {
+    std::memcpy(get_ram_ptr(addr, size), bytes, size);
+}
+
+void copy_from_bytes(
+    const u32 addr,
+    const u32 copy_size,
+    const u32 total_size,
+    const u8* bytes
+) {
+    u8* ram = get_ram_ptr(addr, total_size);
+
+    std::memcpy(ram, bytes, copy_size);
+    std::memset(ram + copy_size, 0, total_size - copy_size);
+}
+
+}
+
+namespace hw::holly::intc {
+
+void assert_normal_interrupt(const int) {}
+
+}
+
+namespace nejicast {
+
+void sideload(const u32) {}
+
+}
+
+constexpr u32 CODE_ADDR = 0x8C010000;
+constexpr u32 PARAM_ADDR = 0x8C000000; // GBR after setup_for_sideload()
+constexpr u32 SRC_ADDR = 0x8C100000;
+constexpr u32 DST_ADDR = 0x8C200000;
+
+constexpr usize SIZE_SRC = 0x10000;
+
+// Parameters read by the kernels with mov.l @(disp,GBR),R0
+enum {
+    PARAM_ITERATIONS,
+    PARAM_SRC,
+    PARAM_DST,
+    PARAM_STORE_QUEUE,
+    PARAM_LCG_MUL,
+    PARAM_LCG_ADD,
+    NUM_PARAMS,
+};
+
+constexpr i64 SLICE_CYCLES = 512;
+
+constexpr int DEFAULT_RUNS = 3;
+
+static constexpr u16 NOP = 0x0009;
+static constexpr u16 RTS = 0x000B;
+static constexpr u16 DIV0U = 0x0019;
+static constexpr u16 FRCHG = 0xFBFD;
+
+// Tiny SH-4 assembler with label fixups for 8-bit and 12-bit branches
+class Assembler {
+private:
+    struct Fixup {
+        usize idx;
+        int label;
+        bool is_long;
+    };
+
+    std::vector<u16> code;
+    std::vector<i64> labels;
+    std::vector<Fixup> fixups;
+
+    i64 exit_idx = -1;
+
+    void emit_branch(const u16 opcode, const int label, const bool is_long) {
+        fixups.push_back(Fixup{.idx = code.size(), .label = label, .is_long = is_long});
+
+        emit(opcode);
+    }
+public:
+    void emit(const u16 instr) {
+        code.push_back(instr);
+    }
+
+    int new_label() {
+        labels.push_back(-1);
+
+        return labels.size() - 1;
+    }
+
+    void bind(const int label) {
+        labels[label] = code.size();
+    }
+
+    void bt(const int label) { emit_branch(0x8900, label, false); }
+    void bf(const int label) { emit_branch(0x8B00, label, false); }
+    void bra(const int label) { emit_branch(0xA000, label, true); }
+    void bsr(const int label) { emit_branch(0xB000, label, true); }
+
+    // Marks the end of the kernel, the bench stops once PC passes the SLEEP
+    void exit() {
+        emit(0x001B);
+
+        exit_idx = code.size();
+
+        // Keeps the exit address from being a branch target
+        emit(NOP);
+    }
+
+    u32 get_exit_addr() const {
+        assert(exit_idx >= 0);
+
+        return CODE_ADDR + sizeof(u16) * exit_idx;
+    }
+
+    const std::vector<u16>& finish() {
+        for (const auto& fixup : fixups) {
+            const i64 target = labels[fixup.label];
+
+            assert(target >= 0);
+
+            // Branch targets are relative to the branch address + 4
+            const i64 disp = target - ((i64)fixup.idx + 2);
+
+            if (fixup.is_long) {
+                assert((disp >= -2048) && (disp < 2048));
+
+                code[fixup.idx] |= disp & 0xFFF;
+            } else {
+                assert((disp >= -128) && (disp < 128));
+
+                code[fixup.idx] |= disp & 0xFF;
+            }
+        }
+
+        fixups.clear();
+
+        return code;
+    }
+};
+
+// Instruction encodings
+static constexpr u16 rr(const u16 opcode, const int m, const int n) { return opcode | (n << 8) | (m << 4); }
+static constexpr u16 rn(const u16 opcode, const int n) { return opcode | (n << 8); }
+static constexpr u16 ri(const u16 opcode, const int imm, const int n) { return opcode | (n << 8) | (imm & 0xFF); }
+
+static constexpr u16 mov(const int m, const int n) { return rr(0x6003, m, n); }
+static constexpr u16 mov_imm(const int imm, const int n) { return ri(0xE000, imm, n); }
+static constexpr u16 add(const int m, const int n) { return rr(0x300C, m, n); }
+static constexpr u16 add_imm(const int imm, const int n) { return ri(0x7000, imm, n); }
+static constexpr u16 sub(const int m, const int n) { return rr(0x3008, m, n); }
+static constexpr u16 and_(const int m, const int n) { return rr(0x2009, m, n); }
+static constexpr u16 or_(const int m, const int n) { return rr(0x200B, m, n); }
+static constexpr u16 xor_(const int m, const int n) { return rr(0x200A, m, n); }
+static constexpr u16 shll(const int n) { return rn(0x4000, n); }
+static constexpr u16 shlr(const int n) { return rn(0x4001, n); }
+static constexpr u16 shll2(const int n) { return rn(0x4008, n); }
+static constexpr u16 shll8(const int n) { return rn(0x4018, n); }
+static constexpr u16 shlr16(const int n) { return rn(0x4029, n); }
+static constexpr u16 rotcl(const int n) { return rn(0x4024, n); }
+static constexpr u16 dt(const int n) { return rn(0x4010, n); }
+static constexpr u16 tst_imm(const int imm) { return ri(0xC800, imm, 0); }
+static constexpr u16 div1(const int m, const int n) { return rr(0x3004, m, n); }
+static constexpr u16 mul_l(const int m, const int n) { return rr(0x0007, m, n); }
+static constexpr u16 sts_macl(const int n) { return rn(0x001A, n); }
+static constexpr u16 mov_l_gbr(const int param) { return ri(0xC600, param, 0); }
+static constexpr u16 mov_l_postinc(const int m, const int n) { return rr(0x6006, m, n); }
+static constexpr u16 mov_l_disp_store(const int m, const int disp, const int n) { return rr(0x1000, m, n) | (disp >> 2); }
+static constexpr u16 pref(const int n) { return rn(0x0083, n); }
+static constexpr u16 fldi0(const int n) { return rn(0xF08D, n); }
+static constexpr u16 fldi1(const int n) { return rn(0xF09D, n); }
+static constexpr u16 fadd(const int m, const int n) { return rr(0xF000, m, n); }
+static constexpr u16 fdiv(const int m, const int n) { return rr(0xF003, m, n); }
+static constexpr u16 fmac(const int m, const int n) { return rr(0xF00E, m, n); }
+static constexpr u16 fmov_postinc(const int m, const int n) { return rr(0xF009, m, n); }
+static constexpr u16 fmov_predec(const int m, const int n) { return rr(0xF00B, m, n); }
+static constexpr u16 ftrv(const int n) { return 0xF1FD | ((n >> 2) << 10); }
+
+static void load_param(Assembler& a, const int param, const int n) {
+    a.emit(mov_l_gbr(param));
+    a.emit(mov(0, n));
+}
+
+static void assemble_alu(Assembler& a) {
+    load_param(a, PARAM_ITERATIONS, 1);
+
+    a.emit(mov_imm(1, 2));
+    a.emit(mov_imm(3, 3));
+    a.emit(mov_imm(0, 4));
+    a.emit(mov_imm(5, 5));
+
+    const int loop = a.new_label();
+
+    a.bind(loop);
+    a.emit(add(2, 4));
+    a.emit(xor_(4, 3));
+    a.emit(sub(3, 5));
+    a.emit(or_(3, 2));
+    a.emit(add_imm(7, 4));
+    a.emit(shlr(5));
+    a.emit(and_(4, 6));
+    a.emit(shll(3));
+    a.emit(dt(1));
+    a.bf(loop);
+
+    a.exit();
+}
+
+// Unsigned 32-bit division with div0u/div1, the usual compiler expansion
+static void assemble_div1(Assembler& a) {
+    load_param(a, PARAM_ITERATIONS, 5);
+
+    a.emit(mov_imm(-1, 6));
+    a.emit(shlr(6));
+    a.emit(mov_imm(37, 3));
+    a.emit(mov_imm(0, 7));
+
+    const int loop = a.new_label();
+
+    a.bind(loop);
+    a.emit(mov(6, 1));
+    a.emit(mov_imm(0, 2));
+    a.emit(DIV0U);
+
+    for (int i = 0; i < 32; i++) {
+        a.emit(rotcl(1));
+        a.emit(div1(3, 2));
+    }
+
+    a.emit(rotcl(1));
+    a.emit(add(1, 7));
+    a.emit(add_imm(-3, 6));
+    a.emit(dt(5));
+    a.bf(loop);
+
+    a.exit();
+}
+
+static void assemble_fmac(Assembler& a) {
+    load_param(a, PARAM_ITERATIONS, 5);
+
+    // FR0 = 0.5
+    a.emit(fldi1(10));
+    a.emit(fadd(10, 10));
+    a.emit(fldi1(0));
+    a.emit(fdiv(10, 0));
+
+    a.emit(fldi1(1));
+
+    for (int n = 2; n < 10; n++) {
+        a.emit(fldi0(n));
+    }
+
+    const int loop = a.new_label();
+
+    a.bind(loop);
+
+    for (int n = 2; n < 10; n++) {
+        a.emit(fmac(n - 1, n));
+    }
+
+    a.emit(dt(5));
+    a.bf(loop);
+
+    a.exit();
+}
+
+// 4x4 matrix transform of a vertex stream, XMTRX is loaded from the start of the source buffer
+static void assemble_ftrv(Assembler& a) {
+    load_param(a, PARAM_ITERATIONS, 5);
+    load_param(a, PARAM_SRC, 1);
+
+    a.emit(FRCHG);
+
+    for (int n = 0; n < 16; n++) {
+        a.emit(fmov_postinc(1, n));
+    }
+
+    a.emit(FRCHG);
+
+    // 4096 bytes of output per pass
+    a.emit(mov_imm(1, 4));
+    a.emit(shll8(4));
+    a.emit(shll2(4));
+    a.emit(shll2(4));
+
+    const int outer = a.new_label();
+    const int inner = a.new_label();
+
+    a.bind(outer);
+    load_param(a, PARAM_SRC, 2);
+    a.emit(add_imm(64, 2));
+    load_param(a, PARAM_DST, 3);
+    a.emit(add(4, 3));
+    a.emit(mov_imm(64, 6));
+    a.emit(shll(6));
+
+    a.bind(inner);
+
+    for (int n = 0; n < 8; n++) {
+        a.emit(fmov_postinc(2, n));
+    }
+
+    a.emit(ftrv(0));
+    a.emit(ftrv(4));
+
+    for (int n = 7; n >= 0; n--) {
+        a.emit(fmov_predec(n, 3));
+    }
+
+    a.emit(dt(6));
+    a.bf(inner);
+    a.emit(dt(5));
+    a.bf(outer);
+
+    a.exit();
+}
+
+static void assemble_memcpy(Assembler& a) {
+    load_param(a, PARAM_ITERATIONS, 5);
+
+    const int outer = a.new_label();
+    const int inner = a.new_label();
+
+    // 4096 bytes per pass
+    a.bind(outer);
+    load_param(a, PARAM_SRC, 1);
+    load_param(a, PARAM_DST, 2);
+    a.emit(mov_imm(64, 6));
+    a.emit(shll2(6));
+
+    a.bind(inner);
+    a.emit(mov_l_postinc(1, 3));
+    a.emit(mov_l_postinc(1, 4));
+    a.emit(mov_l_postinc(1, 7));
+    a.emit(mov_l_postinc(1, 8));
+    a.emit(mov_l_disp_store(3, 0, 2));
+    a.emit(mov_l_disp_store(4, 4, 2));
+    a.emit(mov_l_disp_store(7, 8, 2));
+    a.emit(mov_l_disp_store(8, 12, 2));
+    a.emit(add_imm(16, 2));
+    a.emit(dt(6));
+    a.bf(inner);
+    a.emit(dt(5));
+    a.bf(outer);
+
+    a.exit();
+}
+
+// Branches on bits of an LCG, taken about half of the time, with a call on every fourth iteration
+static void assemble_branch(Assembler& a) {
+    load_param(a, PARAM_LCG_MUL, 7);
+    load_param(a, PARAM_LCG_ADD, 8);
+    load_param(a, PARAM_ITERATIONS, 5);
+
+    a.emit(mov_imm(1, 4));
+    a.emit(mov_imm(0, 9));
+    a.emit(mov_imm(0, 10));
+
+    const int loop = a.new_label();
+    const int skip_add = a.new_label();
+    const int skip_call = a.new_label();
+    const int skip_xor = a.new_label();
+    const int leaf = a.new_label();
+
+    a.bind(loop);
+    a.emit(mul_l(7, 4));
+    a.emit(sts_macl(4));
+    a.emit(add(8, 4));
+    a.emit(mov(4, 0));
+    a.emit(shlr16(0));
+    a.emit(tst_imm(1));
+    a.bt(skip_add);
+    a.emit(add_imm(1, 9));
+    a.bind(skip_add);
+    a.emit(tst_imm(6));
+    a.bf(skip_call);
+    a.bsr(leaf);
+    a.emit(NOP);
+    a.bind(skip_call);
+    a.emit(tst_imm(8));
+    a.bt(skip_xor);
+    a.emit(xor_(4, 10));
+    a.bind(skip_xor);
+    a.emit(dt(5));
+    a.bf(loop);
+
+    a.exit();
+
+    a.bind(leaf);
+    a.emit(RTS);
+    a.emit(add_imm(1, 10));
+}
+
+// Fills both store queues and flushes them with PREF, 64 bytes per iteration
+static void assemble_store_queue(Assembler& a) {
+    load_param(a, PARAM_ITERATIONS, 5);
+    load_param(a, PARAM_STORE_QUEUE, 1);
+
+    a.emit(mov_imm(-1, 3));
+
+    const int outer = a.new_label();
+    const int inner = a.new_label();
+
+    a.bind(outer);
+    a.emit(mov(1, 2));
+    a.emit(mov_imm(64, 6));
+    a.emit(shll2(6));
+
+    a.bind(inner);
+
+    for (int queue = 0; queue < 2; queue++) {
+        for (int disp = 0; disp < 32; disp += 4) {
+            a.emit(mov_l_disp_store(3, disp, 2));
+        }
+
+        a.emit(pref(2));
+        a.emit(add_imm(32, 2));
+    }
+
+    a.emit(add_imm(1, 3));
+    a.emit(dt(6));
+    a.bf(inner);
+    a.emit(dt(5));
+    a.bf(outer);
+
+    a.exit();
+}
+
+struct Kernel {
+    const char* name;
+
+    void (*assemble)(Assembler&);
+
+    // Outer loop iterations at scale 1
+    u32 iterations;
+};
+
+constexpr Kernel KERNELS[] = {
+    {"alu", assemble_alu, 1 << 21},
+    {"div1", assemble_div1, 1 << 16},
+    {"fmac", assemble_fmac, 1 << 20},
+    {"ftrv", assemble_ftrv, 1 << 10},
+    {"memcpy", assemble_memcpy, 1 << 10},
+    {"branch", assemble_branch, 1 << 20},
+    {"store_queue", assemble_store_queue, 1 << 8},
+};
+
+struct Result {
+    u64 num_instrs;
+    u64 num_cycles;
+
+    f64 host_ns;
+};
+
+// Guest instructions per host microsecond
+static f64 get_guest_mips(const Result& result) {
+    return 1E3 * (f64)result.num_instrs / result.host_ns;
+}
+
+static u32 to_physical(const u32 addr) {
+    return addr & 0x1FFFFFFF;
+}
+
+static void setup_memory(const std::vector<u16>& code, const u32 iterations) {
+    for (usize i = 0; i < code.size(); i++) {
+        hw::holly::bus::write<u16>(to_physical(CODE_ADDR) + sizeof(u16) * i, code[i]);
+    }
+
+    const u32 params[NUM_PARAMS] = {
+        iterations,
+        SRC_ADDR,
+        DST_ADDR,
+        0xE0000000 | (DST_ADDR & 0x03FFFFE0),
+        1103515245,
+        12345,
+    };
+
+    for (int param = 0; param < NUM_PARAMS; param++) {
+        hw::holly::bus::write<u32>(to_physical(PARAM_ADDR) + sizeof(u32) * param, params[param]);
+    }
+
+    // Small floats, so that transforms stay finite
+    for (usize i = 0; i < (SIZE_SRC / sizeof(f32)); i++) {
+        const f32 data = (f32)(i % 7) * 0.25f;
+
+        u32 raw;
+        std::memcpy(&raw, &data, sizeof(raw));
+
+        hw::holly::bus::write<u32>(to_physical(SRC_ADDR) + sizeof(u32) * i, raw);
+    }
+}
+
+static Result run_kernel(const std::vector<u16>& code, const u32 exit_addr, const u32 iterations) {
+    setup_memory(code, iterations);
+
+    scheduler::reset();
+    hw::cpu::reset();
+    hw::cpu::initialize();
+    hw::cpu::setup_for_sideload(CODE_ADDR);
+
+    // Point both store queues at system RAM
+    const u32 queue_address_control = (to_physical(DST_ADDR) >> 26) << 2;
+
+    hw::cpu::ocio::write<u32>(0x1F000038, queue_address_control);
+    hw::cpu::ocio::write<u32>(0x1F00003C, queue_address_control);
+
+    i64* cycles = hw::cpu::get_cycles();
+
+    Result result{};
+
+    perf::end_frame();
+
+    const auto start_time = std::chrono::steady_clock::now();
+
+    while (hw::cpu::get_pc() != exit_addr) {
+        *cycles = SLICE_CYCLES;
+
+        hw::cpu::step();
+
+        result.num_cycles += SLICE_CYCLES - *cycles;
+    }
+
+    const auto end_time = std::chrono::steady_clock::now();
+
+    perf::end_frame();
+
+    result.num_instrs = perf::get_frame_stats().counters[perf::COUNTER_INSTRUCTIONS];
+    result.host_ns = std::chrono::duration<f64, std::nano>(end_time - start_time).count();
+
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const char* kernel_name = nullptr;
+    const char* json_path = nullptr;
+
+    int num_runs = DEFAULT_RUNS;
+    u32 scale = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if ((std::strcmp(argv[i], "--kernel") == 0) && ((i + 1) < argc)) {
+            kernel_name = argv[++i];
+        } else if ((std::strcmp(argv[i], "--runs") == 0) && ((i + 1) < argc)) {
+            num_runs = std::atoi(argv[++i]);
+        } else if ((std::strcmp(argv[i], "--scale") == 0) && ((i + 1) < argc)) {
+            scale = std::strtoul(argv[++i], nullptr, 0);
+        } else if ((std::strcmp(argv[i], "--json") == 0) && ((i + 1) < argc)) {
+            json_path = argv[++i];
+        } else {
+            std::puts("Usage: nejicast-bench-cpu [--kernel name] [--runs n] [--scale n] [--json path]");
+            std::puts("Reports the fastest of n runs of every kernel");
+
+            return 1;
+        }
+    }
+
+    if ((num_runs <= 0) || (scale == 0)) {
+        std::puts("Runs and scale must be positive");
+
+        return 1;
+    }
+
+    FILE* json_file = nullptr;
+
+    if (json_path != nullptr) {
+        json_file = std::fopen(json_path, "w");
+
+        if (json_file == nullptr) {
+            std::printf("Unable to open JSON file %s\n", json_path);
+
+            return 1;
+        }
+    }
+
+    // Only the instruction counter is used, dumps are disabled
+    perf::initialize(0, nullptr);
+
+    std::vector<std::pair<const char*, Result>> results;
+
+    for (const auto& kernel : KERNELS) {
+        if ((kernel_name != nullptr) && (std::strcmp(kernel_name, kernel.name) != 0)) {
+            continue;
+        }
+
+        Assembler a;
+
+        kernel.assemble(a);
+
+        const std::vector<u16>& code = a.finish();
+        const u32 iterations = kernel.iterations * scale;
+
+        Result best{};
+
+        for (int run = 0; run < num_runs; run++) {
+            const Result result = run_kernel(code, a.get_exit_addr(), iterations);
+
+            if ((run == 0) || (result.host_ns < best.host_ns)) {
+                best = result;
+            }
+        }
+
+        if (json_file != nullptr) {
+            std::fprintf(json_file,
+                "{\"kernel\":\"%s\",\"engine\":\"%s\",\"iterations\":%u,\"instructions\":%llu,\"guest_cycles\":%llu,"
+                "\"host_ns\":%.0f,\"guest_mips\":%.3f,\"host_ns_per_instr\":%.3f}\n",
+                kernel.name,
+                hw::cpu::get_engine_name(hw::cpu::ENGINE_INTERPRETER),
+                iterations,
+                best.num_instrs,
+                best.num_cycles,
+                best.host_ns,
+                get_guest_mips(best),
+                best.host_ns / (f64)best.num_instrs
+            );
+        }
+
+        results.emplace_back(kernel.name, best);
+    }
+
+    perf::shutdown();
+
+    hw::cpu::shutdown();
+
+    if (json_file != nullptr) {
+        std::fclose(json_file);
+    }
+
+    if (results.empty()) {
+        std::printf("Unknown kernel %s\n", kernel_name);
+
+        return 1;
+    }
+
+    std::printf("%-12s %14s %14s %10s %10s\n", "kernel", "instructions", "guest cycles", "MIPS", "ns/instr");
+
+    for (const auto& [name, result] : results) {
+        std::printf("%-12s %14llu %14llu %10.3f %10.3f\n",
+            name,
+            result.num_instrs,
+            result.num_cycles,
+            get_guest_mips(result),
+            result.host_ns / (f64)result.num_instrs
+        );
+    }
+
+    return 0;
+}
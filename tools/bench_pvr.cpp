@@ -0,0 +1,227 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+// Replays PVR captures through hw::pvr without the CPU, times them and compares output hashes.
+// The emulator logs to stdout, --json writes the results as JSON Lines for tracking over time
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <nejicast.hpp>
+#include <scheduler.hpp>
+#include <common/hash.hpp>
+#include <common/types.hpp>
+#include <hw/cpu/cpu.hpp>
+#include <hw/holly/bus.hpp>
+#include <hw/holly/intc.hpp>
+#include <hw/pvr/capture.hpp>
+#include <hw/pvr/core.hpp>
+#include <hw/pvr/pvr.hpp>
+#include <hw/pvr/ta.hpp>
+
+// Events scheduled by the PVR are never run
+namespace hw::cpu {
+
+static i64 cycles;
+
+void step() {}
+
+i64* get_cycles() {
+    return &cycles;
+}
+
+}
+
+namespace hw::holly::intc {
+
+void assert_normal_interrupt(const int) {}
+
+}
+
+// Framebuffer write-back marks VRAM pages for snapshots, PVR-DMA is never started
+namespace hw::holly::bus {
+
+void mark_dirty(const int, const u32, const u32) {}
+
+const u8* get_read_span(const u32, const u32) {
+    return nullptr;
+}
+
+void read_bytes(const u32, u8*, const u32) {}
+void write_bytes(const u32, const u8*, const u32) {}
+
+}
+
+constexpr int DEFAULT_RUNS = 5;
+
+constexpr usize COLOR_BUFFER_SIZE = sizeof(u32) * nejicast::SCREEN_WIDTH * nejicast::SCREEN_HEIGHT;
+
+using hw::pvr::capture::Capture;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result {
+    f64 ta_ns;
+    f64 render_ns;
+
+    u64 frame_hash;
+};
+
+static f64 get_elapsed_ns(const Clock::time_point start_time, const Clock::time_point end_time) {
+    return std::chrono::duration<f64, std::nano>(end_time - start_time).count();
+}
+
+static Result replay(const Capture& capture) {
+    scheduler::reset();
+
+    hw::pvr::reset();
+    hw::pvr::initialize();
+
+    u8* video_ram = hw::pvr::get_video_ram_ptr();
+
+    usize offset = 0;
+
+    for (const auto& region : capture.regions) {
+        std::memcpy(&video_ram[region.addr], &capture.region_bytes[offset], region.size);
+
+        offset += region.size;
+    }
+
+    for (const auto& reg : capture.registers) {
+        hw::pvr::core::write<u32>(reg.addr, reg.data);
+    }
+
+    hw::pvr::ta::initialize_lists();
+
+    const auto start_time = Clock::now();
+
+    for (usize i = 0; i < capture.ta_stream.size(); i += hw::pvr::capture::TA_BLOCK_SIZE) {
+        hw::pvr::ta::fifo_block_write(&capture.ta_stream[i]);
+    }
+
+    const auto ta_time = Clock::now();
+
+    hw::pvr::core::start_render();
+
+    const auto end_time = Clock::now();
+
+    return Result{
+        .ta_ns = get_elapsed_ns(start_time, ta_time),
+        .render_ns = get_elapsed_ns(ta_time, end_time),
+        .frame_hash = common::hash_bytes(hw::pvr::get_color_buffer_ptr(), COLOR_BUFFER_SIZE)
+    };
+}
+
+int main(int argc, char** argv) {
+    const char* json_path = nullptr;
+
+    int num_runs = DEFAULT_RUNS;
+
+    std::vector<const char*> capture_paths;
+
+    for (int i = 1; i < argc; i++) {
+        if ((std::strcmp(argv[i], "--runs") == 0) && ((i + 1) < argc)) {
+            num_runs = std::atoi(argv[++i]);
+        } else if ((std::strcmp(argv[i], "--json") == 0) && ((i + 1) < argc)) {
+            json_path = argv[++i];
+        } else if (argv[i][0] != '-') {
+            capture_paths.push_back(argv[i]);
+        } else {
+            capture_paths.clear();
+
+            break;
+        }
+    }
+
+    if (capture_paths.empty() || (num_runs <= 0)) {
+        std::puts("Usage: nejicast-bench-pvr [--runs n] [--json path] [captures...]");
+        std::puts("Reports the fastest of n replays of every capture, fails if a frame hash differs");
+
+        return 1;
+    }
+
+    FILE* json_file = nullptr;
+
+    if (json_path != nullptr) {
+        json_file = std::fopen(json_path, "w");
+
+        if (json_file == nullptr) {
+            std::printf("Unable to open JSON file %s\n", json_path);
+
+            return 1;
+        }
+    }
+
+    std::vector<Result> results;
+    std::vector<u64> expected_hashes;
+
+    Capture capture;
+
+    for (const char* path : capture_paths) {
+        hw::pvr::capture::load(path, capture);
+
+        Result best{};
+
+        for (int run = 0; run < num_runs; run++) {
+            const Result result = replay(capture);
+
+            if ((run == 0) || ((result.ta_ns + result.render_ns) < (best.ta_ns + best.render_ns))) {
+                best = result;
+            }
+        }
+
+        if (json_file != nullptr) {
+            std::fprintf(json_file,
+                "{\"capture\":\"%s\",\"frame\":%llu,\"ta_blocks\":%zu,\"ta_ns\":%.0f,\"render_ns\":%.0f,"
+                "\"frame_hash\":\"%016llX\",\"expected_hash\":\"%016llX\"}\n",
+                path,
+                (unsigned long long)capture.frame,
+                capture.ta_stream.size() / hw::pvr::capture::TA_BLOCK_SIZE,
+                best.ta_ns,
+                best.render_ns,
+                (unsigned long long)best.frame_hash,
+                (unsigned long long)capture.frame_hash
+            );
+        }
+
+        results.push_back(best);
+        expected_hashes.push_back(capture.frame_hash);
+    }
+
+    hw::pvr::shutdown();
+
+    if (json_file != nullptr) {
+        std::fclose(json_file);
+    }
+
+    int num_mismatches = 0;
+
+    std::printf("%-32s %12s %12s %16s %s\n", "capture", "TA ms", "render ms", "frame hash", "status");
+
+    for (usize i = 0; i < capture_paths.size(); i++) {
+        const Result& result = results[i];
+
+        const char* status = "ok";
+
+        if (expected_hashes[i] != result.frame_hash) {
+            status = "MISMATCH";
+
+            num_mismatches++;
+        }
+
+        std::printf("%-32s %12.3f %12.3f %016llX %s\n",
+            capture_paths[i],
+            1E-6 * result.ta_ns,
+            1E-6 * result.render_ns,
+            (unsigned long long)result.frame_hash,
+            status
+        );
+    }
+
+    return (num_mismatches != 0) ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * nejicast is a Sega Dreamcast emulator.
+ * Copyright (C) 2025  noumidev
+ */
+
+// Compares two SH-4 execution traces and reports the first divergence
+
+#include <cstdio>
+#include <cstring>
+
+#include <common/cpu_trace.hpp>
+#include <common/types.hpp>
+
+constexpr int NUM_ARGS = 3;
+
+// Records printed before the divergence
+constexpr usize NUM_CONTEXT_RECORDS = 8;
+
+using common::CpuTraceRecord;
+
+static void print_record(const u64 idx, const CpuTraceRecord& record) {
+    std::printf("  #%llu PC = %08X, instr = %04X, cycles = %u", idx, record.pc, record.instr, record.cycles);
+
+    for (u8 i = 0; i < record.num_regs; i++) {
+        std::printf(", %s = %08X", common::get_trace_register_name(record.reg_ids[i]), record.reg_values[i]);
+    }
+
+    for (u8 i = 0; i < record.num_memory_accesses; i++) {
+        const auto& access = record.memory_accesses[i];
+
+        std::printf(", %s%u @ %08X = %llX", access.is_write ? "write" : "read", 8 * access.size, access.addr, access.data);
+    }
+
+    std::puts("");
+}
+
+// Returns a description of the first difference, or nullptr if the records match
+static const char* compare_records(const CpuTraceRecord& a, const CpuTraceRecord& b) {
+    if (a.pc != b.pc) {
+        return "PC";
+    }
+
+    if (a.instr != b.instr) {
+        return "instruction";
+    }
+
+    if (a.cycles != b.cycles) {
+        return "cycle count";
+    }
+
+    if (a.num_regs != b.num_regs) {
+        return "set of written registers";
+    }
+
+    for (u8 i = 0; i < a.num_regs; i++) {
+        if ((a.reg_ids[i] != b.reg_ids[i]) || (a.reg_values[i] != b.reg_values[i])) {
+            return common::get_trace_register_name(a.reg_ids[i]);
+        }
+    }
+
+    if (a.num_memory_accesses != b.num_memory_accesses) {
+        return "number of memory accesses";
+    }
+
+    for (u8 i = 0; i < a.num_memory_accesses; i++) {
+        const auto& access_a = a.memory_accesses[i];
+        const auto& access_b = b.memory_accesses[i];
+
+        if (
+            (access_a.addr != access_b.addr) ||
+            (access_a.size != access_b.size) ||
+            (access_a.is_write != access_b.is_write) ||
+            (access_a.data != access_b.data)
+        ) {
+            return "memory access";
+        }
+    }
+
+    return nullptr;
+}
+
+int main(int argc, char** argv) {
+    if (argc < NUM_ARGS) {
+        std::puts("Usage: nejicast-trace-diff [path to trace A] [path to trace B]");
+
+        return 1;
+    }
+
+    common::CpuTraceReader reader_a(argv[1]);
+    common::CpuTraceReader reader_b(argv[2]);
+
+    // Ring buffer of the last matching records
+    CpuTraceRecord history[NUM_CONTEXT_RECORDS];
+
+    CpuTraceRecord record_a, record_b;
+
+    for (u64 idx = 0;; idx++) {
+        const bool has_a = reader_a.read(record_a);
+        const bool has_b = reader_b.read(record_b);
+
+        if (!has_a || !has_b) {
+            if (has_a == has_b) {
+                std::printf("Traces match (%llu instructions)\n", idx);
+
+                return 0;
+            }
+
+            std::printf("Trace %c ends after %llu instructions, the other continues\n", has_a ? 'B' : 'A', idx);
+
+            return 1;
+        }
+
+        const char* difference = compare_records(record_a, record_b);
+
+        if (difference == nullptr) {
+            history[idx % NUM_CONTEXT_RECORDS] = record_a;
+
+            continue;
+        }
+
+        std::printf("First divergence at instruction #%llu (%s differs)\n", idx, difference);
+
+        const u64 first_idx = (idx > NUM_CONTEXT_RECORDS) ? (idx - NUM_CONTEXT_RECORDS) : 0;
+
+        std::puts("Preceding instructions:");
+
+        for (u64 i = first_idx; i < idx; i++) {
+            print_record(i, history[i % NUM_CONTEXT_RECORDS]);
+        }
+
+        std::printf("Trace A (%s):\n", argv[1]);
+        print_record(idx, record_a);
+
+        std::printf("Trace B (%s):\n", argv[2]);
+        print_record(idx, record_b);
+
+        return 1;
+    }
+}